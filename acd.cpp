@@ -1,11 +1,95 @@
 #include "acd.h"
 #include "kn5.h"
 
+#include "jobs.h"
+
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ACD_X86
+#include <immintrin.h>
+#define ACD_SSE2 __attribute__((target("sse2")))
+#endif
+
+namespace
+{
+	// the entries are stored as one 32 bit value per character
+	constexpr size_t chunkSize = 1 << 14;
+
+#ifdef ACD_X86
+	// 16 values at a time, the key is repeated so 16 bytes can be loaded from any position
+	ACD_SSE2 size_t decryptChunkSSE2(const int32_t* values, size_t count, const std::string& key, size_t& position, std::string& data)
+	{
+		std::string	repeated;
+
+		while (repeated.size() < key.size() + 16)
+			repeated += key;
+
+		const __m128i	mask = _mm_set1_epi32(0xff);
+		const __m128i	carriageReturn = _mm_set1_epi8('\r');
+		char			characters[16];
+		size_t			i = 0;
+
+		for (; i + 16 <= count; i += 16)
+		{
+			const __m128i*	source = reinterpret_cast<const __m128i*>(values + i);
+			const __m128i	low = _mm_packs_epi32(_mm_and_si128(_mm_loadu_si128(source), mask), _mm_and_si128(_mm_loadu_si128(source + 1), mask));
+			const __m128i	high = _mm_packs_epi32(_mm_and_si128(_mm_loadu_si128(source + 2), mask), _mm_and_si128(_mm_loadu_si128(source + 3), mask));
+			const __m128i	keys = _mm_loadu_si128(reinterpret_cast<const __m128i*>(repeated.data() + position));
+			const __m128i	decrypted = _mm_sub_epi8(_mm_packus_epi16(low, high), keys);
+
+			position = (position + 16) % key.size();
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(characters), decrypted);
+
+			if (_mm_movemask_epi8(_mm_cmpeq_epi8(decrypted, carriageReturn)) == 0)
+				data.append(characters, 16);
+			else
+			{
+				for (const char character : characters)
+				{
+					if (character != '\r')
+						data.push_back(character);
+				}
+			}
+		}
+
+		return i;
+	}
+#endif
+
+	// subtracts the key from the low bytes of the values and drops carriage returns
+	// returns the position in the key after the values
+	size_t decryptChunk(const int32_t* values, size_t count, const std::string& key, size_t position, std::string& data)
+	{
+		size_t i = 0;
+
+#ifdef ACD_X86
+		i = decryptChunkSSE2(values, count, key, position, data);
+#endif
+
+		for (; i < count; i++)
+		{
+			const char character = static_cast<char>(values[i] - key[position]);
+
+			if (++position == key.size())
+				position = 0;
+
+			if (character != '\r')
+				data.push_back(character);
+		}
+
+		return position;
+	}
+}
 
 void acd::read(const std::string& fileName)
 {
+	m_fileName = fileName;
+
 	calculateKey(std::filesystem::path(fileName).parent_path().filename().string());
 
 	std::ifstream stream(fileName, std::ios::binary);
@@ -13,34 +97,110 @@ void acd::read(const std::string& fileName)
 	if (!stream)
 		throw std::runtime_error("Couldn't open file: " + fileName);
 
+	stream.seekg(0, stream.end);
+
+	const std::streamoff fileSize = stream.tellg();
+
+	stream.seekg(0, stream.beg);
+
 	if (kn5::readInt32(stream) == -1111)
 		kn5::readInt32(stream);
 	else
 		stream.seekg(0, stream.beg);
 
+	// only the names and positions are read here
+	m_entries.clear();
+	m_index.clear();
+
 	while (stream.peek() != EOF)
 	{
 		Entry   entry;
 
 		entry.m_name = kn5::readString(stream);
 
-		entry.m_rawData.resize(kn5::readInt32(stream));
-		stream.read(reinterpret_cast<char*>(entry.m_rawData.data()), entry.m_rawData.size() * 4);
+		const int32_t size = kn5::readInt32(stream);
+
+		entry.m_offset = stream.tellg();
+
+		if (size < 0 || entry.m_offset + static_cast<std::streamoff>(size) * 4 > fileSize)
+			throw std::runtime_error("Truncated entry: " + entry.m_name + " in " + fileName);
+
+		entry.m_size = size;
+
+		stream.seekg(static_cast<std::streamoff>(size) * 4, stream.cur);
 
-		entry.m_data.reserve(entry.m_rawData.size());
-		for (size_t i = 0; i < entry.m_rawData.size(); i++)
+		m_index.emplace(entry.m_name, m_entries.size());
+		m_entries.push_back(entry);
+	}
+
+	stream.close();
+
+	m_decrypted = std::make_unique<std::once_flag[]>(m_entries.size());
+}
+
+void acd::decryptAll(unsigned int threads) const
+{
+	jobs pool(m_entries.size() > 1 ? threads : 1);
+
+	for (size_t i = 0; i < m_entries.size(); i++)
+	{
+		pool.add(m_entries[i].m_name, [this, i]()
 		{
-			char data = static_cast<char>(entry.m_rawData[i]) - m_key[i % m_key.size()];
-			if (data != '\r')
-				entry.m_data.push_back(data);
-		}
+			std::call_once(m_decrypted[i], [this, i]() { decrypt(m_entries[i]); });
+		});
+	}
+
+	const std::vector<jobs::Error> errors = pool.wait();
+
+	if (!errors.empty())
+		throw std::runtime_error("Couldn't decrypt " + errors.front().m_name + " in " + m_fileName + " : " + errors.front().m_message);
+}
+
+const std::string* acd::getData(const std::string& name) const
+{
+	const auto it = m_index.find(name);
+
+	if (it == m_index.end())
+		return nullptr;
 
-		m_entries.emplace_back(entry);
+	const Entry&	entry = m_entries[it->second];
+
+	std::call_once(m_decrypted[it->second], [this, &entry]() { decrypt(entry); });
+
+	return &entry.m_data;
+}
+
+void acd::decrypt(const Entry& entry) const
+{
+	std::ifstream stream(m_fileName, std::ios::binary);
+
+	if (!stream)
+		throw std::runtime_error("Couldn't open file: " + m_fileName);
+
+	stream.seekg(entry.m_offset);
+
+	std::vector<int32_t>	values(std::min(entry.m_size, chunkSize));
+	size_t					position = 0;
+
+	entry.m_data.clear();
+	entry.m_data.reserve(entry.m_size);
+
+	for (size_t done = 0; done < entry.m_size; )
+	{
+		const size_t count = std::min(entry.m_size - done, chunkSize);
+
+		if (!stream.read(reinterpret_cast<char*>(values.data()), count * 4))
+			throw std::runtime_error("Couldn't read file: " + m_fileName);
+
+		position = decryptChunk(values.data(), count, m_key, position, entry.m_data);
+		done += count;
 	}
 }
 
 void acd::dump(std::ostream& stream) const
 {
+	decryptAll(0);
+
 	stream << "key:     " << m_key << std::endl;
 	stream << "entries: " << m_entries.size() << std::endl;
 	size_t count = 0;
@@ -54,7 +214,7 @@ void acd::dump(std::ostream& stream) const
 void acd::Entry::dump(std::ostream& stream) const
 {
 	stream << "    name:    " << m_name << std::endl;
-	stream << "    rawData: " << m_rawData.size() << std::endl;
+	stream << "    rawData: " << m_size << std::endl;
 	stream << "    data:    " << m_data.size() << std::endl;
 }
 
@@ -74,8 +234,10 @@ bool acd::dump(const std::string& fileName) const
 	return false;
 }
 
-void acd::writeEntries(const std::string& directory) const
+void acd::writeEntries(const std::string& directory, unsigned int threads) const
 {
+	decryptAll(threads);
+
 	std::filesystem::path	dataDirectory(directory);
 
 	for (const auto& entry : m_entries)
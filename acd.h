@@ -3,24 +3,36 @@
 
 #include <string>
 #include <vector>
-#include <list>
 #include <filesystem>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
+// Reader for the encrypted data.acd archives of Assetto Corsa cars.
+// Only the names and positions of the entries are read when the file is opened, an entry is decrypted
+// in chunks straight from the file the first time its data is requested and kept for later requests.
 class acd
 {
     struct Entry
     {
         std::string         m_name;
-        std::vector<int>    m_rawData;
-        std::string         m_data;
+        std::streamoff      m_offset = 0;
+        size_t              m_size = 0;
+        mutable std::string m_data;
 
         void dump(std::ostream& stream) const;
     };
 
-    std::list<Entry>        m_entries;
-    std::string             m_key;
+    std::string                                 m_fileName;
+    std::vector<Entry>                          m_entries;
+    std::unordered_map<std::string, size_t>     m_index;
+    std::string                                 m_key;
+    // one per entry, entries are decrypted once even when several threads request them
+    std::unique_ptr<std::once_flag[]>           m_decrypted;
 
     void calculateKey(const std::string& directory);
+    void decrypt(const Entry& entry) const;
+    void decryptAll(unsigned int threads) const;
 
 public:
     acd() = default;
@@ -30,9 +42,18 @@ public:
     }
 
     void read(const std::string& fileName);
-    void writeEntries(const std::string& directory) const;
+    // decrypts the entries that haven't been requested yet, a thread count of 0 uses one thread per core
+    void writeEntries(const std::string& directory, unsigned int threads = 0) const;
     void dump(std::ostream& stream) const;
     bool dump(const std::string& fileName) const;
+
+    bool hasEntry(const std::string& name) const
+    {
+        return m_index.find(name) != m_index.end();
+    }
+
+    // the decrypted data of the entry called name, nullptr when there is no such entry
+    const std::string* getData(const std::string& name) const;
 };
 
 #endif
@@ -0,0 +1,133 @@
+#include "assetstore.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <linux/fs.h>
+#endif
+
+namespace
+{
+    // clones the file data when the file system supports it
+    bool reflink(const std::string& source, const std::string& destination)
+    {
+#if defined(__linux__) && defined(FICLONE)
+        const int input = open(source.c_str(), O_RDONLY);
+
+        if (input < 0)
+            return false;
+
+        const int output = open(destination.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+
+        if (output < 0)
+        {
+            close(input);
+            return false;
+        }
+
+        const bool cloned = ioctl(output, FICLONE, input) == 0;
+
+        close(output);
+        close(input);
+
+        if (!cloned)
+            std::filesystem::remove(destination);
+
+        return cloned;
+#else
+        (void)source;
+        (void)destination;
+
+        return false;
+#endif
+    }
+
+    // unique in the store directory across threads and processes
+    std::string getTemporaryName()
+    {
+        static std::atomic<unsigned int> counter(0);
+
+        const size_t thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+        const auto   time = std::chrono::steady_clock::now().time_since_epoch().count();
+
+        return ".tmp-" + std::to_string(thread) + "-" + std::to_string(time) + "-" + std::to_string(counter++);
+    }
+}
+
+assetstore::assetstore(const std::string& directory) : m_directory(directory)
+{
+    std::error_code error;
+
+    std::filesystem::create_directories(m_directory, error);
+
+    if (!std::filesystem::is_directory(m_directory))
+        throw std::runtime_error("Couldn't create asset store: " + m_directory);
+}
+
+std::string assetstore::getPath(const std::string& key) const
+{
+    if (key.size() < 2)
+        throw std::runtime_error("Invalid asset store key: " + key);
+
+    return std::filesystem::path(m_directory).append(key.substr(0, 2)).append(key).string();
+}
+
+bool assetstore::link(const std::string& source, const std::string& fileName)
+{
+    std::error_code error;
+
+    std::filesystem::remove(fileName, error);
+    std::filesystem::create_hard_link(source, fileName, error);
+
+    if (!error)
+        return true;
+
+    if (reflink(source, fileName))
+        return true;
+
+    return std::filesystem::copy_file(source, fileName, error) && !error;
+}
+
+bool assetstore::materialize(const std::string& key, const std::string& fileName) const
+{
+    const std::string path = getPath(key);
+
+    if (!std::filesystem::exists(path))
+        return false;
+
+    return link(path, fileName);
+}
+
+void assetstore::insert(const std::string& key, const std::string& fileName) const
+{
+    const std::string path = getPath(key);
+
+    if (std::filesystem::exists(path))
+        return;
+
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+
+    // the file only appears under its final name once it is complete
+    const std::string temporary = std::filesystem::path(path).parent_path().append(getTemporaryName()).string();
+
+    if (!link(fileName, temporary))
+        throw std::runtime_error("Couldn't add " + fileName + " to asset store");
+
+    std::error_code error;
+
+    std::filesystem::rename(temporary, path, error);
+
+    if (error)
+    {
+        std::filesystem::remove(temporary, error);
+        throw std::runtime_error("Couldn't add " + fileName + " to asset store");
+    }
+}
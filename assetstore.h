@@ -0,0 +1,33 @@
+#ifndef _ASSETSTORE_H_
+#define _ASSETSTORE_H_
+
+#include <string>
+
+// Content addressed store of converted files shared between conversions.
+// Files are inserted atomically so several processes can use the same store.
+// Materialized files can share their data with the store so they must be replaced, never rewritten in place.
+class assetstore
+{
+    std::string m_directory;
+
+    std::string getPath(const std::string& key) const;
+
+public:
+    explicit assetstore(const std::string& directory);
+
+    // replaces fileName with a hard link, reflink or copy of source, returns false when it can't
+    static bool link(const std::string& source, const std::string& fileName);
+
+    const std::string& getDirectory() const
+    {
+        return m_directory;
+    }
+
+    // makes fileName a hard link, reflink or copy of the stored file, returns false when key isn't stored
+    bool materialize(const std::string& key, const std::string& fileName) const;
+
+    // stores a copy of fileName under key, an existing file is kept
+    void insert(const std::string& key, const std::string& fileName) const;
+};
+
+#endif
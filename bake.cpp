@@ -0,0 +1,175 @@
+#include "bake.h"
+#include "jobs.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BAKE_X86
+#include <immintrin.h>
+#define BAKE_SSE2 __attribute__((target("sse2")))
+#define BAKE_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace
+{
+    // a * b / 255 rounded to nearest
+    inline uint8_t multiply8(uint32_t a, uint32_t b)
+    {
+        const uint32_t product = a * b + 128;
+
+        return static_cast<uint8_t>((product + (product >> 8)) >> 8);
+    }
+
+    void multiplyRowScalar(uint8_t* pixels, const uint8_t* layer, uint32_t first, uint32_t width)
+    {
+        for (uint32_t x = first; x < width; x++)
+        {
+            for (uint32_t i = 0; i < 3; i++)
+                pixels[x * 4 + i] = multiply8(pixels[x * 4 + i], layer[x * 4 + i]);
+        }
+    }
+
+#ifdef BAKE_X86
+    BAKE_SSE2 __m128i multiplySSE2(__m128i a, __m128i b)
+    {
+        const __m128i product = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128));
+
+        return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+    }
+
+    // the alpha of the layer row is 255 so the alpha of the image doesn't change
+    BAKE_SSE2 uint32_t multiplyRowSSE2(uint8_t* pixels, const uint8_t* layer, uint32_t width)
+    {
+        const __m128i   zero = _mm_setzero_si128();
+        uint32_t        x = 0;
+
+        for (; x + 4 <= width; x += 4)
+        {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + x * 4));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(layer + x * 4));
+            const __m128i low = multiplySSE2(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            const __m128i high = multiplySSE2(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + x * 4), _mm_packus_epi16(low, high));
+        }
+
+        return x;
+    }
+
+    BAKE_AVX2 __m256i multiplyAVX2(__m256i a, __m256i b)
+    {
+        const __m256i product = _mm256_add_epi16(_mm256_mullo_epi16(a, b), _mm256_set1_epi16(128));
+
+        return _mm256_srli_epi16(_mm256_add_epi16(product, _mm256_srli_epi16(product, 8)), 8);
+    }
+
+    // unpack and pack work within 128 bit lanes so the pixels stay in order
+    BAKE_AVX2 uint32_t multiplyRowAVX2(uint8_t* pixels, const uint8_t* layer, uint32_t width)
+    {
+        const __m256i   zero = _mm256_setzero_si256();
+        uint32_t        x = 0;
+
+        for (; x + 8 <= width; x += 8)
+        {
+            const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + x * 4));
+            const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(layer + x * 4));
+            const __m256i low = multiplyAVX2(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero));
+            const __m256i high = multiplyAVX2(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero));
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + x * 4), _mm256_packus_epi16(low, high));
+        }
+
+        _mm256_zeroupper();
+
+        return x;
+    }
+#endif
+
+    // the layer pixel nearest to each pixel of a row or column of the image
+    std::vector<uint32_t> getSamples(uint32_t size, uint32_t layerSize, float uvMultiplier)
+    {
+        std::vector<uint32_t>   samples(size);
+        const double            scale = static_cast<double>(layerSize) * uvMultiplier / size;
+
+        for (uint32_t i = 0; i < size; i++)
+        {
+            const double position = std::floor((i + 0.5) * scale);
+            const double wrapped = position - std::floor(position / layerSize) * layerSize;
+
+            samples[i] = std::min(static_cast<uint32_t>(wrapped), layerSize - 1);
+        }
+
+        return samples;
+    }
+
+    void multiplyRows(dds::Image& image, const dds::Image& layer, const std::vector<uint32_t>& columns, const std::vector<uint32_t>& rows, uint32_t first, uint32_t last, cpu::Isa isa)
+    {
+        std::vector<uint8_t> sampled(static_cast<size_t>(image.m_width) * 4);
+
+        for (uint32_t y = first; y < last; y++)
+        {
+            const uint8_t*  layerRow = layer.m_pixels.data() + static_cast<size_t>(rows[y]) * layer.m_width * 4;
+            uint8_t*        row = image.m_pixels.data() + static_cast<size_t>(y) * image.m_width * 4;
+            uint32_t        x = 0;
+
+            for (uint32_t i = 0; i < image.m_width; i++)
+            {
+                std::memcpy(sampled.data() + i * 4, layerRow + columns[i] * 4, 3);
+                sampled[i * 4 + 3] = 255;
+            }
+
+#ifdef BAKE_X86
+            if (isa == cpu::AVX2)
+                x = multiplyRowAVX2(row, sampled.data(), image.m_width);
+            else if (isa == cpu::SSE41)
+                x = multiplyRowSSE2(row, sampled.data(), image.m_width);
+#else
+            (void)isa;
+#endif
+
+            multiplyRowScalar(row, sampled.data(), x, image.m_width);
+        }
+    }
+}
+
+void bake::multiply(dds::Image& image, const dds::Image& layer, float uvMultiplier)
+{
+    jobs single(1);
+
+    multiply(image, layer, uvMultiplier, single, cpu::getSupportedIsa());
+}
+
+void bake::multiply(dds::Image& image, const dds::Image& layer, float uvMultiplier, jobs& pool)
+{
+    multiply(image, layer, uvMultiplier, pool, cpu::getSupportedIsa());
+}
+
+void bake::multiply(dds::Image& image, const dds::Image& layer, float uvMultiplier, jobs& pool, cpu::Isa isa)
+{
+    if (image.m_width == 0 || image.m_height == 0)
+        return;
+
+    if (layer.m_width == 0 || layer.m_height == 0)
+        throw std::runtime_error("Empty texture layer");
+
+    const std::vector<uint32_t> columns = getSamples(image.m_width, layer.m_width, uvMultiplier);
+    const std::vector<uint32_t> rows = getSamples(image.m_height, layer.m_height, uvMultiplier);
+    const uint32_t              band = std::max<uint32_t>(1, (1 << 16) / image.m_width);
+    jobs                        single(1);
+    jobs                        bands(image.m_height > band ? pool : single);
+
+    for (uint32_t first = 0; first < image.m_height; first += band)
+    {
+        const uint32_t last = std::min(image.m_height, first + band);
+
+        bands.add("multiply", [&image, &layer, &columns, &rows, first, last, isa]()
+        {
+            multiplyRows(image, layer, columns, rows, first, last, isa);
+        });
+    }
+
+    bands.wait();
+}
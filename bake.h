@@ -0,0 +1,20 @@
+#ifndef _BAKE_H_
+#define _BAKE_H_
+
+#include "dds.h"
+
+class jobs;
+
+// Combines the texture layers of a material into a single image.
+// Assetto Corsa combines the layers in its shaders, AC3D only has one texture per object.
+class bake
+{
+public:
+    // multiplies the color of the image by a layer repeated uvMultiplier times across it
+    // the alpha channel of the image is kept, the rows are split in bands queued on pool
+    static void multiply(dds::Image& image, const dds::Image& layer, float uvMultiplier);
+    static void multiply(dds::Image& image, const dds::Image& layer, float uvMultiplier, jobs& pool);
+    static void multiply(dds::Image& image, const dds::Image& layer, float uvMultiplier, jobs& pool, cpu::Isa isa);
+};
+
+#endif
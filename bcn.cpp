@@ -0,0 +1,977 @@
+#include "bcn.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BCN_X86
+#include <immintrin.h>
+#define BCN_SSE41 __attribute__((target("sse4.1")))
+#define BCN_AVX2 __attribute__((target("avx2")))
+#endif
+
+// the helpers of the rows are inlined into each row so the SSE4.1 and AVX2 rows are compiled with their own encoding
+#ifdef __GNUC__
+#define BCN_INLINE inline __attribute__((always_inline))
+#else
+#define BCN_INLINE inline
+#endif
+
+namespace
+{
+    BCN_INLINE uint32_t readUint32(const uint8_t* data)
+    {
+        return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+               (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+    }
+
+    BCN_INLINE uint16_t readUint16(const uint8_t* data)
+    {
+        return static_cast<uint16_t>(data[0] | (data[1] << 8));
+    }
+
+    BCN_INLINE void decode565(uint16_t color, uint8_t* rgb)
+    {
+        const uint32_t r = (color >> 11) & 0x1f;
+        const uint32_t g = (color >> 5) & 0x3f;
+        const uint32_t b = color & 0x1f;
+
+        rgb[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+        rgb[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+        rgb[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+    }
+
+    // 8 byte BC1 color block palette, BC2 and BC3 always use 4 colors
+    BCN_INLINE void getColorPalette(const uint8_t* block, uint8_t colors[4][4], bool fourColors)
+    {
+        const uint16_t  color0 = readUint16(block);
+        const uint16_t  color1 = readUint16(block + 2);
+
+        decode565(color0, colors[0]);
+        decode565(color1, colors[1]);
+        colors[0][3] = 255;
+        colors[1][3] = 255;
+
+        if (fourColors || color0 > color1)
+        {
+            for (size_t i = 0; i < 3; i++)
+            {
+                colors[2][i] = static_cast<uint8_t>((2 * colors[0][i] + colors[1][i]) / 3);
+                colors[3][i] = static_cast<uint8_t>((colors[0][i] + 2 * colors[1][i]) / 3);
+            }
+
+            colors[2][3] = 255;
+            colors[3][3] = 255;
+        }
+        else
+        {
+            for (size_t i = 0; i < 3; i++)
+            {
+                colors[2][i] = static_cast<uint8_t>((colors[0][i] + colors[1][i]) / 2);
+                colors[3][i] = 0;
+            }
+
+            colors[2][3] = 255;
+            colors[3][3] = 0;
+        }
+    }
+
+    // 8 byte BC3 alpha, BC4 and BC5 channel block palette
+    BCN_INLINE void getChannelPalette(const uint8_t* block, uint8_t values[8])
+    {
+        const uint32_t  value0 = block[0];
+        const uint32_t  value1 = block[1];
+
+        values[0] = static_cast<uint8_t>(value0);
+        values[1] = static_cast<uint8_t>(value1);
+
+        if (value0 > value1)
+        {
+            for (uint32_t i = 1; i < 7; i++)
+                values[i + 1] = static_cast<uint8_t>(((7 - i) * value0 + i * value1) / 7);
+        }
+        else
+        {
+            for (uint32_t i = 1; i < 5; i++)
+                values[i + 1] = static_cast<uint8_t>(((5 - i) * value0 + i * value1) / 5);
+
+            values[6] = 0;
+            values[7] = 255;
+        }
+    }
+
+    void decodeColorBlock(const uint8_t* block, uint8_t* pixels, bool fourColors)
+    {
+        uint8_t colors[4][4];
+
+        getColorPalette(block, colors, fourColors);
+
+        const uint32_t indices = readUint32(block + 4);
+
+        for (size_t i = 0; i < 16; i++)
+            std::memcpy(pixels + i * 4, colors[(indices >> (i * 2)) & 3], 4);
+    }
+
+    void decodeChannelBlock(const uint8_t* block, uint8_t* pixels, size_t stride)
+    {
+        uint8_t values[8];
+
+        getChannelPalette(block, values);
+
+        uint64_t indices = 0;
+
+        for (size_t i = 0; i < 6; i++)
+            indices |= static_cast<uint64_t>(block[2 + i]) << (i * 8);
+
+        for (size_t i = 0; i < 16; i++)
+            pixels[i * stride] = values[(indices >> (i * 3)) & 7];
+    }
+
+    // 16 byte BC2 explicit alpha block
+    void decodeExplicitAlphaBlock(const uint8_t* block, uint8_t* pixels)
+    {
+        for (size_t i = 0; i < 16; i++)
+        {
+            const uint8_t alpha = (block[i / 2] >> ((i & 1) * 4)) & 0xf;
+
+            pixels[i * 4 + 3] = static_cast<uint8_t>(alpha | (alpha << 4));
+        }
+    }
+
+    struct BC7Mode
+    {
+        uint8_t m_subsets;
+        uint8_t m_partitionBits;
+        uint8_t m_rotationBits;
+        uint8_t m_indexSelectionBits;
+        uint8_t m_colorBits;
+        uint8_t m_alphaBits;
+        uint8_t m_endpointPBits;
+        uint8_t m_sharedPBits;
+        uint8_t m_indexBits;
+        uint8_t m_indexBits2;
+    };
+
+    const BC7Mode bc7Modes[8] =
+    {
+        { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+        { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+        { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+        { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+        { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+        { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+        { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+        { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+    };
+
+    const uint8_t partitions2[64][16] =
+    {
+        { 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1 },
+        { 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1 },
+        { 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1 },
+        { 0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 1 },
+        { 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 1 },
+        { 0, 0, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1 },
+        { 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1 },
+        { 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1 },
+        { 0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 },
+        { 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1 },
+        { 0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1 },
+        { 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1 },
+        { 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 1, 1, 1, 1 },
+        { 0, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0 },
+        { 0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0 },
+        { 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0 },
+        { 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0 },
+        { 0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1 },
+        { 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0 },
+        { 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0 },
+        { 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0 },
+        { 0, 0, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0, 0 },
+        { 0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 0 },
+        { 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0 },
+        { 0, 1, 1, 1, 0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 1, 0 },
+        { 0, 0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0 },
+        { 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1 },
+        { 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1 },
+        { 0, 1, 0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0 },
+        { 0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0 },
+        { 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0 },
+        { 0, 1, 0, 1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0 },
+        { 0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0, 0, 1 },
+        { 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0, 0, 1, 0, 1 },
+        { 0, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 0 },
+        { 0, 0, 0, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 0, 0, 0 },
+        { 0, 0, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1, 0, 0 },
+        { 0, 0, 1, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1, 1, 0, 0 },
+        { 0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0 },
+        { 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 1, 1 },
+        { 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1 },
+        { 0, 0, 0, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 0 },
+        { 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0 },
+        { 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0 },
+        { 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0 },
+        { 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0 },
+        { 0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1 },
+        { 0, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 0, 1 },
+        { 0, 1, 1, 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0 },
+        { 0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 0, 1, 1, 0 },
+        { 0, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 0, 0, 1 },
+        { 0, 1, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0, 1 },
+        { 0, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 0, 0, 0, 0, 1 },
+        { 0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1 },
+        { 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1 },
+        { 0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0 },
+        { 0, 0, 1, 0, 0, 0, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0 },
+        { 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 1, 1, 1 }
+    };
+
+    const uint8_t partitions3[64][16] =
+    {
+        { 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2 },
+        { 0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1 },
+        { 0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
+        { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2 },
+        { 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2 },
+        { 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1 },
+        { 0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2 },
+        { 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2 },
+        { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
+        { 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2 },
+        { 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2 },
+        { 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2 },
+        { 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2 },
+        { 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0 },
+        { 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2 },
+        { 0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0 },
+        { 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2 },
+        { 0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1 },
+        { 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2 },
+        { 0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1 },
+        { 0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2 },
+        { 0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0 },
+        { 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0 },
+        { 0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2 },
+        { 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0 },
+        { 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1 },
+        { 0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2 },
+        { 0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2 },
+        { 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1 },
+        { 0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1 },
+        { 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2 },
+        { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1 },
+        { 0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2 },
+        { 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0 },
+        { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0 },
+        { 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0 },
+        { 0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0 },
+        { 0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1 },
+        { 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1 },
+        { 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1 },
+        { 0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2 },
+        { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1 },
+        { 0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1 },
+        { 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1 },
+        { 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1 },
+        { 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2 },
+        { 0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1 },
+        { 0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2 },
+        { 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2 },
+        { 0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2 },
+        { 0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2 },
+        { 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2 },
+        { 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2 },
+        { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2 },
+        { 0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2 },
+        { 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1 },
+        { 0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2 },
+        { 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2 },
+        { 0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0 }
+    };
+
+    const uint8_t anchors2[64] =
+    {
+        15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+        15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+         6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+    };
+
+    const uint8_t anchors3a[64] =
+    {
+         3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+         3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+         8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+         3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3
+    };
+
+    const uint8_t anchors3b[64] =
+    {
+        15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+        15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+        15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+        15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8
+    };
+
+    const uint8_t weights2[4] = { 0, 21, 43, 64 };
+    const uint8_t weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+    const uint8_t weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    class BitReader
+    {
+        uint64_t    m_low = 0;
+        uint64_t    m_high = 0;
+
+    public:
+        explicit BitReader(const uint8_t* data)
+        {
+            for (size_t i = 0; i < 8; i++)
+            {
+                m_low |= static_cast<uint64_t>(data[i]) << (i * 8);
+                m_high |= static_cast<uint64_t>(data[i + 8]) << (i * 8);
+            }
+        }
+
+        BCN_INLINE uint32_t read(size_t count)
+        {
+            if (count == 0)
+                return 0;
+
+            const uint32_t value = static_cast<uint32_t>(m_low & ((1u << count) - 1));
+
+            skip(count);
+
+            return value;
+        }
+
+        BCN_INLINE void skip(size_t count)
+        {
+            m_low = (m_low >> count) | (m_high << (64 - count));
+            m_high >>= count;
+        }
+    };
+
+    BCN_INLINE uint8_t expand(uint32_t value, uint32_t bits)
+    {
+        value <<= 8 - bits;
+
+        return static_cast<uint8_t>(value | (value >> bits));
+    }
+
+    BCN_INLINE const uint8_t* getWeights(uint32_t bits)
+    {
+        return bits == 2 ? weights2 : (bits == 3 ? weights3 : weights4);
+    }
+
+    // BC7 block unpacked to per pixel endpoints and weights so the interpolation can be vectorized
+    struct BC7Block
+    {
+        uint8_t     m_endpoints[2][16 * 4];
+        uint8_t     m_weights[16 * 4];
+        uint32_t    m_rotation = 0;
+    };
+
+    // returns false for the reserved mode which decodes to transparent black
+    BCN_INLINE bool unpackBC7Block(const uint8_t* block, BC7Block& unpacked)
+    {
+        uint32_t mode = 0;
+
+        while (mode < 8 && (block[0] & (1 << mode)) == 0)
+            mode++;
+
+        if (mode == 8)
+            return false;
+
+        const BC7Mode&  info = bc7Modes[mode];
+        BitReader       reader(block);
+
+        reader.skip(mode + 1);
+
+        const uint32_t  partition = reader.read(info.m_partitionBits);
+        const uint32_t  rotation = reader.read(info.m_rotationBits);
+        const uint32_t  indexSelection = reader.read(info.m_indexSelectionBits);
+        uint32_t        endpoints[3][2][4];
+
+        for (size_t channel = 0; channel < 3; channel++)
+        {
+            for (size_t subset = 0; subset < info.m_subsets; subset++)
+            {
+                endpoints[subset][0][channel] = reader.read(info.m_colorBits);
+                endpoints[subset][1][channel] = reader.read(info.m_colorBits);
+            }
+        }
+
+        for (size_t subset = 0; subset < info.m_subsets; subset++)
+        {
+            endpoints[subset][0][3] = reader.read(info.m_alphaBits);
+            endpoints[subset][1][3] = reader.read(info.m_alphaBits);
+        }
+
+        uint32_t colorBits = info.m_colorBits;
+        uint32_t alphaBits = info.m_alphaBits;
+
+        if (info.m_endpointPBits || info.m_sharedPBits)
+        {
+            for (size_t subset = 0; subset < info.m_subsets; subset++)
+            {
+                uint32_t pbit = reader.read(1);
+
+                for (size_t endpoint = 0; endpoint < 2; endpoint++)
+                {
+                    if (endpoint == 1 && info.m_endpointPBits)
+                        pbit = reader.read(1);
+
+                    for (size_t channel = 0; channel < 4; channel++)
+                        endpoints[subset][endpoint][channel] = (endpoints[subset][endpoint][channel] << 1) | pbit;
+                }
+            }
+
+            colorBits++;
+
+            if (alphaBits)
+                alphaBits++;
+        }
+
+        uint8_t colors[3][2][4];
+
+        for (size_t subset = 0; subset < info.m_subsets; subset++)
+        {
+            for (size_t endpoint = 0; endpoint < 2; endpoint++)
+            {
+                for (size_t channel = 0; channel < 3; channel++)
+                    colors[subset][endpoint][channel] = expand(endpoints[subset][endpoint][channel], colorBits);
+
+                colors[subset][endpoint][3] = alphaBits ? expand(endpoints[subset][endpoint][3], alphaBits) : 255;
+            }
+        }
+
+        const uint8_t*  subsets = info.m_subsets == 2 ? partitions2[partition] : (info.m_subsets == 3 ? partitions3[partition] : nullptr);
+        uint32_t        indices[16];
+        uint32_t        indices2[16];
+
+        for (size_t i = 0; i < 16; i++)
+        {
+            bool anchor = i == 0;
+
+            if (info.m_subsets == 2)
+                anchor = anchor || i == anchors2[partition];
+            else if (info.m_subsets == 3)
+                anchor = anchor || i == anchors3a[partition] || i == anchors3b[partition];
+
+            indices[i] = reader.read(info.m_indexBits - (anchor ? 1 : 0));
+        }
+
+        if (info.m_indexBits2)
+        {
+            for (size_t i = 0; i < 16; i++)
+                indices2[i] = reader.read(info.m_indexBits2 - (i == 0 ? 1 : 0));
+        }
+
+        const uint8_t*  colorWeights = getWeights(info.m_indexBits);
+        const uint8_t*  alphaWeights = colorWeights;
+        const uint32_t* colorIndices = indices;
+        const uint32_t* alphaIndices = indices;
+
+        if (info.m_indexBits2)
+        {
+            if (indexSelection)
+            {
+                colorWeights = getWeights(info.m_indexBits2);
+                colorIndices = indices2;
+            }
+            else
+            {
+                alphaWeights = getWeights(info.m_indexBits2);
+                alphaIndices = indices2;
+            }
+        }
+
+        for (size_t i = 0; i < 16; i++)
+        {
+            const uint32_t subset = subsets ? subsets[i] : 0;
+
+            std::memcpy(unpacked.m_endpoints[0] + i * 4, colors[subset][0], 4);
+            std::memcpy(unpacked.m_endpoints[1] + i * 4, colors[subset][1], 4);
+
+            const uint8_t colorWeight = colorWeights[colorIndices[i]];
+
+            unpacked.m_weights[i * 4 + 0] = colorWeight;
+            unpacked.m_weights[i * 4 + 1] = colorWeight;
+            unpacked.m_weights[i * 4 + 2] = colorWeight;
+            unpacked.m_weights[i * 4 + 3] = alphaWeights[alphaIndices[i]];
+        }
+
+        unpacked.m_rotation = rotation;
+
+        return true;
+    }
+
+    void decodeBC7Block(const uint8_t* block, uint8_t* pixels)
+    {
+        BC7Block unpacked;
+
+        if (!unpackBC7Block(block, unpacked))
+        {
+            std::memset(pixels, 0, 16 * 4);
+
+            return;
+        }
+
+        for (size_t i = 0; i < 16 * 4; i++)
+        {
+            const uint32_t weight = unpacked.m_weights[i];
+
+            pixels[i] = static_cast<uint8_t>(((64 - weight) * unpacked.m_endpoints[0][i] + weight * unpacked.m_endpoints[1][i] + 32) >> 6);
+        }
+
+        if (unpacked.m_rotation)
+        {
+            for (size_t i = 0; i < 16; i++)
+                std::swap(pixels[i * 4 + 3], pixels[i * 4 + unpacked.m_rotation - 1]);
+        }
+    }
+
+    // decodes a 4x4 block to 16 consecutive pixels
+    void decodeBlock(dds::Format format, const uint8_t* block, uint8_t* pixels)
+    {
+        switch (format)
+        {
+        case dds::BC1:
+            decodeColorBlock(block, pixels, false);
+            break;
+        case dds::BC2:
+            decodeColorBlock(block + 8, pixels, true);
+            decodeExplicitAlphaBlock(block, pixels);
+            break;
+        case dds::BC3:
+            decodeColorBlock(block + 8, pixels, true);
+            decodeChannelBlock(block, pixels + 3, 4);
+            break;
+        case dds::BC4:
+            decodeChannelBlock(block, pixels, 4);
+            for (size_t i = 0; i < 16; i++)
+            {
+                pixels[i * 4 + 1] = pixels[i * 4];
+                pixels[i * 4 + 2] = pixels[i * 4];
+                pixels[i * 4 + 3] = 255;
+            }
+            break;
+        case dds::BC5:
+            decodeChannelBlock(block, pixels, 4);
+            decodeChannelBlock(block + 8, pixels + 1, 4);
+            for (size_t i = 0; i < 16; i++)
+            {
+                pixels[i * 4 + 2] = 0;
+                pixels[i * 4 + 3] = 255;
+            }
+            break;
+        case dds::BC7:
+            decodeBC7Block(block, pixels);
+            break;
+        default:
+            throw std::runtime_error("Unsupported block format: " + dds::to_string(format));
+        }
+    }
+
+    BCN_INLINE void copyBlock(const uint8_t* block, uint8_t* pixels, size_t stride, size_t width, size_t height)
+    {
+        for (size_t y = 0; y < height; y++)
+            std::memcpy(pixels + y * stride, block + y * 16, width * 4);
+    }
+
+    void decodeRowScalar(dds::Format format, const uint8_t* blocks, uint8_t* pixels, size_t stride, uint32_t width, uint32_t height)
+    {
+        const size_t    blockSize = bcn::getBlockSize(format);
+        uint8_t         block[16 * 4];
+
+        for (uint32_t x = 0; x < width; x += 4, blocks += blockSize)
+        {
+            decodeBlock(format, blocks, block);
+            copyBlock(block, pixels + x * 4, stride, std::min<uint32_t>(4, width - x), height);
+        }
+    }
+
+#ifdef BCN_X86
+    // pshufb controls picking a palette entry for 4 pixels from 4 2 bit indices
+    struct ColorShuffles
+    {
+        uint8_t m_data[256][16];
+
+        constexpr ColorShuffles() : m_data()
+        {
+            for (uint32_t indices = 0; indices < 256; indices++)
+            {
+                for (uint32_t x = 0; x < 4; x++)
+                {
+                    for (uint32_t channel = 0; channel < 4; channel++)
+                        m_data[indices][x * 4 + channel] = static_cast<uint8_t>(((indices >> (x * 2)) & 3) * 4 + channel);
+                }
+            }
+        }
+    };
+
+    constexpr ColorShuffles colorShuffles;
+
+    // pshufb controls moving the 4 channel values of row y to the given channels of 4 pixels
+    struct ChannelShuffles
+    {
+        uint8_t m_data[4][16];
+
+        constexpr ChannelShuffles(uint32_t first, uint32_t last) : m_data()
+        {
+            for (uint32_t y = 0; y < 4; y++)
+            {
+                for (uint32_t x = 0; x < 4; x++)
+                {
+                    for (uint32_t channel = 0; channel < 4; channel++)
+                        m_data[y][x * 4 + channel] = (channel >= first && channel <= last) ? static_cast<uint8_t>(y * 4 + x) : 0x80;
+                }
+            }
+        }
+    };
+
+    constexpr ChannelShuffles redShuffles(0, 0);
+    constexpr ChannelShuffles greenShuffles(1, 1);
+    constexpr ChannelShuffles alphaShuffles(3, 3);
+    constexpr ChannelShuffles greyShuffles(0, 2);
+
+    // pshufb controls swapping alpha with the BC7 rotation channel
+    struct RotationShuffles
+    {
+        uint8_t m_data[4][16];
+
+        constexpr RotationShuffles() : m_data()
+        {
+            for (uint32_t rotation = 0; rotation < 4; rotation++)
+            {
+                for (uint32_t i = 0; i < 16; i++)
+                {
+                    uint32_t channel = i & 3;
+
+                    if (rotation && channel == 3)
+                        channel = rotation - 1;
+                    else if (rotation && channel == rotation - 1)
+                        channel = 3;
+
+                    m_data[rotation][i] = static_cast<uint8_t>((i & ~3u) | channel);
+                }
+            }
+        }
+    };
+
+    constexpr RotationShuffles rotationShuffles;
+
+    BCN_INLINE BCN_SSE41 __m128i loadShuffle(const uint8_t* shuffle)
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(shuffle));
+    }
+
+    BCN_INLINE BCN_SSE41 __m128i getColorPalette(const uint8_t* block, bool fourColors)
+    {
+        uint8_t colors[4][4];
+
+        getColorPalette(block, colors, fourColors);
+
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(colors));
+    }
+
+    BCN_INLINE BCN_SSE41 void decodeColorRows(const uint8_t* block, bool fourColors, __m128i rows[4])
+    {
+        const __m128i palette = getColorPalette(block, fourColors);
+
+        for (size_t y = 0; y < 4; y++)
+            rows[y] = _mm_shuffle_epi8(palette, loadShuffle(colorShuffles.m_data[block[4 + y]]));
+    }
+
+    // the 16 3 bit indices are expanded to bytes and used to look up the palette
+    BCN_INLINE BCN_SSE41 __m128i decodeChannelValues(const uint8_t* block)
+    {
+        uint8_t values[8];
+
+        getChannelPalette(block, values);
+
+        const __m128i palette = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(values));
+        const __m128i bytes = _mm_srli_si128(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(block)), 2);
+
+        // each 16 bit lane gets the 2 bytes holding its index, then a high multiply shifts it down
+        const __m128i low = _mm_shuffle_epi8(bytes, _mm_setr_epi8(0, 1, 0, 1, 0, 1, 1, 2, 1, 2, 1, 2, 2, 3, 2, 3));
+        const __m128i high = _mm_shuffle_epi8(bytes, _mm_setr_epi8(3, 4, 3, 4, 3, 4, 4, 5, 4, 5, 4, 5, 5, 6, 5, 6));
+        const __m128i shifts = _mm_setr_epi16(-32768, 4096, 512, 16384, 2048, 256, 8192, 1024);
+        const __m128i mask = _mm_set1_epi16(7);
+        const __m128i lowIndices = _mm_and_si128(_mm_mulhi_epu16(_mm_slli_epi16(low, 1), shifts), mask);
+        const __m128i highIndices = _mm_and_si128(_mm_mulhi_epu16(_mm_slli_epi16(high, 1), shifts), mask);
+
+        return _mm_shuffle_epi8(palette, _mm_packus_epi16(lowIndices, highIndices));
+    }
+
+    BCN_INLINE BCN_SSE41 __m128i decodeExplicitAlphaValues(const uint8_t* block)
+    {
+        const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(block));
+        const __m128i mask = _mm_set1_epi8(0xf);
+        const __m128i low = _mm_and_si128(bytes, mask);
+        const __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+        const __m128i alpha = _mm_unpacklo_epi8(low, high);
+
+        return _mm_or_si128(alpha, _mm_slli_epi16(alpha, 4));
+    }
+
+    BCN_INLINE BCN_SSE41 void insertAlpha(__m128i rows[4], __m128i alpha)
+    {
+        const __m128i colorMask = _mm_set1_epi32(0x00ffffff);
+
+        for (size_t y = 0; y < 4; y++)
+            rows[y] = _mm_or_si128(_mm_and_si128(rows[y], colorMask), _mm_shuffle_epi8(alpha, loadShuffle(alphaShuffles.m_data[y])));
+    }
+
+    BCN_INLINE BCN_SSE41 void interpolateBC7Row(const BC7Block& unpacked, size_t y, __m128i& row)
+    {
+        const __m128i endpoint0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(unpacked.m_endpoints[0] + y * 16));
+        const __m128i endpoint1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(unpacked.m_endpoints[1] + y * 16));
+        const __m128i weights = _mm_loadu_si128(reinterpret_cast<const __m128i*>(unpacked.m_weights + y * 16));
+        const __m128i sixtyFour = _mm_set1_epi16(64);
+        const __m128i round = _mm_set1_epi16(32);
+        __m128i       result[2];
+
+        for (int half = 0; half < 2; half++)
+        {
+            const __m128i value0 = _mm_cvtepu8_epi16(half ? _mm_srli_si128(endpoint0, 8) : endpoint0);
+            const __m128i value1 = _mm_cvtepu8_epi16(half ? _mm_srli_si128(endpoint1, 8) : endpoint1);
+            const __m128i weight = _mm_cvtepu8_epi16(half ? _mm_srli_si128(weights, 8) : weights);
+            const __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(sixtyFour, weight), value0), _mm_mullo_epi16(weight, value1)), round);
+
+            result[half] = _mm_srli_epi16(sum, 6);
+        }
+
+        row = _mm_shuffle_epi8(_mm_packus_epi16(result[0], result[1]), loadShuffle(rotationShuffles.m_data[unpacked.m_rotation]));
+    }
+
+    BCN_INLINE BCN_SSE41 void decodeBC7Rows(const uint8_t* block, __m128i rows[4])
+    {
+        BC7Block unpacked;
+
+        if (!unpackBC7Block(block, unpacked))
+        {
+            for (size_t y = 0; y < 4; y++)
+                rows[y] = _mm_setzero_si128();
+
+            return;
+        }
+
+        for (size_t y = 0; y < 4; y++)
+            interpolateBC7Row(unpacked, y, rows[y]);
+    }
+
+    BCN_INLINE BCN_SSE41 void decodeBlockSSE41(dds::Format format, const uint8_t* block, __m128i rows[4])
+    {
+        const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xff000000));
+
+        switch (format)
+        {
+        case dds::BC1:
+            decodeColorRows(block, false, rows);
+            break;
+        case dds::BC2:
+            decodeColorRows(block + 8, true, rows);
+            insertAlpha(rows, decodeExplicitAlphaValues(block));
+            break;
+        case dds::BC3:
+            decodeColorRows(block + 8, true, rows);
+            insertAlpha(rows, decodeChannelValues(block));
+            break;
+        case dds::BC4:
+        {
+            const __m128i grey = decodeChannelValues(block);
+
+            for (size_t y = 0; y < 4; y++)
+                rows[y] = _mm_or_si128(_mm_shuffle_epi8(grey, loadShuffle(greyShuffles.m_data[y])), opaque);
+            break;
+        }
+        case dds::BC5:
+        {
+            const __m128i red = decodeChannelValues(block);
+            const __m128i green = decodeChannelValues(block + 8);
+
+            for (size_t y = 0; y < 4; y++)
+                rows[y] = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(red, loadShuffle(redShuffles.m_data[y])), _mm_shuffle_epi8(green, loadShuffle(greenShuffles.m_data[y]))), opaque);
+            break;
+        }
+        case dds::BC7:
+            decodeBC7Rows(block, rows);
+            break;
+        default:
+            throw std::runtime_error("Unsupported block format: " + dds::to_string(format));
+        }
+    }
+
+    BCN_INLINE BCN_SSE41 void storeRows(const __m128i rows[4], uint8_t* pixels, size_t stride, size_t width, size_t height)
+    {
+        if (width == 4 && height == 4)
+        {
+            for (size_t y = 0; y < 4; y++)
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + y * stride), rows[y]);
+
+            return;
+        }
+
+        uint8_t block[16 * 4];
+
+        for (size_t y = 0; y < 4; y++)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(block + y * 16), rows[y]);
+
+        copyBlock(block, pixels, stride, width, height);
+    }
+
+    BCN_SSE41 void decodeRowSSE41(dds::Format format, const uint8_t* blocks, uint8_t* pixels, size_t stride, uint32_t width, uint32_t height)
+    {
+        const size_t    blockSize = bcn::getBlockSize(format);
+        __m128i         rows[4];
+
+        for (uint32_t x = 0; x < width; x += 4, blocks += blockSize)
+        {
+            decodeBlockSSE41(format, blocks, rows);
+            storeRows(rows, pixels + x * 4, stride, std::min<uint32_t>(4, width - x), height);
+        }
+    }
+
+    // two blocks side by side share one 256 bit shuffle per row
+    BCN_INLINE BCN_AVX2 void decodeColorRowsAVX2(const uint8_t* block0, const uint8_t* block1, bool fourColors, __m256i rows[4])
+    {
+        const __m256i palette = _mm256_setr_m128i(getColorPalette(block0, fourColors), getColorPalette(block1, fourColors));
+
+        for (size_t y = 0; y < 4; y++)
+        {
+            const __m256i shuffle = _mm256_setr_m128i(loadShuffle(colorShuffles.m_data[block0[4 + y]]), loadShuffle(colorShuffles.m_data[block1[4 + y]]));
+
+            rows[y] = _mm256_shuffle_epi8(palette, shuffle);
+        }
+    }
+
+    BCN_INLINE BCN_AVX2 void insertAlphaAVX2(__m256i rows[4], __m128i alpha0, __m128i alpha1)
+    {
+        const __m256i colorMask = _mm256_set1_epi32(0x00ffffff);
+        const __m256i alpha = _mm256_setr_m128i(alpha0, alpha1);
+
+        for (size_t y = 0; y < 4; y++)
+        {
+            const __m128i shuffle = loadShuffle(alphaShuffles.m_data[y]);
+
+            rows[y] = _mm256_or_si256(_mm256_and_si256(rows[y], colorMask), _mm256_shuffle_epi8(alpha, _mm256_setr_m128i(shuffle, shuffle)));
+        }
+    }
+
+    // the interpolation of a BC7 row is done in 16 bit lanes of one 256 bit register
+    BCN_INLINE BCN_AVX2 void decodeBC7RowsAVX2(const uint8_t* block, __m128i rows[4])
+    {
+        BC7Block unpacked;
+
+        if (!unpackBC7Block(block, unpacked))
+        {
+            for (size_t y = 0; y < 4; y++)
+                rows[y] = _mm_setzero_si128();
+
+            return;
+        }
+
+        const __m256i sixtyFour = _mm256_set1_epi16(64);
+        const __m256i round = _mm256_set1_epi16(32);
+        const __m128i rotation = loadShuffle(rotationShuffles.m_data[unpacked.m_rotation]);
+
+        for (size_t y = 0; y < 4; y++)
+        {
+            const __m256i value0 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(unpacked.m_endpoints[0] + y * 16)));
+            const __m256i value1 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(unpacked.m_endpoints[1] + y * 16)));
+            const __m256i weight = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(unpacked.m_weights + y * 16)));
+            const __m256i sum = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(sixtyFour, weight), value0), _mm256_mullo_epi16(weight, value1)), round);
+            const __m256i result = _mm256_srli_epi16(sum, 6);
+
+            rows[y] = _mm_shuffle_epi8(_mm_packus_epi16(_mm256_castsi256_si128(result), _mm256_extracti128_si256(result, 1)), rotation);
+        }
+    }
+
+    BCN_AVX2 void decodeRowAVX2(dds::Format format, const uint8_t* blocks, uint8_t* pixels, size_t stride, uint32_t width, uint32_t height)
+    {
+        const size_t    blockSize = bcn::getBlockSize(format);
+        const bool      color = format == dds::BC1 || format == dds::BC2 || format == dds::BC3;
+        uint32_t        x = 0;
+
+        // pairs of whole blocks
+        if (color && height == 4)
+        {
+            __m256i rows[4];
+
+            for (; x + 8 <= width; x += 8, blocks += blockSize * 2)
+            {
+                if (format == dds::BC1)
+                    decodeColorRowsAVX2(blocks, blocks + blockSize, false, rows);
+                else
+                {
+                    const bool      explicitAlpha = format == dds::BC2;
+                    const __m128i   alpha0 = explicitAlpha ? decodeExplicitAlphaValues(blocks) : decodeChannelValues(blocks);
+                    const __m128i   alpha1 = explicitAlpha ? decodeExplicitAlphaValues(blocks + blockSize) : decodeChannelValues(blocks + blockSize);
+
+                    decodeColorRowsAVX2(blocks + 8, blocks + blockSize + 8, true, rows);
+                    insertAlphaAVX2(rows, alpha0, alpha1);
+                }
+
+                for (size_t y = 0; y < 4; y++)
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + y * stride + x * 4), rows[y]);
+            }
+        }
+
+        // the SSE4.1 helpers inlined here are VEX encoded too
+        __m128i rows[4];
+
+        for (; x < width; x += 4, blocks += blockSize)
+        {
+            if (format == dds::BC7)
+                decodeBC7RowsAVX2(blocks, rows);
+            else
+                decodeBlockSSE41(format, blocks, rows);
+
+            storeRows(rows, pixels + x * 4, stride, std::min<uint32_t>(4, width - x), height);
+        }
+
+        _mm256_zeroupper();
+    }
+#endif
+}
+
+size_t bcn::getBlockSize(dds::Format format)
+{
+    return (format == dds::BC1 || format == dds::BC4) ? 8 : 16;
+}
+
+void bcn::decodeRow(dds::Format format, const uint8_t* blocks, uint8_t* pixels, size_t stride, uint32_t width, uint32_t height, cpu::Isa isa)
+{
+#ifdef BCN_X86
+    if (isa == cpu::AVX2)
+    {
+        decodeRowAVX2(format, blocks, pixels, stride, width, height);
+
+        return;
+    }
+
+    if (isa == cpu::SSE41)
+    {
+        decodeRowSSE41(format, blocks, pixels, stride, width, height);
+
+        return;
+    }
+#else
+    (void)isa;
+#endif
+
+    decodeRowScalar(format, blocks, pixels, stride, width, height);
+}
@@ -0,0 +1,20 @@
+#ifndef _BCN_H_
+#define _BCN_H_
+
+#include "dds.h"
+
+#include <cstdint>
+#include <cstddef>
+
+// Block compressed texture decoders writing 8 bit RGBA rows.
+// The SSE4.1 and AVX2 kernels give exactly the same pixels as the scalar ones.
+class bcn
+{
+public:
+    static size_t getBlockSize(dds::Format format);
+
+    // decodes width / 4 rounded up blocks into the first height (at most 4) rows of pixels
+    static void decodeRow(dds::Format format, const uint8_t* blocks, uint8_t* pixels, size_t stride, uint32_t width, uint32_t height, cpu::Isa isa);
+};
+
+#endif
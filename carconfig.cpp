@@ -0,0 +1,106 @@
+#include "carconfig.h"
+#include "datasource.h"
+#include "jobs.h"
+
+#include <stdexcept>
+
+const char* carconfig::getFileName(File file)
+{
+    static const char* const names[FileCount] =
+    {
+        "aero.ini", "brakes.ini", "car.ini", "drivetrain.ini", "engine.ini", "lods.ini", "setup.ini", "suspensions.ini", "tyres.ini", "driver3d.ini"
+    };
+
+    return names[file];
+}
+
+void carconfig::read(const datasource& data, unsigned int threads)
+{
+    jobs pool(threads);
+
+    read(data, pool);
+}
+
+void carconfig::read(const datasource& data, jobs& threads)
+{
+    m_luts.clear();
+
+    jobs pool(threads);
+
+    for (size_t i = 0; i < FileCount; i++)
+    {
+        const std::string name = getFileName(static_cast<File>(i));
+
+        m_inis[i] = Ini();
+        m_inis[i].m_exists = data.exists(name);
+
+        pool.add(name, [this, &data, i, name]()
+        {
+            m_inis[i].m_ini.read(data, name);
+        });
+    }
+
+    for (const auto& error : pool.wait())
+    {
+        for (size_t i = 0; i < FileCount; i++)
+        {
+            if (error.m_name == getFileName(static_cast<File>(i)))
+                m_inis[i].m_error = error.m_message;
+        }
+    }
+
+    // the luts can only be found once the ini files are read
+    const auto addLut = [this, &data](File file, const char* section, const char* key)
+    {
+        if (!m_inis[file].m_error.empty())
+            return;
+
+        const std::string name = m_inis[file].m_ini.getValue(section, key);
+
+        if (!name.empty() && m_luts.find(name) == m_luts.end())
+            m_luts[name].m_exists = data.exists(name);
+    };
+
+    addLut(Aero, "WING_0", "LUT_AOA_CD");
+    addLut(Aero, "WING_0", "LUT_AOA_CL");
+    addLut(Engine, "HEADER", "POWER_CURVE");
+
+    for (auto& entry : m_luts)
+    {
+        pool.add(entry.first, [&data, &entry]()
+        {
+            entry.second.m_lut.read(data, entry.first);
+        });
+    }
+
+    for (const auto& error : pool.wait())
+        m_luts[error.m_name].m_error = error.m_message;
+}
+
+const ini& carconfig::get(File file) const
+{
+    if (!m_inis[file].m_error.empty())
+        throw std::runtime_error(m_inis[file].m_error);
+
+    return m_inis[file].m_ini;
+}
+
+bool carconfig::hasLut(const std::string& name) const
+{
+    const auto it = m_luts.find(name);
+
+    return it != m_luts.end() && it->second.m_exists;
+}
+
+const lut& carconfig::getLut(const std::string& name) const
+{
+    const auto it = m_luts.find(name);
+
+    if (it == m_luts.end())
+        throw std::runtime_error("Couldn't find: " + name);
+
+    if (!it->second.m_error.empty())
+        throw std::runtime_error(it->second.m_error);
+
+    return it->second.m_lut;
+}
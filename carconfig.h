@@ -0,0 +1,71 @@
+#ifndef _CARCONFIG_H_
+#define _CARCONFIG_H_
+
+#include "ini.h"
+#include "lut.h"
+
+#include <array>
+#include <map>
+#include <string>
+
+class datasource;
+class jobs;
+
+// The ini files of a car and the lut files they refer to that a conversion uses, read once on several threads.
+// A file that couldn't be read only throws its error when it is requested so only the steps using it fail.
+class carconfig
+{
+public:
+    enum File { Aero, Brakes, Car, Drivetrain, Engine, Lods, Setup, Suspensions, Tyres, Driver3d, FileCount };
+
+    static const char* getFileName(File file);
+
+private:
+    struct Ini
+    {
+        ini         m_ini;
+        bool        m_exists = false;
+        std::string m_error;
+    };
+
+    struct Lut
+    {
+        lut         m_lut;
+        bool        m_exists = false;
+        std::string m_error;
+    };
+
+    std::array<Ini, FileCount>  m_inis;
+    std::map<std::string, Lut>  m_luts;
+
+public:
+    carconfig() = default;
+    // a thread count of 0 uses one thread per core
+    explicit carconfig(const datasource& data, unsigned int threads = 0)
+    {
+        read(data, threads);
+    }
+
+    // on the threads of pool
+    carconfig(const datasource& data, jobs& pool)
+    {
+        read(data, pool);
+    }
+
+    void read(const datasource& data, unsigned int threads = 0);
+    void read(const datasource& data, jobs& pool);
+
+    bool has(File file) const
+    {
+        return m_inis[file].m_exists;
+    }
+
+    // throws when the file couldn't be read
+    const ini& get(File file) const;
+
+    // the luts of the aero wings and the engine power curve
+    bool hasLut(const std::string& name) const;
+    const lut& getLut(const std::string& name) const;
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include "contenthash.h"
+
+#include <algorithm>
+
+namespace
+{
+    uint64_t rotl(uint64_t value, int count)
+    {
+        return (value << count) | (value >> (64 - count));
+    }
+
+    uint64_t readUint64(const uint8_t* data)
+    {
+        uint64_t value = 0;
+
+        for (size_t i = 0; i < 8; i++)
+            value |= static_cast<uint64_t>(data[i]) << (i * 8);
+
+        return value;
+    }
+
+    uint64_t mix(uint64_t value)
+    {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdull;
+        value ^= value >> 33;
+        value *= 0xc4ceb9fe1a85ec53ull;
+        value ^= value >> 33;
+
+        return value;
+    }
+
+    constexpr uint64_t c1 = 0x87c37b91114253d5ull;
+    constexpr uint64_t c2 = 0x4cf5ad432745937full;
+}
+
+contenthash::contenthash(const void* data, size_t size, uint64_t seed)
+{
+    const uint8_t*  bytes = static_cast<const uint8_t*>(data);
+    const size_t    blocks = size / 16;
+    uint64_t        h1 = seed;
+    uint64_t        h2 = seed;
+
+    for (size_t i = 0; i < blocks; i++)
+    {
+        uint64_t k1 = readUint64(bytes + i * 16);
+        uint64_t k2 = readUint64(bytes + i * 16 + 8);
+
+        k1 *= c1;
+        k1 = rotl(k1, 31);
+        k1 *= c2;
+        h1 ^= k1;
+
+        h1 = rotl(h1, 27);
+        h1 += h2;
+        h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= c2;
+        k2 = rotl(k2, 33);
+        k2 *= c1;
+        h2 ^= k2;
+
+        h2 = rotl(h2, 31);
+        h2 += h1;
+        h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    const uint8_t*  tail = bytes + blocks * 16;
+    uint64_t        k1 = 0;
+    uint64_t        k2 = 0;
+
+    for (size_t i = size & 15; i > 8; i--)
+        k2 ^= static_cast<uint64_t>(tail[i - 1]) << ((i - 9) * 8);
+
+    if ((size & 15) > 8)
+    {
+        k2 *= c2;
+        k2 = rotl(k2, 33);
+        k2 *= c1;
+        h2 ^= k2;
+    }
+
+    for (size_t i = std::min<size_t>(size & 15, 8); i > 0; i--)
+        k1 ^= static_cast<uint64_t>(tail[i - 1]) << ((i - 1) * 8);
+
+    if (size & 15)
+    {
+        k1 *= c1;
+        k1 = rotl(k1, 31);
+        k1 *= c2;
+        h1 ^= k1;
+    }
+
+    h1 ^= size;
+    h2 ^= size;
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = mix(h1);
+    h2 = mix(h2);
+
+    h1 += h2;
+    h2 += h1;
+
+    m_high = h1;
+    m_low = h2;
+}
+
+std::string contenthash::to_string() const
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string string;
+
+    string.reserve(32);
+
+    for (const uint64_t value : { m_high, m_low })
+    {
+        for (int shift = 60; shift >= 0; shift -= 4)
+            string.push_back(digits[(value >> shift) & 0xf]);
+    }
+
+    return string;
+}
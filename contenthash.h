@@ -0,0 +1,35 @@
+#ifndef _CONTENTHASH_H_
+#define _CONTENTHASH_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// 128 bit content hash (MurmurHash3 x64 128) used to find identical files
+class contenthash
+{
+    uint64_t    m_high = 0;
+    uint64_t    m_low = 0;
+
+public:
+    contenthash() = default;
+    contenthash(const void* data, size_t size, uint64_t seed = 0);
+
+    bool operator==(const contenthash& other) const
+    {
+        return m_high == other.m_high && m_low == other.m_low;
+    }
+    bool operator!=(const contenthash& other) const
+    {
+        return !(*this == other);
+    }
+    bool operator<(const contenthash& other) const
+    {
+        return m_high < other.m_high || (m_high == other.m_high && m_low < other.m_low);
+    }
+
+    // 32 lower case hex digits
+    std::string to_string() const;
+};
+
+#endif
@@ -0,0 +1,25 @@
+#include "cpu.h"
+
+cpu::Isa cpu::getSupportedIsa()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    static const Isa isa = __builtin_cpu_supports("avx2") ? AVX2 : (__builtin_cpu_supports("sse4.1") ? SSE41 : Scalar);
+
+    return isa;
+#else
+    return Scalar;
+#endif
+}
+
+std::string cpu::to_string(Isa isa)
+{
+    switch (isa)
+    {
+    case SSE41:
+        return "SSE4.1";
+    case AVX2:
+        return "AVX2";
+    default:
+        return "Scalar";
+    }
+}
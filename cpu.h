@@ -0,0 +1,16 @@
+#ifndef _CPU_H_
+#define _CPU_H_
+
+#include <string>
+
+// Instruction sets of the SIMD code paths, the best one the cpu supports is used by default
+class cpu
+{
+public:
+    enum Isa { Scalar, SSE41, AVX2 };
+
+    static Isa getSupportedIsa();
+    static std::string to_string(Isa isa);
+};
+
+#endif
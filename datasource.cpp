@@ -0,0 +1,54 @@
+#include "datasource.h"
+#include "acd.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+datasource::datasource(const std::string& directory) : m_directory(directory)
+{
+}
+
+datasource::datasource(std::shared_ptr<const acd> archive, const std::string& fileName) : m_directory(fileName), m_archive(std::move(archive))
+{
+}
+
+bool datasource::exists(const std::string& name) const
+{
+    if (m_archive)
+        return m_archive->hasEntry(name);
+
+    return std::filesystem::is_regular_file(getFileName(name));
+}
+
+std::string datasource::read(const std::string& name) const
+{
+    if (m_archive)
+    {
+        const std::string* data = m_archive->getData(name);
+
+        if (!data)
+            throw std::runtime_error("Couldn't find: " + name + " in " + m_directory);
+
+        return *data;
+    }
+
+    const std::string fileName = getFileName(name);
+
+    std::ifstream stream(fileName, std::ios::binary);
+
+    if (!stream)
+        throw std::runtime_error("Couldn't open file: " + fileName);
+
+    std::ostringstream contents;
+
+    contents << stream.rdbuf();
+
+    return contents.str();
+}
+
+std::string datasource::getFileName(const std::string& name) const
+{
+    return std::filesystem::path(m_directory).append(name).string();
+}
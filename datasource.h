@@ -0,0 +1,31 @@
+#ifndef _DATASOURCE_H_
+#define _DATASOURCE_H_
+
+#include <memory>
+#include <string>
+
+class acd;
+
+// The ini and lut files of a car, read from its data directory or from the decrypted entries of its data.acd file.
+// Nothing is written to disk for the acd entries.
+class datasource
+{
+    std::string                 m_directory;
+    std::shared_ptr<const acd>  m_archive;
+
+public:
+    datasource() = default;
+    explicit datasource(const std::string& directory);
+    // fileName is only used in messages
+    datasource(std::shared_ptr<const acd> archive, const std::string& fileName);
+
+    bool exists(const std::string& name) const;
+
+    // the contents of the file called name, throws when there is no such file
+    std::string read(const std::string& name) const;
+
+    // the path of the file called name for messages
+    std::string getFileName(const std::string& name) const;
+};
+
+#endif
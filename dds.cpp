@@ -0,0 +1,388 @@
+#include "dds.h"
+#include "bcn.h"
+
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DDS_X86
+#include <immintrin.h>
+#define DDS_SSE2 __attribute__((target("sse2")))
+#endif
+
+namespace
+{
+    constexpr uint32_t DDPF_ALPHAPIXELS = 0x1;
+    constexpr uint32_t DDPF_ALPHA = 0x2;
+    constexpr uint32_t DDPF_FOURCC = 0x4;
+    constexpr uint32_t DDPF_RGB = 0x40;
+    constexpr uint32_t DDPF_LUMINANCE = 0x20000;
+
+    constexpr uint32_t makeFourCC(char a, char b, char c, char d)
+    {
+        return static_cast<uint32_t>(static_cast<uint8_t>(a)) |
+               (static_cast<uint32_t>(static_cast<uint8_t>(b)) << 8) |
+               (static_cast<uint32_t>(static_cast<uint8_t>(c)) << 16) |
+               (static_cast<uint32_t>(static_cast<uint8_t>(d)) << 24);
+    }
+
+    uint32_t readUint32(const uint8_t* data)
+    {
+        return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+               (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+    }
+
+    uint32_t getShift(uint32_t mask)
+    {
+        uint32_t shift = 0;
+
+        while (shift < 32 && (mask & (1u << shift)) == 0)
+            shift++;
+
+        return shift;
+    }
+
+    uint8_t extract(uint32_t pixel, uint32_t mask)
+    {
+        if (mask == 0)
+            return 0;
+
+        const uint32_t shift = getShift(mask);
+        const uint32_t maximum = mask >> shift;
+
+        return static_cast<uint8_t>(((pixel & mask) >> shift) * 255 / maximum);
+    }
+}
+
+std::string dds::to_string(Format format)
+{
+    switch (format)
+    {
+    case BC1:
+        return "BC1";
+    case BC2:
+        return "BC2";
+    case BC3:
+        return "BC3";
+    case BC4:
+        return "BC4";
+    case BC5:
+        return "BC5";
+    case BC7:
+        return "BC7";
+    case Uncompressed:
+        return "Uncompressed";
+    default:
+        return "Unknown";
+    }
+}
+
+bool dds::isDDS(const void* data, size_t size)
+{
+    return size >= 128 && std::memcmp(data, "DDS ", 4) == 0;
+}
+
+void dds::read(const std::string& fileName)
+{
+    std::ifstream stream(fileName, std::ios::binary);
+
+    if (!stream)
+        throw std::runtime_error("Couldn't open file: " + fileName);
+
+    m_buffer.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+
+    read(m_buffer.data(), m_buffer.size());
+}
+
+void dds::read(const void* data, size_t size)
+{
+    m_data = static_cast<const uint8_t*>(data);
+    m_size = size;
+
+    if (!isDDS(data, size) || readUint32(m_data + 4) != 124)
+        throw std::runtime_error("Not a valid dds file");
+
+    m_height = readUint32(m_data + 12);
+    m_width = readUint32(m_data + 16);
+    m_mipCount = std::max(readUint32(m_data + 28), 1u);
+    m_offset = 128;
+    m_format = Unknown;
+    m_luminance = false;
+
+    const uint32_t flags = readUint32(m_data + 80);
+    const uint32_t fourCC = readUint32(m_data + 84);
+
+    if (flags & DDPF_FOURCC)
+    {
+        if (fourCC == makeFourCC('D', 'X', 'T', '1'))
+            m_format = BC1;
+        else if (fourCC == makeFourCC('D', 'X', 'T', '2') || fourCC == makeFourCC('D', 'X', 'T', '3'))
+            m_format = BC2;
+        else if (fourCC == makeFourCC('D', 'X', 'T', '4') || fourCC == makeFourCC('D', 'X', 'T', '5'))
+            m_format = BC3;
+        else if (fourCC == makeFourCC('A', 'T', 'I', '1') || fourCC == makeFourCC('B', 'C', '4', 'U'))
+            m_format = BC4;
+        else if (fourCC == makeFourCC('A', 'T', 'I', '2') || fourCC == makeFourCC('B', 'C', '5', 'U'))
+            m_format = BC5;
+        else if (fourCC == makeFourCC('D', 'X', '1', '0'))
+        {
+            if (size < 148)
+                throw std::runtime_error("Not a valid dds file");
+
+            const uint32_t dxgiFormat = readUint32(m_data + 128);
+
+            m_offset = 148;
+
+            if (dxgiFormat >= 70 && dxgiFormat <= 72)
+                m_format = BC1;
+            else if (dxgiFormat >= 73 && dxgiFormat <= 75)
+                m_format = BC2;
+            else if (dxgiFormat >= 76 && dxgiFormat <= 78)
+                m_format = BC3;
+            else if (dxgiFormat >= 79 && dxgiFormat <= 81)
+                m_format = BC4;
+            else if (dxgiFormat >= 82 && dxgiFormat <= 84)
+                m_format = BC5;
+            else if (dxgiFormat >= 97 && dxgiFormat <= 99)
+                m_format = BC7;
+            else if (dxgiFormat >= 27 && dxgiFormat <= 29)
+            {
+                m_format = Uncompressed;
+                m_bitCount = 32;
+                m_masks[0] = 0x000000ff;
+                m_masks[1] = 0x0000ff00;
+                m_masks[2] = 0x00ff0000;
+                m_masks[3] = 0xff000000;
+            }
+            else if (dxgiFormat == 87 || dxgiFormat == 88 || (dxgiFormat >= 90 && dxgiFormat <= 93))
+            {
+                m_format = Uncompressed;
+                m_bitCount = 32;
+                m_masks[0] = 0x00ff0000;
+                m_masks[1] = 0x0000ff00;
+                m_masks[2] = 0x000000ff;
+                m_masks[3] = (dxgiFormat == 88 || dxgiFormat == 92 || dxgiFormat == 93) ? 0 : 0xff000000;
+            }
+            else
+                throw std::runtime_error("Unsupported dds DXGI format: " + std::to_string(dxgiFormat));
+        }
+        else
+            throw std::runtime_error("Unsupported dds format: " + std::string(reinterpret_cast<const char*>(m_data + 84), 4));
+    }
+    else if (flags & (DDPF_RGB | DDPF_LUMINANCE | DDPF_ALPHA))
+    {
+        m_format = Uncompressed;
+        m_bitCount = readUint32(m_data + 88);
+        m_masks[0] = readUint32(m_data + 92);
+        m_masks[1] = readUint32(m_data + 96);
+        m_masks[2] = readUint32(m_data + 100);
+        m_masks[3] = (flags & (DDPF_ALPHAPIXELS | DDPF_ALPHA)) ? readUint32(m_data + 104) : 0;
+        m_luminance = (flags & DDPF_LUMINANCE) != 0;
+
+        if (m_bitCount != 8 && m_bitCount != 16 && m_bitCount != 24 && m_bitCount != 32)
+            throw std::runtime_error("Unsupported dds bit count: " + std::to_string(m_bitCount));
+    }
+    else
+        throw std::runtime_error("Unsupported dds pixel format");
+
+    if (m_offset + getLevelSize(0) > m_size)
+        throw std::runtime_error("Truncated dds file");
+
+    // ignore mip levels that aren't in the file
+    uint32_t    levels = 0;
+    size_t      offset = m_offset;
+
+    while (levels < m_mipCount && offset + getLevelSize(levels) <= m_size)
+        offset += getLevelSize(levels++);
+
+    m_mipCount = levels;
+}
+
+void dds::dump(std::ostream& stream) const
+{
+    stream << "format:   " << to_string(m_format) << std::endl;
+    stream << "width:    " << m_width << std::endl;
+    stream << "height:   " << m_height << std::endl;
+    stream << "mipCount: " << m_mipCount << std::endl;
+
+    if (m_format == Uncompressed)
+    {
+        stream << "bitCount: " << m_bitCount << std::endl;
+        stream << "masks:    " << std::hex << m_masks[0] << ", " << m_masks[1] << ", " << m_masks[2] << ", " << m_masks[3] << std::dec << std::endl;
+    }
+}
+
+uint32_t dds::getWidth(uint32_t level) const
+{
+    return std::max(m_width >> level, 1u);
+}
+
+uint32_t dds::getHeight(uint32_t level) const
+{
+    return std::max(m_height >> level, 1u);
+}
+
+size_t dds::getLevelSize(uint32_t level) const
+{
+    const size_t width = getWidth(level);
+    const size_t height = getHeight(level);
+
+    if (m_format == Uncompressed)
+        return ((width * m_bitCount + 7) / 8) * height;
+
+    return ((width + 3) / 4) * ((height + 3) / 4) * bcn::getBlockSize(m_format);
+}
+
+dds::Image dds::decode(uint32_t level) const
+{
+    return decode(level, cpu::getSupportedIsa());
+}
+
+dds::Image dds::decode(uint32_t level, cpu::Isa isa) const
+{
+    if (level >= m_mipCount)
+        throw std::runtime_error("Missing dds mip level: " + std::to_string(level));
+
+    size_t offset = m_offset;
+
+    for (uint32_t i = 0; i < level; i++)
+        offset += getLevelSize(i);
+
+    const uint8_t*  data = m_data + offset;
+    Image           image;
+
+    image.m_width = getWidth(level);
+    image.m_height = getHeight(level);
+    image.m_pixels.resize(static_cast<size_t>(image.m_width) * image.m_height * 4);
+
+    if (m_format == Uncompressed)
+    {
+        const size_t bytes = m_bitCount / 8;
+        const size_t pitch = (static_cast<size_t>(image.m_width) * m_bitCount + 7) / 8;
+
+        for (size_t y = 0; y < image.m_height; y++)
+        {
+            const uint8_t*  row = data + y * pitch;
+            uint8_t*        pixel = image.m_pixels.data() + y * image.m_width * 4;
+
+            for (size_t x = 0; x < image.m_width; x++, row += bytes, pixel += 4)
+            {
+                uint32_t value = 0;
+
+                for (size_t i = 0; i < bytes; i++)
+                    value |= static_cast<uint32_t>(row[i]) << (i * 8);
+
+                pixel[0] = extract(value, m_masks[0]);
+                pixel[1] = m_luminance ? pixel[0] : extract(value, m_masks[1]);
+                pixel[2] = m_luminance ? pixel[0] : extract(value, m_masks[2]);
+                pixel[3] = m_masks[3] ? extract(value, m_masks[3]) : 255;
+            }
+        }
+
+        return image;
+    }
+
+    // a row of blocks is decoded straight into 4 rows of the image
+    const size_t    stride = static_cast<size_t>(image.m_width) * 4;
+    const size_t    rowSize = ((image.m_width + 3) / 4) * bcn::getBlockSize(m_format);
+
+    for (uint32_t y = 0; y < image.m_height; y += 4, data += rowSize)
+        bcn::decodeRow(m_format, data, image.m_pixels.data() + y * stride, stride, image.m_width, std::min<uint32_t>(4, image.m_height - y), isa);
+
+    return image;
+}
+
+uint32_t dds::getLevel(uint32_t size) const
+{
+    uint32_t level = 0;
+
+    while (level + 1 < m_mipCount && (getWidth(level) > size || getHeight(level) > size))
+        level++;
+
+    return level;
+}
+
+namespace
+{
+    void downscaleRowScalar(const uint8_t* row0, const uint8_t* row1, uint8_t* pixels, uint32_t width, uint32_t first, uint32_t last)
+    {
+        for (uint32_t x = first; x < last; x++)
+        {
+            const uint32_t x0 = x * 2;
+            const uint32_t x1 = std::min(x0 + 1, width - 1);
+
+            for (uint32_t i = 0; i < 4; i++)
+                pixels[x * 4 + i] = static_cast<uint8_t>((row0[x0 * 4 + i] + row0[x1 * 4 + i] + row1[x0 * 4 + i] + row1[x1 * 4 + i] + 2) >> 2);
+        }
+    }
+
+#ifdef DDS_X86
+    // 4 pixels from 8 pixels of 2 rows, the channels are added in 16 bit lanes
+    DDS_SSE2 __m128i averageSSE2(__m128i a, __m128i b)
+    {
+        const __m128i   zero = _mm_setzero_si128();
+        const __m128i   low = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+        const __m128i   high = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+        const __m128i   sum = _mm_add_epi16(_mm_unpacklo_epi64(low, high), _mm_unpackhi_epi64(low, high));
+
+        return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+    }
+
+    DDS_SSE2 uint32_t downscaleRowSSE2(const uint8_t* row0, const uint8_t* row1, uint8_t* pixels, uint32_t width)
+    {
+        uint32_t x = 0;
+
+        for (; x * 2 + 8 <= width; x += 4)
+        {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8 + 16));
+            const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+            const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8 + 16));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + x * 4), _mm_packus_epi16(averageSSE2(a, c), averageSSE2(b, d)));
+        }
+
+        return x;
+    }
+#endif
+}
+
+dds::Image dds::downscale(const Image& image)
+{
+    return downscale(image, cpu::getSupportedIsa());
+}
+
+dds::Image dds::downscale(const Image& image, cpu::Isa isa)
+{
+    Image   result;
+
+    result.m_width = std::max((image.m_width + 1) / 2, 1u);
+    result.m_height = std::max((image.m_height + 1) / 2, 1u);
+    result.m_pixels.resize(static_cast<size_t>(result.m_width) * result.m_height * 4);
+
+    if (image.m_width == 0 || image.m_height == 0)
+        return result;
+
+    const size_t    stride = static_cast<size_t>(image.m_width) * 4;
+
+    for (uint32_t y = 0; y < result.m_height; y++)
+    {
+        const uint8_t*  row0 = image.m_pixels.data() + y * 2 * stride;
+        const uint8_t*  row1 = image.m_pixels.data() + std::min(y * 2 + 1, image.m_height - 1) * stride;
+        uint8_t*        pixels = result.m_pixels.data() + static_cast<size_t>(y) * result.m_width * 4;
+        uint32_t        first = 0;
+
+#ifdef DDS_X86
+        if (isa != cpu::Scalar)
+            first = downscaleRowSSE2(row0, row1, pixels, image.m_width);
+#else
+        (void)isa;
+#endif
+
+        downscaleRowScalar(row0, row1, pixels, image.m_width, first, result.m_width);
+    }
+
+    return result;
+}
@@ -0,0 +1,81 @@
+#ifndef _DDS_H_
+#define _DDS_H_
+
+#include "cpu.h"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// DirectDraw Surface reader that decodes to 8 bit RGBA pixels
+class dds
+{
+public:
+    enum Format { Unknown, BC1, BC2, BC3, BC4, BC5, BC7, Uncompressed };
+
+    static std::string to_string(Format format);
+
+    struct Image
+    {
+        uint32_t                m_width = 0;
+        uint32_t                m_height = 0;
+        std::vector<uint8_t>    m_pixels;
+    };
+
+private:
+    std::vector<uint8_t>    m_buffer;
+    const uint8_t*          m_data = nullptr;
+    size_t                  m_size = 0;
+    size_t                  m_offset = 0;
+    Format                  m_format = Unknown;
+    uint32_t                m_width = 0;
+    uint32_t                m_height = 0;
+    uint32_t                m_mipCount = 1;
+    uint32_t                m_bitCount = 0;
+    uint32_t                m_masks[4] = { 0, 0, 0, 0 };
+    bool                    m_luminance = false;
+
+    size_t getLevelSize(uint32_t level) const;
+
+public:
+    dds() = default;
+    dds(const void* data, size_t size)
+    {
+        read(data, size);
+    }
+    explicit dds(const std::string& fileName)
+    {
+        read(fileName);
+    }
+    dds(const dds&) = delete;
+    dds& operator=(const dds&) = delete;
+
+    static bool isDDS(const void* data, size_t size);
+
+    // the data isn't copied and must stay valid while the image is decoded
+    void read(const void* data, size_t size);
+    void read(const std::string& fileName);
+    void dump(std::ostream& stream) const;
+    Format getFormat() const
+    {
+        return m_format;
+    }
+    uint32_t getWidth(uint32_t level = 0) const;
+    uint32_t getHeight(uint32_t level = 0) const;
+    uint32_t getMipCount() const
+    {
+        return m_mipCount;
+    }
+    Image decode(uint32_t level = 0) const;
+    Image decode(uint32_t level, cpu::Isa isa) const;
+
+    // the largest mip level no wider or higher than size, or the smallest level there is
+    uint32_t getLevel(uint32_t size) const;
+
+    // halves an image with a 2x2 box filter, the last row and column are repeated for odd sizes
+    static Image downscale(const Image& image);
+    static Image downscale(const Image& image, cpu::Isa isa);
+};
+
+#endif
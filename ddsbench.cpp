@@ -0,0 +1,547 @@
+#include "dds.h"
+#include "bake.h"
+#include "jobs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Measures the block decoders in megapixels per second and checks that every
+// instruction set decodes exactly the same pixels as a reference decoder that
+// shares no code with the library. The reference decodes one pixel at a time
+// the way the formats are described, not the way the library does it.
+
+namespace
+{
+    void writeUint32(std::vector<uint8_t>& data, size_t offset, uint32_t value)
+    {
+        for (size_t i = 0; i < 4; i++)
+            data[offset + i] = static_cast<uint8_t>(value >> (i * 8));
+    }
+
+    // dds file of random blocks, every block mode is covered
+    std::vector<uint8_t> makeDDS(dds::Format format, uint32_t width, uint32_t height)
+    {
+        const size_t    blockSize = (format == dds::BC1 || format == dds::BC4) ? 8 : 16;
+        const size_t    blocks = ((width + 3) / 4) * ((height + 3) / 4);
+        const bool      dx10 = format == dds::BC7;
+        const size_t    offset = dx10 ? 148 : 128;
+
+        std::vector<uint8_t> data(offset + blocks * blockSize, 0);
+
+        std::memcpy(data.data(), "DDS ", 4);
+        writeUint32(data, 4, 124);
+        writeUint32(data, 12, height);
+        writeUint32(data, 16, width);
+        writeUint32(data, 28, 1);
+        writeUint32(data, 76, 32);
+        writeUint32(data, 80, 0x4);
+
+        const char* fourCC = "DX10";
+
+        switch (format)
+        {
+        case dds::BC1:
+            fourCC = "DXT1";
+            break;
+        case dds::BC2:
+            fourCC = "DXT3";
+            break;
+        case dds::BC3:
+            fourCC = "DXT5";
+            break;
+        case dds::BC4:
+            fourCC = "ATI1";
+            break;
+        case dds::BC5:
+            fourCC = "ATI2";
+            break;
+        default:
+            break;
+        }
+
+        std::memcpy(data.data() + 84, fourCC, 4);
+
+        if (dx10)
+            writeUint32(data, 128, 98);
+
+        uint64_t seed = 0x9e3779b97f4a7c15ull + format;
+
+        for (size_t i = offset; i < data.size(); i++)
+        {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            data[i] = static_cast<uint8_t>(seed >> 56);
+        }
+
+        return data;
+    }
+
+    // bits first to last of a little endian block
+    uint32_t readBits(const uint8_t* block, size_t first, size_t count)
+    {
+        uint32_t value = 0;
+
+        for (size_t i = 0; i < count; i++)
+            value |= static_cast<uint32_t>((block[(first + i) / 8] >> ((first + i) % 8)) & 1) << i;
+
+        return value;
+    }
+
+    // the bits repeated down to 8 bits like the hardware does
+    uint32_t expand(uint32_t value, uint32_t bits)
+    {
+        return (value << (8 - bits)) | (value >> (2 * bits - 8));
+    }
+
+    void referenceColor(const uint8_t* block, size_t pixel, bool fourColors, uint8_t* rgba)
+    {
+        const uint32_t  color0 = readBits(block, 0, 16);
+        const uint32_t  color1 = readBits(block, 16, 16);
+        const uint32_t  index = readBits(block, 32 + pixel * 2, 2);
+        const uint32_t  rgb0[3] = { expand(color0 >> 11, 5), expand((color0 >> 5) & 0x3f, 6), expand(color0 & 0x1f, 5) };
+        const uint32_t  rgb1[3] = { expand(color1 >> 11, 5), expand((color1 >> 5) & 0x3f, 6), expand(color1 & 0x1f, 5) };
+        const bool      threeColors = !fourColors && color0 <= color1;
+
+        for (size_t channel = 0; channel < 3; channel++)
+        {
+            uint32_t value = 0;
+
+            if (index == 0)
+                value = rgb0[channel];
+            else if (index == 1)
+                value = rgb1[channel];
+            else if (threeColors)
+                value = index == 2 ? (rgb0[channel] + rgb1[channel]) / 2 : 0;
+            else
+                value = index == 2 ? (2 * rgb0[channel] + rgb1[channel]) / 3 : (rgb0[channel] + 2 * rgb1[channel]) / 3;
+
+            rgba[channel] = static_cast<uint8_t>(value);
+        }
+
+        rgba[3] = (threeColors && index == 3) ? 0 : 255;
+    }
+
+    uint8_t referenceChannel(const uint8_t* block, size_t pixel)
+    {
+        const uint32_t value0 = block[0];
+        const uint32_t value1 = block[1];
+        const uint32_t index = readBits(block, 16 + pixel * 3, 3);
+
+        if (index == 0)
+            return static_cast<uint8_t>(value0);
+
+        if (index == 1)
+            return static_cast<uint8_t>(value1);
+
+        if (value0 > value1)
+            return static_cast<uint8_t>(((8 - index) * value0 + (index - 1) * value1) / 7);
+
+        if (index == 6)
+            return 0;
+
+        if (index == 7)
+            return 255;
+
+        return static_cast<uint8_t>(((6 - index) * value0 + (index - 1) * value1) / 5);
+    }
+
+    // subset of each pixel, 1 bit a pixel for 2 subsets and 2 bits a pixel for 3 subsets
+    const uint32_t bc7Partitions2[64] =
+    {
+        0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80, 0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+        0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce, 0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+        0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a, 0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+        0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c, 0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22
+    };
+
+    const uint32_t bc7Partitions3[64] =
+    {
+        0xaa685050, 0x6a5a5040, 0x5a5a4200, 0x5450a0a8, 0xa5a50000, 0xa0a05050, 0x5555a0a0, 0x5a5a5050,
+        0xaa550000, 0xaa555500, 0xaaaa5500, 0x90909090, 0x94949494, 0xa4a4a4a4, 0xa9a59450, 0x2a0a4250,
+        0xa5945040, 0x0a425054, 0xa5a5a500, 0x55a0a0a0, 0xa8a85454, 0x6a6a4040, 0xa4a45000, 0x1a1a0500,
+        0x0050a4a4, 0xaaa59090, 0x14696914, 0x69691400, 0xa08585a0, 0xaa821414, 0x50a4a450, 0x6a5a0200,
+        0xa9a58000, 0x5090a0a8, 0xa8a09050, 0x24242424, 0x00aa5500, 0x24924924, 0x24499224, 0x50a50a50,
+        0x500aa550, 0xaaaa4444, 0x66660000, 0xa5a0a5a0, 0x50a050a0, 0x69286928, 0x44aaaa44, 0x66666600,
+        0xaa444444, 0x54a854a8, 0x95809580, 0x96969600, 0xa85454a8, 0x80959580, 0xaa141414, 0x96960000,
+        0xaaaa1414, 0xa05050a0, 0xa0a5a5a0, 0x96000000, 0x40804080, 0xa9a8a9a8, 0xaaaaaa44, 0x2a4a5254
+    };
+
+    // the pixel of the second subset, and of the third, whose index has one bit less
+    const uint8_t bc7Anchors2[64] =
+    {
+        15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+        15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+         6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+    };
+
+    const uint8_t bc7Anchors3[64][2] =
+    {
+        {  3, 15 }, {  3,  8 }, { 15,  8 }, { 15,  3 }, {  8, 15 }, {  3, 15 }, { 15,  3 }, { 15,  8 },
+        {  8, 15 }, {  8, 15 }, {  6, 15 }, {  6, 15 }, {  6, 15 }, {  5, 15 }, {  3, 15 }, {  3,  8 },
+        {  3, 15 }, {  3,  8 }, {  8, 15 }, { 15,  3 }, {  3, 15 }, {  3,  8 }, {  6, 15 }, { 10,  8 },
+        {  5,  3 }, {  8, 15 }, {  8,  6 }, {  6, 10 }, {  8, 15 }, {  5, 15 }, { 15, 10 }, { 15,  8 },
+        {  8, 15 }, { 15,  3 }, {  3, 15 }, {  5, 10 }, {  6, 10 }, { 10,  8 }, {  8,  9 }, { 15, 10 },
+        { 15,  6 }, {  3, 15 }, { 15,  8 }, {  5, 15 }, { 15,  3 }, { 15,  6 }, { 15,  6 }, { 15,  8 },
+        {  3, 15 }, { 15,  3 }, {  5, 15 }, {  5, 15 }, {  5, 15 }, {  8, 15 }, {  5, 15 }, { 10, 15 },
+        {  5, 15 }, { 10, 15 }, {  8, 15 }, { 13, 15 }, { 15,  3 }, { 12, 15 }, {  3, 15 }, {  3,  8 }
+    };
+
+    uint32_t getBC7Subset(uint32_t subsets, uint32_t partition, size_t pixel)
+    {
+        if (subsets == 2)
+            return (bc7Partitions2[partition] >> pixel) & 1;
+
+        if (subsets == 3)
+            return (bc7Partitions3[partition] >> (pixel * 2)) & 3;
+
+        return 0;
+    }
+
+    bool isBC7Anchor(uint32_t subsets, uint32_t partition, size_t pixel)
+    {
+        if (pixel == 0)
+            return true;
+
+        if (subsets == 2)
+            return pixel == bc7Anchors2[partition];
+
+        if (subsets == 3)
+            return pixel == bc7Anchors3[partition][0] || pixel == bc7Anchors3[partition][1];
+
+        return false;
+    }
+
+    uint32_t interpolateBC7(uint32_t value0, uint32_t value1, uint32_t index, uint32_t bits)
+    {
+        static const uint32_t weights2[4] = { 0, 21, 43, 64 };
+        static const uint32_t weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+        static const uint32_t weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+        const uint32_t        weight = bits == 2 ? weights2[index] : (bits == 3 ? weights3[index] : weights4[index]);
+
+        return ((64 - weight) * value0 + weight * value1 + 32) >> 6;
+    }
+
+    void referenceBC7(const uint8_t* block, size_t pixel, uint8_t* rgba)
+    {
+        // subsets, partition, rotation, index selection, color, alpha, endpoint p, shared p, index, second index bits
+        static const uint32_t modes[8][10] =
+        {
+            { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+            { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+            { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+            { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+            { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+            { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+            { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+            { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+        };
+
+        uint32_t mode = 0;
+
+        while (mode < 8 && readBits(block, mode, 1) == 0)
+            mode++;
+
+        if (mode == 8)
+        {
+            std::memset(rgba, 0, 4);
+
+            return;
+        }
+
+        const uint32_t* info = modes[mode];
+        const uint32_t  subsets = info[0];
+        size_t          position = mode + 1;
+        const uint32_t  partition = readBits(block, position, info[1]);
+        const uint32_t  rotation = readBits(block, position += info[1], info[2]);
+        const uint32_t  indexSelection = readBits(block, position += info[2], info[3]);
+
+        position += info[3];
+
+        // endpoints[subset][endpoint][channel]
+        uint32_t endpoints[3][2][4] = {};
+
+        for (uint32_t channel = 0; channel < 4; channel++)
+        {
+            const uint32_t bits = channel < 3 ? info[4] : info[5];
+
+            for (uint32_t subset = 0; subset < subsets; subset++)
+            {
+                for (uint32_t endpoint = 0; endpoint < 2; endpoint++, position += bits)
+                    endpoints[subset][endpoint][channel] = readBits(block, position, bits);
+            }
+        }
+
+        const bool  pbits = info[6] || info[7];
+        uint32_t    colorBits = info[4] + (pbits ? 1 : 0);
+        uint32_t    alphaBits = info[5] ? info[5] + (pbits ? 1 : 0) : 0;
+
+        for (uint32_t subset = 0; subset < subsets && pbits; subset++)
+        {
+            for (uint32_t endpoint = 0; endpoint < 2; endpoint++)
+            {
+                // a shared p bit is read once for both endpoints
+                const uint32_t pbit = readBits(block, info[6] ? position + subset * 2 + endpoint : position + subset, 1);
+
+                for (uint32_t channel = 0; channel < 4; channel++)
+                    endpoints[subset][endpoint][channel] = endpoints[subset][endpoint][channel] * 2 + pbit;
+            }
+        }
+
+        if (pbits)
+            position += subsets * (info[6] ? 2 : 1);
+
+        // the indices of all pixels before this one, with one bit less for the anchors
+        size_t indexPosition = position;
+
+        for (size_t i = 0; i < pixel; i++)
+            indexPosition += info[8] - (isBC7Anchor(subsets, partition, i) ? 1 : 0);
+
+        const uint32_t  index = readBits(block, indexPosition, info[8] - (isBC7Anchor(subsets, partition, pixel) ? 1 : 0));
+        uint32_t        colorIndex = index;
+        uint32_t        alphaIndex = index;
+        uint32_t        colorIndexBits = info[8];
+        uint32_t        alphaIndexBits = info[8];
+
+        if (info[9])
+        {
+            const size_t    secondPosition = position + 16 * info[8] - 1 + (pixel ? pixel * info[9] - 1 : 0);
+            const uint32_t  second = readBits(block, secondPosition, info[9] - (pixel == 0 ? 1 : 0));
+
+            if (indexSelection)
+            {
+                colorIndex = second;
+                colorIndexBits = info[9];
+            }
+            else
+            {
+                alphaIndex = second;
+                alphaIndexBits = info[9];
+            }
+        }
+
+        const uint32_t subset = getBC7Subset(subsets, partition, pixel);
+
+        for (uint32_t channel = 0; channel < 4; channel++)
+        {
+            const uint32_t bits = channel < 3 ? colorBits : alphaBits;
+
+            if (bits == 0)
+            {
+                rgba[channel] = 255;
+
+                continue;
+            }
+
+            const uint32_t value[2] = { expand(endpoints[subset][0][channel], bits), expand(endpoints[subset][1][channel], bits) };
+
+            rgba[channel] = static_cast<uint8_t>(channel < 3 ? interpolateBC7(value[0], value[1], colorIndex, colorIndexBits)
+                                                              : interpolateBC7(value[0], value[1], alphaIndex, alphaIndexBits));
+        }
+
+        if (rotation)
+            std::swap(rgba[3], rgba[rotation - 1]);
+    }
+
+    // decodes the dds file made by makeDDS one pixel at a time
+    dds::Image decodeReference(dds::Format format, const std::vector<uint8_t>& data, uint32_t width, uint32_t height)
+    {
+        const size_t    blockSize = (format == dds::BC1 || format == dds::BC4) ? 8 : 16;
+        const size_t    offset = format == dds::BC7 ? 148 : 128;
+        const size_t    blocksWide = (width + 3) / 4;
+        dds::Image      image;
+
+        image.m_width = width;
+        image.m_height = height;
+        image.m_pixels.resize(static_cast<size_t>(width) * height * 4);
+
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                const uint8_t*  block = data.data() + offset + ((y / 4) * blocksWide + x / 4) * blockSize;
+                const size_t    pixel = (y % 4) * 4 + x % 4;
+                uint8_t*        rgba = image.m_pixels.data() + (static_cast<size_t>(y) * width + x) * 4;
+
+                switch (format)
+                {
+                case dds::BC1:
+                    referenceColor(block, pixel, false, rgba);
+                    break;
+                case dds::BC2:
+                    referenceColor(block + 8, pixel, true, rgba);
+                    rgba[3] = static_cast<uint8_t>(readBits(block, pixel * 4, 4) * 17);
+                    break;
+                case dds::BC3:
+                    referenceColor(block + 8, pixel, true, rgba);
+                    rgba[3] = referenceChannel(block, pixel);
+                    break;
+                case dds::BC4:
+                    rgba[0] = rgba[1] = rgba[2] = referenceChannel(block, pixel);
+                    rgba[3] = 255;
+                    break;
+                case dds::BC5:
+                    rgba[0] = referenceChannel(block, pixel);
+                    rgba[1] = referenceChannel(block + 8, pixel);
+                    rgba[2] = 0;
+                    rgba[3] = 255;
+                    break;
+                case dds::BC7:
+                    referenceBC7(block, pixel, rgba);
+                    break;
+                default:
+                    throw std::runtime_error("Unsupported block format: " + dds::to_string(format));
+                }
+            }
+        }
+
+        return image;
+    }
+
+    double measure(const dds& texture, cpu::Isa isa, size_t iterations)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < iterations; i++)
+            texture.decode(0, isa);
+
+        const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+        const double pixels = static_cast<double>(texture.getWidth()) * texture.getHeight() * iterations;
+
+        return pixels / seconds.count() / 1e6;
+    }
+
+    double measureDownscale(const dds::Image& image, cpu::Isa isa, size_t iterations)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < iterations; i++)
+            dds::downscale(image, isa);
+
+        const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+        const double pixels = static_cast<double>(image.m_width) * image.m_height * iterations;
+
+        return pixels / seconds.count() / 1e6;
+    }
+
+    double measureMultiply(const dds::Image& image, const dds::Image& layer, cpu::Isa isa, size_t iterations)
+    {
+        dds::Image  result = image;
+        jobs        single(1);
+        const auto  start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < iterations; i++)
+            bake::multiply(result, layer, 7.0f, single, isa);
+
+        const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+        const double pixels = static_cast<double>(image.m_width) * image.m_height * iterations;
+
+        return pixels / seconds.count() / 1e6;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    size_t iterations = 10;
+
+    if (argc > 1)
+        iterations = std::stoul(argv[1]);
+
+    const dds::Format   formats[] = { dds::BC1, dds::BC2, dds::BC3, dds::BC4, dds::BC5, dds::BC7 };
+    const cpu::Isa      supported = cpu::getSupportedIsa();
+    bool                exact = true;
+
+    std::cout << "supported: " << cpu::to_string(supported) << std::endl;
+
+    for (auto format : formats)
+    {
+        // odd sizes check the partial blocks at the edges
+        for (auto size : { 2048u, 1023u })
+        {
+            const std::vector<uint8_t>  data = makeDDS(format, size, size - 2);
+            const dds                   texture(data.data(), data.size());
+            const dds::Image            reference = decodeReference(format, data, size, size - 2);
+
+            std::cout << std::setw(4) << dds::to_string(format) << " " << texture.getWidth() << "x" << texture.getHeight();
+
+            for (int isa = cpu::Scalar; isa <= supported; isa++)
+            {
+                const dds::Image image = texture.decode(0, static_cast<cpu::Isa>(isa));
+                const bool same = image.m_pixels == reference.m_pixels;
+
+                exact = exact && same;
+
+                std::cout << "  " << cpu::to_string(static_cast<cpu::Isa>(isa)) << " " << std::fixed << std::setprecision(1)
+                          << measure(texture, static_cast<cpu::Isa>(isa), iterations) << " MP/s" << (same ? "" : " MISMATCH");
+            }
+
+            std::cout << std::endl;
+        }
+    }
+
+    // the downscale has one SSE2 path, used for every isa above scalar
+    for (auto size : { 2048u, 1023u })
+    {
+        const std::vector<uint8_t>  data = makeDDS(dds::BC7, size, size - 2);
+        const dds                   texture(data.data(), data.size());
+        const dds::Image            image = texture.decode(0, cpu::Scalar);
+        const dds::Image            reference = dds::downscale(image, cpu::Scalar);
+
+        std::cout << "half " << image.m_width << "x" << image.m_height;
+
+        for (const cpu::Isa isa : { cpu::Scalar, supported })
+        {
+            const bool same = dds::downscale(image, isa).m_pixels == reference.m_pixels;
+
+            exact = exact && same;
+
+            std::cout << "  " << (isa == cpu::Scalar ? "Scalar" : "SSE2") << " " << std::fixed << std::setprecision(1)
+                      << measureDownscale(image, isa, iterations) << " MP/s" << (same ? "" : " MISMATCH");
+
+            if (supported == cpu::Scalar)
+                break;
+        }
+
+        std::cout << std::endl;
+    }
+
+    // detail layers are repeated across the image
+    for (auto size : { 2048u, 1023u })
+    {
+        const std::vector<uint8_t>  data = makeDDS(dds::BC1, size, size - 2);
+        const std::vector<uint8_t>  layerData = makeDDS(dds::BC3, 256, 256);
+        const dds                   texture(data.data(), data.size());
+        const dds                   layerTexture(layerData.data(), layerData.size());
+        const dds::Image            image = texture.decode(0, cpu::Scalar);
+        const dds::Image            layer = layerTexture.decode(0, cpu::Scalar);
+        dds::Image                  reference = image;
+        jobs                        single(1);
+
+        bake::multiply(reference, layer, 7.0f, single, cpu::Scalar);
+
+        std::cout << "bake " << image.m_width << "x" << image.m_height;
+
+        for (int isa = cpu::Scalar; isa <= supported; isa++)
+        {
+            dds::Image result = image;
+
+            bake::multiply(result, layer, 7.0f, single, static_cast<cpu::Isa>(isa));
+
+            const bool same = result.m_pixels == reference.m_pixels;
+
+            exact = exact && same;
+
+            std::cout << "  " << cpu::to_string(static_cast<cpu::Isa>(isa)) << " " << std::fixed << std::setprecision(1)
+                      << measureMultiply(image, layer, static_cast<cpu::Isa>(isa), iterations) << " MP/s" << (same ? "" : " MISMATCH");
+        }
+
+        std::cout << std::endl;
+    }
+
+    return exact ? EXIT_SUCCESS : EXIT_FAILURE;
+}
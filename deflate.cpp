@@ -0,0 +1,753 @@
+#include "deflate.h"
+#include "jobs.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    constexpr size_t    WINDOW_SIZE = 32768;
+    constexpr size_t    HASH_BITS = 15;
+    constexpr size_t    HASH_SIZE = 1 << HASH_BITS;
+    constexpr size_t    MIN_MATCH = 3;
+    constexpr size_t    MAX_MATCH = 258;
+    constexpr size_t    MAX_BLOCK_SYMBOLS = 1 << 15;
+    constexpr size_t    MAX_STORED_SIZE = 65535;
+    constexpr size_t    LITERAL_LENGTH_CODES = 286;
+    constexpr size_t    DISTANCE_CODES = 30;
+    constexpr size_t    CODE_LENGTH_CODES = 19;
+
+    // the input is split into chunks that are compressed independently
+    constexpr size_t    CHUNK_SIZE = 1 << 18;
+
+    struct Settings
+    {
+        size_t  m_maxChain;
+        size_t  m_niceLength;
+        bool    m_lazy;
+    };
+
+    const Settings settings[3] =
+    {
+        { 4, 32, false },   // Fast
+        { 32, 128, false }, // Default
+        { 256, 258, true }  // Small
+    };
+
+    const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+    const uint8_t codeLengthOrder[CODE_LENGTH_CODES] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    struct CodeTables
+    {
+        uint8_t m_lengthCode[MAX_MATCH + 1];
+        uint8_t m_distanceCode[512];
+
+        CodeTables()
+        {
+            for (uint8_t code = 0; code < 29; code++)
+            {
+                for (size_t length = lengthBase[code]; length < lengthBase[code] + (1u << lengthExtra[code]) && length <= MAX_MATCH; length++)
+                    m_lengthCode[length] = code;
+            }
+
+            // 258 has its own code even though 227 + 31 would also cover it
+            m_lengthCode[MAX_MATCH] = 28;
+
+            // distances up to 256 are looked up directly and larger ones by (distance - 1) >> 7
+            for (uint8_t code = 0; code < 30; code++)
+            {
+                for (size_t distance = distanceBase[code]; distance < distanceBase[code] + (1u << distanceExtra[code]); distance++)
+                {
+                    if (distance <= 256)
+                        m_distanceCode[distance - 1] = code;
+                    else
+                        m_distanceCode[256 + ((distance - 1) >> 7)] = code;
+                }
+            }
+        }
+
+        uint32_t distanceCode(uint32_t distance) const
+        {
+            return distance <= 256 ? m_distanceCode[distance - 1] : m_distanceCode[256 + ((distance - 1) >> 7)];
+        }
+    };
+
+    const CodeTables& getCodeTables()
+    {
+        static const CodeTables tables;
+
+        return tables;
+    }
+
+    class BitWriter
+    {
+        std::vector<uint8_t>&   m_output;
+        uint64_t                m_bits = 0;
+        uint32_t                m_count = 0;
+
+    public:
+        explicit BitWriter(std::vector<uint8_t>& output) : m_output(output)
+        {
+        }
+
+        void write(uint32_t value, uint32_t count)
+        {
+            m_bits |= static_cast<uint64_t>(value) << m_count;
+            m_count += count;
+
+            while (m_count >= 8)
+            {
+                m_output.push_back(static_cast<uint8_t>(m_bits));
+                m_bits >>= 8;
+                m_count -= 8;
+            }
+        }
+
+        void align()
+        {
+            if (m_count)
+                write(0, 8 - m_count);
+        }
+    };
+
+    // literal when m_distance is 0 otherwise a match
+    struct Symbol
+    {
+        uint16_t    m_value;
+        uint16_t    m_distance;
+    };
+
+    struct Huffman
+    {
+        std::vector<uint8_t>    m_lengths;
+        std::vector<uint16_t>   m_codes;
+
+        // code lengths limited to maxBits, symbols with a zero frequency get no code
+        void build(const uint32_t* frequencies, size_t count, uint32_t maxBits)
+        {
+            m_lengths.assign(count, 0);
+
+            std::vector<uint32_t> symbols;
+
+            for (uint32_t i = 0; i < count; i++)
+            {
+                if (frequencies[i])
+                    symbols.push_back(i);
+            }
+
+            // a complete code needs at least two symbols
+            for (uint32_t i = 0; symbols.size() < 2; i++)
+            {
+                if (frequencies[i] == 0)
+                    symbols.insert(std::lower_bound(symbols.begin(), symbols.end(), i), i);
+            }
+
+            std::stable_sort(symbols.begin(), symbols.end(), [frequencies](uint32_t a, uint32_t b) { return frequencies[a] < frequencies[b]; });
+
+            // two queue huffman construction, leaves are already sorted
+            const size_t            leaves = symbols.size();
+            std::vector<uint64_t>   weights(leaves * 2 - 1);
+            std::vector<size_t>     parents(leaves * 2 - 1, 0);
+
+            for (size_t i = 0; i < leaves; i++)
+                weights[i] = std::max<uint32_t>(frequencies[symbols[i]], 1);
+
+            size_t leaf = 0;
+            size_t node = leaves;
+
+            for (size_t next = leaves; next < leaves * 2 - 1; next++)
+            {
+                size_t children[2];
+
+                for (size_t& child : children)
+                {
+                    if (leaf < leaves && (node >= next || weights[leaf] <= weights[node]))
+                        child = leaf++;
+                    else
+                        child = node++;
+                }
+
+                weights[next] = weights[children[0]] + weights[children[1]];
+                parents[children[0]] = next;
+                parents[children[1]] = next;
+            }
+
+            std::vector<uint32_t>   depths(leaves * 2 - 1, 0);
+            uint32_t                counts[64] = {};
+
+            for (size_t i = leaves * 2 - 2; i-- > 0;)
+                depths[i] = depths[parents[i]] + 1;
+
+            for (size_t i = 0; i < leaves; i++)
+                counts[std::min<uint32_t>(depths[i], 63)]++;
+
+            // move overlong codes up to the limit and then fix the kraft sum
+            for (uint32_t i = maxBits + 1; i < 64; i++)
+            {
+                counts[maxBits] += counts[i];
+                counts[i] = 0;
+            }
+
+            uint32_t total = 0;
+
+            for (uint32_t i = maxBits; i > 0; i--)
+                total += counts[i] << (maxBits - i);
+
+            while (total != (1u << maxBits))
+            {
+                counts[maxBits]--;
+
+                for (uint32_t i = maxBits - 1; i > 0; i--)
+                {
+                    if (counts[i])
+                    {
+                        counts[i]--;
+                        counts[i + 1] += 2;
+                        break;
+                    }
+                }
+
+                total--;
+            }
+
+            // the least frequent symbols get the longest codes
+            size_t index = 0;
+
+            for (uint32_t length = maxBits; length > 0; length--)
+            {
+                for (uint32_t i = 0; i < counts[length]; i++)
+                    m_lengths[symbols[index++]] = static_cast<uint8_t>(length);
+            }
+
+            assign();
+        }
+
+        void assign()
+        {
+            uint32_t counts[16] = {};
+            uint32_t next[16] = {};
+
+            for (const auto length : m_lengths)
+                counts[length]++;
+
+            counts[0] = 0;
+
+            for (uint32_t bits = 1, code = 0; bits < 16; bits++)
+            {
+                code = (code + counts[bits - 1]) << 1;
+                next[bits] = code;
+            }
+
+            m_codes.assign(m_lengths.size(), 0);
+
+            for (size_t i = 0; i < m_lengths.size(); i++)
+            {
+                const uint32_t length = m_lengths[i];
+
+                if (length == 0)
+                    continue;
+
+                // huffman codes are stored most significant bit first
+                uint32_t code = next[length]++;
+                uint32_t reversed = 0;
+
+                for (uint32_t bit = 0; bit < length; bit++, code >>= 1)
+                    reversed = (reversed << 1) | (code & 1);
+
+                m_codes[i] = static_cast<uint16_t>(reversed);
+            }
+        }
+
+        void write(BitWriter& writer, uint32_t symbol) const
+        {
+            writer.write(m_codes[symbol], m_lengths[symbol]);
+        }
+    };
+
+    class Compressor
+    {
+        const uint8_t*          m_data;
+        size_t                  m_start;
+        size_t                  m_size;
+        BitWriter               m_writer;
+        std::vector<int32_t>    m_head;
+        std::vector<int32_t>    m_previous;
+        std::vector<Symbol>     m_symbols;
+        size_t                  m_maxChain;
+        size_t                  m_niceLength;
+        bool                    m_lazy;
+
+        uint32_t hash(size_t position) const
+        {
+            const uint32_t value = m_data[position] | (m_data[position + 1] << 8) | (m_data[position + 2] << 16);
+
+            return (value * 2654435761u) >> (32 - HASH_BITS);
+        }
+
+        void insert(size_t position)
+        {
+            if (position + MIN_MATCH > m_size)
+                return;
+
+            const uint32_t h = hash(position);
+
+            m_previous[position & (WINDOW_SIZE - 1)] = m_head[h];
+            m_head[h] = static_cast<int32_t>(position);
+        }
+
+        size_t findMatch(size_t position, size_t& distance) const
+        {
+            if (position + MIN_MATCH > m_size)
+                return 0;
+
+            const size_t    maximum = std::min(MAX_MATCH, m_size - position);
+            const uint8_t*  current = m_data + position;
+            int32_t         candidate = m_head[hash(position)];
+            size_t          chain = m_maxChain;
+            size_t          best = 0;
+
+            while (candidate >= 0 && position - candidate <= WINDOW_SIZE && chain-- > 0)
+            {
+                const uint8_t* match = m_data + candidate;
+
+                if (match[best] == current[best] && match[0] == current[0])
+                {
+                    size_t length = 1;
+
+                    while (length < maximum && match[length] == current[length])
+                        length++;
+
+                    if (length > best)
+                    {
+                        best = length;
+                        distance = position - candidate;
+
+                        if (length >= m_niceLength || length == maximum)
+                            break;
+                    }
+                }
+
+                const int32_t previous = m_previous[candidate & (WINDOW_SIZE - 1)];
+
+                if (previous >= candidate)
+                    break;
+
+                candidate = previous;
+            }
+
+            return best >= MIN_MATCH ? best : 0;
+        }
+
+        void writeStored(size_t start, size_t end, bool last)
+        {
+            do
+            {
+                const size_t length = std::min(end - start, MAX_STORED_SIZE);
+                const bool   final = last && start + length == end;
+
+                m_writer.write(final ? 1 : 0, 3);
+                m_writer.align();
+                m_writer.write(static_cast<uint32_t>(length), 16);
+                m_writer.write(static_cast<uint32_t>(~length & 0xffff), 16);
+
+                for (size_t i = 0; i < length; i++)
+                    m_writer.write(m_data[start + i], 8);
+
+                start += length;
+            } while (start < end);
+        }
+
+        void writeSymbols(const Huffman& literals, const Huffman& distances)
+        {
+            const CodeTables& tables = getCodeTables();
+
+            for (const auto& symbol : m_symbols)
+            {
+                if (symbol.m_distance == 0)
+                {
+                    literals.write(m_writer, symbol.m_value);
+                    continue;
+                }
+
+                const uint32_t lengthCode = tables.m_lengthCode[symbol.m_value];
+                const uint32_t distanceCode = tables.distanceCode(symbol.m_distance);
+
+                literals.write(m_writer, 257 + lengthCode);
+                m_writer.write(symbol.m_value - lengthBase[lengthCode], lengthExtra[lengthCode]);
+                distances.write(m_writer, distanceCode);
+                m_writer.write(symbol.m_distance - distanceBase[distanceCode], distanceExtra[distanceCode]);
+            }
+
+            literals.write(m_writer, 256);
+        }
+
+        void writeBlock(size_t start, size_t end, bool last)
+        {
+            const CodeTables&   tables = getCodeTables();
+            uint32_t            literalFrequencies[LITERAL_LENGTH_CODES] = {};
+            uint32_t            distanceFrequencies[DISTANCE_CODES] = {};
+
+            for (const auto& symbol : m_symbols)
+            {
+                if (symbol.m_distance == 0)
+                    literalFrequencies[symbol.m_value]++;
+                else
+                {
+                    literalFrequencies[257 + tables.m_lengthCode[symbol.m_value]]++;
+                    distanceFrequencies[tables.distanceCode(symbol.m_distance)]++;
+                }
+            }
+
+            literalFrequencies[256] = 1;
+
+            Huffman literals;
+            Huffman distances;
+
+            literals.build(literalFrequencies, LITERAL_LENGTH_CODES, 15);
+            distances.build(distanceFrequencies, DISTANCE_CODES, 15);
+
+            size_t literalCount = LITERAL_LENGTH_CODES;
+            size_t distanceCount = DISTANCE_CODES;
+
+            while (literalCount > 257 && literals.m_lengths[literalCount - 1] == 0)
+                literalCount--;
+
+            while (distanceCount > 1 && distances.m_lengths[distanceCount - 1] == 0)
+                distanceCount--;
+
+            // run length encode the code lengths
+            std::vector<uint8_t> lengths(literals.m_lengths.begin(), literals.m_lengths.begin() + literalCount);
+            lengths.insert(lengths.end(), distances.m_lengths.begin(), distances.m_lengths.begin() + distanceCount);
+
+            std::vector<std::pair<uint8_t, uint8_t>>    runs;
+            uint32_t                                    codeLengthFrequencies[CODE_LENGTH_CODES] = {};
+
+            for (size_t i = 0; i < lengths.size();)
+            {
+                const uint8_t   length = lengths[i];
+                size_t          run = 1;
+
+                while (i + run < lengths.size() && lengths[i + run] == length)
+                    run++;
+
+                if (length == 0 && run >= 11)
+                {
+                    run = std::min<size_t>(run, 138);
+                    runs.emplace_back(18, static_cast<uint8_t>(run - 11));
+                }
+                else if (length == 0 && run >= 3)
+                    runs.emplace_back(17, static_cast<uint8_t>(run - 3));
+                else if (length != 0 && run >= 4)
+                {
+                    run = std::min<size_t>(run - 1, 6) + 1;
+                    runs.emplace_back(length, 0);
+                    runs.emplace_back(16, static_cast<uint8_t>(run - 4));
+                }
+                else
+                {
+                    run = 1;
+                    runs.emplace_back(length, 0);
+                }
+
+                i += run;
+            }
+
+            for (const auto& run : runs)
+                codeLengthFrequencies[run.first]++;
+
+            Huffman codeLengths;
+
+            codeLengths.build(codeLengthFrequencies, CODE_LENGTH_CODES, 7);
+
+            size_t codeLengthCount = CODE_LENGTH_CODES;
+
+            while (codeLengthCount > 4 && codeLengths.m_lengths[codeLengthOrder[codeLengthCount - 1]] == 0)
+                codeLengthCount--;
+
+            // pick the smallest of dynamic, fixed and stored
+            uint64_t dynamicBits = 3 + 5 + 5 + 4 + codeLengthCount * 3;
+            uint64_t fixedBits = 3;
+
+            for (const auto& run : runs)
+                dynamicBits += codeLengths.m_lengths[run.first] + (run.first == 16 ? 2 : (run.first == 17 ? 3 : (run.first == 18 ? 7 : 0)));
+
+            for (size_t i = 0; i < LITERAL_LENGTH_CODES; i++)
+            {
+                const uint32_t extra = i > 256 ? lengthExtra[i - 257] : 0;
+
+                dynamicBits += static_cast<uint64_t>(literalFrequencies[i]) * (literals.m_lengths[i] + extra);
+                fixedBits += static_cast<uint64_t>(literalFrequencies[i]) * ((i < 144 ? 8 : (i < 256 ? 9 : (i < 280 ? 7 : 8))) + extra);
+            }
+
+            for (size_t i = 0; i < DISTANCE_CODES; i++)
+            {
+                dynamicBits += static_cast<uint64_t>(distanceFrequencies[i]) * (distances.m_lengths[i] + distanceExtra[i]);
+                fixedBits += static_cast<uint64_t>(distanceFrequencies[i]) * (5 + distanceExtra[i]);
+            }
+
+            const uint64_t storedBits = ((end - start) + ((end - start) / MAX_STORED_SIZE + 1) * 5) * 8;
+
+            if (storedBits < dynamicBits && storedBits < fixedBits)
+                writeStored(start, end, last);
+            else if (fixedBits <= dynamicBits)
+            {
+                Huffman fixedLiterals;
+                Huffman fixedDistances;
+
+                fixedLiterals.m_lengths.resize(288);
+
+                for (size_t i = 0; i < 288; i++)
+                    fixedLiterals.m_lengths[i] = i < 144 ? 8 : (i < 256 ? 9 : (i < 280 ? 7 : 8));
+
+                fixedDistances.m_lengths.assign(DISTANCE_CODES, 5);
+                fixedLiterals.assign();
+                fixedDistances.assign();
+
+                m_writer.write(last ? 1 : 0, 1);
+                m_writer.write(1, 2);
+                writeSymbols(fixedLiterals, fixedDistances);
+            }
+            else
+            {
+                m_writer.write(last ? 1 : 0, 1);
+                m_writer.write(2, 2);
+                m_writer.write(static_cast<uint32_t>(literalCount - 257), 5);
+                m_writer.write(static_cast<uint32_t>(distanceCount - 1), 5);
+                m_writer.write(static_cast<uint32_t>(codeLengthCount - 4), 4);
+
+                for (size_t i = 0; i < codeLengthCount; i++)
+                    m_writer.write(codeLengths.m_lengths[codeLengthOrder[i]], 3);
+
+                for (const auto& run : runs)
+                {
+                    codeLengths.write(m_writer, run.first);
+
+                    if (run.first == 16)
+                        m_writer.write(run.second, 2);
+                    else if (run.first == 17)
+                        m_writer.write(run.second, 3);
+                    else if (run.first == 18)
+                        m_writer.write(run.second, 7);
+                }
+
+                writeSymbols(literals, distances);
+            }
+
+            m_symbols.clear();
+        }
+
+    public:
+        // compresses data[start, end), the window before start is used as a dictionary
+        Compressor(const uint8_t* data, size_t start, size_t end, deflate::Level level, std::vector<uint8_t>& output) :
+            m_data(data),
+            m_start(start),
+            m_size(end),
+            m_writer(output),
+            m_head(HASH_SIZE, -1),
+            m_previous(WINDOW_SIZE, -1),
+            m_maxChain(settings[level].m_maxChain),
+            m_niceLength(settings[level].m_niceLength),
+            m_lazy(settings[level].m_lazy)
+        {
+            m_symbols.reserve(MAX_BLOCK_SYMBOLS);
+
+            for (size_t position = start > WINDOW_SIZE ? start - WINDOW_SIZE : 0; position < start; position++)
+                insert(position);
+        }
+
+        // the last chunk ends the stream, the others end byte aligned with an empty stored block
+        void compress(bool last)
+        {
+            size_t blockStart = m_start;
+            size_t position = m_start;
+
+            while (position < m_size)
+            {
+                size_t distance = 0;
+                size_t length = findMatch(position, distance);
+
+                // a literal is written instead when the next position has a longer match
+                if (length && m_lazy && length < m_niceLength)
+                {
+                    size_t nextDistance = 0;
+
+                    insert(position);
+
+                    if (findMatch(position + 1, nextDistance) > length)
+                    {
+                        m_symbols.push_back(Symbol{ m_data[position], 0 });
+                        position++;
+                        length = 0;
+                    }
+                    else
+                    {
+                        m_symbols.push_back(Symbol{ static_cast<uint16_t>(length), static_cast<uint16_t>(distance) });
+
+                        for (size_t i = 1; i < length; i++)
+                            insert(position + i);
+
+                        position += length;
+                    }
+
+                    if (m_symbols.size() >= MAX_BLOCK_SYMBOLS)
+                    {
+                        writeBlock(blockStart, position, last && position == m_size);
+                        blockStart = position;
+                    }
+
+                    continue;
+                }
+
+                if (length)
+                {
+                    m_symbols.push_back(Symbol{ static_cast<uint16_t>(length), static_cast<uint16_t>(distance) });
+
+                    for (size_t i = 0; i < length; i++)
+                        insert(position + i);
+
+                    position += length;
+                }
+                else
+                {
+                    m_symbols.push_back(Symbol{ m_data[position], 0 });
+                    insert(position);
+                    position++;
+                }
+
+                if (m_symbols.size() >= MAX_BLOCK_SYMBOLS)
+                {
+                    writeBlock(blockStart, position, last && position == m_size);
+                    blockStart = position;
+                }
+            }
+
+            if (!m_symbols.empty())
+                writeBlock(blockStart, position, last);
+            else if (last && m_start == m_size)
+                writeBlock(blockStart, position, true);
+
+            if (!last)
+                writeStored(position, position, false);
+
+            m_writer.align();
+        }
+    };
+}
+
+uint32_t deflate::adler32(const uint8_t* data, size_t size, uint32_t adler)
+{
+    uint32_t a = adler & 0xffff;
+    uint32_t b = adler >> 16;
+
+    while (size > 0)
+    {
+        // largest block that can't overflow before the modulo
+        const size_t block = std::min<size_t>(size, 5552);
+
+        for (size_t i = 0; i < block; i++)
+        {
+            a += data[i];
+            b += a;
+        }
+
+        a %= 65521;
+        b %= 65521;
+        data += block;
+        size -= block;
+    }
+
+    return (b << 16) | a;
+}
+
+uint32_t deflate::combineAdler32(uint32_t adler1, uint32_t adler2, size_t size2)
+{
+    const uint32_t base = 65521;
+    const uint32_t remainder = static_cast<uint32_t>(size2 % base);
+    uint32_t a = adler1 & 0xffff;
+    uint32_t b = (remainder * a) % base;
+
+    a += (adler2 & 0xffff) + base - 1;
+    b += (adler1 >> 16) + (adler2 >> 16) + base - remainder;
+
+    if (a >= base)
+        a -= base;
+    if (a >= base)
+        a -= base;
+    if (b >= base * 2)
+        b -= base * 2;
+    if (b >= base)
+        b -= base;
+
+    return (b << 16) | a;
+}
+
+std::vector<uint8_t> deflate::compress(const uint8_t* data, size_t size, Level level)
+{
+    jobs single(1);
+
+    return compress(data, size, level, single);
+}
+
+std::vector<uint8_t> deflate::compress(const uint8_t* data, size_t size, Level level, jobs& pool)
+{
+    // the chunks don't depend on the number of threads so the output is always the same
+    const size_t                        chunkCount = std::max<size_t>(1, (size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    std::vector<std::vector<uint8_t>>   chunks(chunkCount);
+    std::vector<uint32_t>               adlers(chunkCount);
+
+    {
+        // the chunks are added to the threads of pool, a worker of pool runs them too while it waits
+        jobs single(1);
+        jobs compressors(chunkCount == 1 ? single : pool);
+
+        for (size_t i = 0; i < chunkCount; i++)
+        {
+            compressors.add("chunk " + std::to_string(i), [data, size, level, i, chunkCount, &chunks, &adlers]()
+            {
+                const size_t start = i * CHUNK_SIZE;
+                const size_t end = std::min(size, start + CHUNK_SIZE);
+
+                chunks[i].reserve((end - start) / 2 + 64);
+
+                Compressor(data, start, end, level, chunks[i]).compress(i + 1 == chunkCount);
+
+                adlers[i] = adler32(data + start, end - start);
+            });
+        }
+
+        const auto errors = compressors.wait();
+
+        if (!errors.empty())
+            throw std::runtime_error("Couldn't compress " + errors.front().m_name + ": " + errors.front().m_message);
+    }
+
+    std::vector<uint8_t>    output = { 0x78, static_cast<uint8_t>(level == Fast ? 0x01 : (level == Small ? 0xda : 0x9c)) };
+    size_t                  total = output.size() + 4;
+    uint32_t                adler = adlers[0];
+
+    for (const auto& chunk : chunks)
+        total += chunk.size();
+
+    output.reserve(total);
+
+    for (size_t i = 0; i < chunkCount; i++)
+    {
+        output.insert(output.end(), chunks[i].begin(), chunks[i].end());
+
+        if (i > 0)
+            adler = combineAdler32(adler, adlers[i], std::min(size, (i + 1) * CHUNK_SIZE) - i * CHUNK_SIZE);
+    }
+
+    output.push_back(static_cast<uint8_t>(adler >> 24));
+    output.push_back(static_cast<uint8_t>(adler >> 16));
+    output.push_back(static_cast<uint8_t>(adler >> 8));
+    output.push_back(static_cast<uint8_t>(adler));
+
+    return output;
+}
@@ -0,0 +1,24 @@
+#ifndef _DEFLATE_H_
+#define _DEFLATE_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+class jobs;
+
+// zlib (RFC 1950/1951) compressor so no external libraries are needed
+class deflate
+{
+public:
+    // speed and size trade off, Small also uses lazy matching
+    enum Level { Fast, Default, Small };
+
+    // the data is compressed in fixed size chunks, queued on pool when there are several, the output doesn't depend on pool
+    static std::vector<uint8_t> compress(const uint8_t* data, size_t size, Level level = Default);
+    static std::vector<uint8_t> compress(const uint8_t* data, size_t size, Level level, jobs& pool);
+    static uint32_t adler32(const uint8_t* data, size_t size, uint32_t adler = 1);
+    static uint32_t combineAdler32(uint32_t adler1, uint32_t adler2, size_t size2);
+};
+
+#endif
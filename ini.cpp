@@ -1,9 +1,114 @@
 #include "ini.h"
-#include "trim.h"
+#include "datasource.h"
 
+#include <charconv>
 #include <iostream>
 #include <fstream>
+#include <map>
 #include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+
+namespace
+{
+    constexpr std::string_view WHITESPACE = " \n\r\t\f\v";
+
+    std::string_view ltrim(std::string_view s)
+    {
+        const size_t start = s.find_first_not_of(WHITESPACE);
+        return (start == std::string_view::npos) ? std::string_view() : s.substr(start);
+    }
+
+    std::string_view rtrim(std::string_view s)
+    {
+        const size_t end = s.find_last_not_of(WHITESPACE);
+        return (end == std::string_view::npos) ? std::string_view() : s.substr(0, end + 1);
+    }
+
+    // FNV-1a
+    uint32_t hash(std::string_view s, uint32_t value = 2166136261u)
+    {
+        for (const char c : s)
+            value = (value ^ static_cast<uint8_t>(c)) * 16777619u;
+
+        return value;
+    }
+
+    uint32_t hash(std::string_view section, std::string_view key)
+    {
+        return hash(key, hash(section) * 16777619u);
+    }
+
+    // like std::stoi and std::stof, leading white space and a plus sign are skipped and the rest after the number is ignored
+    template <typename T>
+    uint8_t parseNumber(std::string_view text, T& value)
+    {
+        text = ltrim(text);
+
+        if (!text.empty() && text[0] == '+' && (text.size() == 1 || text[1] != '-'))
+            text.remove_prefix(1);
+
+        // std::stof also reads hexadecimal numbers, a 0x without hexadecimal digits after it is read as 0
+        if constexpr (std::is_floating_point_v<T>)
+        {
+            const bool              negative = !text.empty() && text[0] == '-';
+            const std::string_view  digits = text.substr(negative ? 1 : 0);
+
+            if (digits.size() > 2 && digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X') && digits[2] != '-')
+            {
+                const std::from_chars_result result = std::from_chars(digits.data() + 2, digits.data() + digits.size(), value, std::chars_format::hex);
+
+                if (result.ec != std::errc::invalid_argument)
+                {
+                    if (negative)
+                        value = -value;
+
+                    return result.ec == std::errc() ? 0 : 2;
+                }
+            }
+        }
+
+        const std::from_chars_result result = std::from_chars(text.data(), text.data() + text.size(), value);
+
+        if (result.ec == std::errc::result_out_of_range)
+            return 2;
+
+        return result.ec == std::errc() ? 0 : 1;
+    }
+
+    // throws what std::stoi or std::stof would for the parse status
+    template <typename T>
+    T checked(T value, uint8_t status, const char* function)
+    {
+        if (status == 1)
+            throw std::invalid_argument(function);
+
+        if (status == 2)
+            throw std::out_of_range(function);
+
+        return value;
+    }
+}
+
+ini::ini(const ini& other) : m_fileName(other.m_fileName), m_buffer(other.m_buffer), m_values(other.m_values), m_index(other.m_index), m_sectionIndex(other.m_sectionIndex), m_numbers(other.m_values.size())
+{
+}
+
+ini& ini::operator=(const ini& other)
+{
+    if (this != &other)
+    {
+        m_fileName = other.m_fileName;
+        m_buffer = other.m_buffer;
+        m_values = other.m_values;
+        m_index = other.m_index;
+        m_sectionIndex = other.m_sectionIndex;
+        m_numbers = std::vector<Number>(m_values.size());
+    }
+
+    return *this;
+}
 
 void ini::read(const std::string& fileName)
 {
@@ -14,15 +119,51 @@ void ini::read(const std::string& fileName)
     if (!stream)
         throw std::runtime_error("Couldn't open file: " + fileName);
 
-    std::string line;
-    size_t      lineNumber = 0;
-    std::string currentSection;
+    std::ostringstream contents;
+
+    contents << stream.rdbuf();
+
+    m_buffer = contents.str();
+
+    stream.close();
+
+    parse();
+}
+
+void ini::read(const datasource& source, const std::string& name)
+{
+    m_fileName = source.getFileName(name);
+    m_buffer = source.read(name);
+
+    parse();
+}
+
+void ini::parse()
+{
+    if (m_buffer.size() > UINT32_MAX)
+        throw std::runtime_error("File too large: " + m_fileName);
 
-    while (std::getline(stream, line))
+    const std::string_view  buffer(m_buffer);
+    const auto              span = [&buffer](std::string_view text)
     {
-        lineNumber++;
+        return Span{ static_cast<uint32_t>(text.data() - buffer.data()), static_cast<uint32_t>(text.size()) };
+    };
+
+    m_values.clear();
 
-        std::string trimmed = trim(line);
+    Span    currentSection;
+    size_t  start = 0;
+
+    while (start < buffer.size())
+    {
+        size_t end = buffer.find('\n', start);
+
+        if (end == std::string_view::npos)
+            end = buffer.size();
+
+        const std::string_view trimmed = rtrim(ltrim(buffer.substr(start, end - start)));
+
+        start = end + 1;
 
         if (trimmed.empty())
             continue;
@@ -35,39 +176,152 @@ void ini::read(const std::string& fileName)
         {
             const size_t closeBracket = trimmed.find(']');
 
-            if (closeBracket == std::string::npos)
+            if (closeBracket == std::string_view::npos)
                 throw std::runtime_error("Couldn't parse file");
 
-            currentSection = trimmed.substr(1, closeBracket - 1);
+            currentSection = span(trimmed.substr(1, closeBracket - 1));
         }
         else
         {
-            const size_t equal = trimmed.find_first_of('=');
+            const size_t equal = trimmed.find('=');
 
-            if (equal == std::string::npos)
-            {
+            if (equal == std::string_view::npos)
                 continue;
-                // throw std::runtime_error("Couldn't parse file: " + fileName + " line : " + std::to_string(lineNumber));
-            }
 
-            const std::string key = rtrim(trimmed.substr(0, equal));
-            std::string value = ltrim(trimmed.substr(equal + 1));
+            const std::string_view key = rtrim(trimmed.substr(0, equal));
+            std::string_view value = ltrim(trimmed.substr(equal + 1));
             const size_t comment = value.find(';');
-            if (comment != std::string::npos)
+            if (comment != std::string_view::npos)
                 value = rtrim(value.substr(0, comment));
 
-            m_sections[currentSection].insert(std::pair(key, value));
+            m_values.push_back(Value{ currentSection, span(key), span(value) });
         }
     }
 
-    stream.close();
+    // open addressing with twice as many slots as values, a slot holds the value index + 1
+    size_t slots = 16;
+
+    while (slots < m_values.size() * 2)
+        slots *= 2;
+
+    m_index.assign(slots, 0);
+    m_sectionIndex.assign(slots, 0);
+
+    const size_t mask = slots - 1;
+
+    for (size_t i = 0; i < m_values.size(); i++)
+    {
+        const std::string_view section = getText(m_values[i].m_section);
+        const std::string_view key = getText(m_values[i].m_key);
+
+        // the first value of a key is kept
+        for (size_t slot = hash(section, key) & mask; ; slot = (slot + 1) & mask)
+        {
+            if (m_index[slot] == 0)
+            {
+                m_index[slot] = static_cast<uint32_t>(i + 1);
+                break;
+            }
+
+            const Value& other = m_values[m_index[slot] - 1];
+
+            if (getText(other.m_section) == section && getText(other.m_key) == key)
+                break;
+        }
+
+        for (size_t slot = hash(section) & mask; ; slot = (slot + 1) & mask)
+        {
+            if (m_sectionIndex[slot] == 0)
+            {
+                m_sectionIndex[slot] = static_cast<uint32_t>(i + 1);
+                break;
+            }
+
+            if (getText(m_values[m_sectionIndex[slot] - 1].m_section) == section)
+                break;
+        }
+    }
+
+    m_numbers = std::vector<Number>(m_values.size());
+}
+
+const ini::Value* ini::find(std::string_view section, std::string_view key) const
+{
+    if (m_index.empty())
+        return nullptr;
+
+    const size_t mask = m_index.size() - 1;
+
+    for (size_t slot = hash(section, key) & mask; m_index[slot] != 0; slot = (slot + 1) & mask)
+    {
+        const Value& value = m_values[m_index[slot] - 1];
+
+        if (getText(value.m_section) == section && getText(value.m_key) == key)
+            return &value;
+    }
+
+    return nullptr;
+}
+
+const ini::Number& ini::getNumber(std::string_view section, std::string_view key) const
+{
+    static const Number missing;
+
+    const Value* value = find(section, key);
+
+    if (!value)
+        return missing;
+
+    Number&     number = m_numbers[value - m_values.data()];
+    uint8_t     state = number.m_state.load(std::memory_order_acquire);
+
+    if (state == 2)
+        return number;
+
+    // the first thread parses the value, the others wait for it
+    if (state == 0 && number.m_state.compare_exchange_strong(state, 1, std::memory_order_acquire))
+    {
+        const std::string_view text = getText(value->m_value);
+
+        number.m_intStatus = static_cast<Status>(parseNumber(text, number.m_int));
+
+        // the comma separated elements like std::getline would split them, a trailing comma doesn't add an element
+        size_t start = 0;
+
+        while (number.m_floatCount < number.m_floats.size() && start < text.size())
+        {
+            size_t end = text.find(',', start);
+
+            if (end == std::string_view::npos)
+                end = text.size();
+
+            number.m_floatStatus[number.m_floatCount] = static_cast<Status>(parseNumber(text.substr(start, end - start), number.m_floats[number.m_floatCount]));
+            number.m_floatCount++;
+
+            start = end + 1;
+        }
+
+        number.m_state.store(2, std::memory_order_release);
+
+        return number;
+    }
+
+    while (number.m_state.load(std::memory_order_acquire) != 2)
+        std::this_thread::yield();
+
+    return number;
 }
 
 void ini::dump(std::ostream& stream) const
 {
     stream << "fileName: " << m_fileName << std::endl;
 
-    for (const auto& section : m_sections)
+    std::map<std::string_view, std::map<std::string_view, std::string_view>> sections;
+
+    for (const auto& value : m_values)
+        sections[getText(value.m_section)].insert(std::pair(getText(value.m_key), getText(value.m_value)));
+
+    for (const auto& section : sections)
     {
         stream << "[" << section.first << "]" << std::endl;
 
@@ -92,77 +346,71 @@ bool ini::dump(const std::string& fileName) const
     return false;
 }
 
-bool ini::hasValue(const std::string& section, const std::string& key) const
+bool ini::hasValue(std::string_view section, std::string_view key) const
 {
-    auto it = m_sections.find(section);
-
-    if (it != m_sections.end())
-    {
-        auto it2 = it->second.find(key);
-
-        if (it2 != it->second.end())
-            return true;
-    }
-
-    return false;
+    return find(section, key) != nullptr;
 }
 
-std::string ini::getValue(const std::string& section, const std::string& key) const
+std::string ini::getValue(std::string_view section, std::string_view key) const
 {
-    std::string value;
-
-    auto it = m_sections.find(section);
-
-    if (it != m_sections.end())
-    {
-        auto it2 = it->second.find(key);
-
-        if (it2 != it->second.end())
-            value = it2->second;
-    }
-
-    return value;
+    return std::string(getView(section, key));
 }
 
-int ini::getIntValue(const std::string& section, const std::string& key) const
+std::string_view ini::getView(std::string_view section, std::string_view key) const
 {
-    return std::stoi(getValue(section, key));
+    const Value* value = find(section, key);
+
+    return value ? getText(value->m_value) : std::string_view();
 }
 
-float ini::getFloatValue(const std::string& section, const std::string& key) const
+int ini::getIntValue(std::string_view section, std::string_view key) const
 {
-    return std::stof(getValue(section, key));
+    const Number& number = getNumber(section, key);
+
+    return checked(number.m_int, number.m_intStatus, "stoi");
 }
 
-float ini::getFloatValue(const std::string& section, const std::string& key, const float value) const
+float ini::getFloatValue(std::string_view section, std::string_view key) const
 {
-    auto it = m_sections.find(section);
+    const Number& number = getNumber(section, key);
 
-    if (it != m_sections.end())
-    {
-        auto it2 = it->second.find(key);
+    if (number.m_floatCount == 0)
+        throw std::invalid_argument("stof");
 
-        if (it2 != it->second.end())
-            return std::stof(it2->second);
-    }
+    return checked(number.m_floats[0], number.m_floatStatus[0], "stof");
+}
 
-    return value;
+float ini::getFloatValue(std::string_view section, std::string_view key, const float value) const
+{
+    if (!find(section, key))
+        return value;
+
+    return getFloatValue(section, key);
 }
 
-std::array<float, 3> ini::getFloatArray3Value(const std::string& section, const std::string& key) const
+std::array<float, 3> ini::getFloatArray3Value(std::string_view section, std::string_view key) const
 {
+    const Number&           number = getNumber(section, key);
     std::array<float, 3>    vec3{ 0, 0, 0 };
-    std::istringstream ss(getValue(section, key));
-    std::string number;
-    size_t index = 0;
 
-    while (index < 3 && std::getline(ss, number, ','))
-        vec3[index++] = std::stof(number);
+    for (size_t index = 0; index < number.m_floatCount; index++)
+        vec3[index] = checked(number.m_floats[index], number.m_floatStatus[index], "stof");
 
     return vec3;
 }
 
-bool ini::hasSection(const std::string& section) const
+bool ini::hasSection(std::string_view section) const
 {
-    return m_sections.find(section) != m_sections.end();
+    if (m_sectionIndex.empty())
+        return false;
+
+    const size_t mask = m_sectionIndex.size() - 1;
+
+    for (size_t slot = hash(section) & mask; m_sectionIndex[slot] != 0; slot = (slot + 1) & mask)
+    {
+        if (getText(m_values[m_sectionIndex[slot] - 1].m_section) == section)
+            return true;
+    }
+
+    return false;
 }
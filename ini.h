@@ -2,14 +2,59 @@
 #define _INI_H_
 
 #include <string>
-#include <map>
+#include <string_view>
+#include <vector>
 #include <array>
+#include <atomic>
+#include <cstdint>
 
+class datasource;
+
+// The file is kept in one buffer and the sections, keys and values refer to it.
+// (section, key) pairs are found with a flat hash index without allocating and numbers are
+// parsed the first time they are requested and cached, which is safe from several threads.
 class ini
 {
 private:
-    std::string                                               m_fileName;
-    std::map<std::string, std::map<std::string, std::string>> m_sections;
+    struct Span
+    {
+        uint32_t    m_offset = 0;
+        uint32_t    m_size = 0;
+    };
+
+    struct Value
+    {
+        Span        m_section;
+        Span        m_key;
+        Span        m_value;
+    };
+
+    enum Status : uint8_t { Valid, Invalid, OutOfRange };
+
+    struct Number
+    {
+        std::atomic<uint8_t>    m_state{ 0 };
+        int                     m_int = 0;
+        Status                  m_intStatus = Invalid;
+        std::array<float, 3>    m_floats{ 0, 0, 0 };
+        Status                  m_floatStatus[3] = { Invalid, Invalid, Invalid };
+        size_t                  m_floatCount = 0;
+    };
+
+    std::string             m_fileName;
+    std::string             m_buffer;
+    std::vector<Value>      m_values;
+    std::vector<uint32_t>   m_index;
+    std::vector<uint32_t>   m_sectionIndex;
+    mutable std::vector<Number> m_numbers;
+
+    void parse();
+    std::string_view getText(const Span& span) const
+    {
+        return std::string_view(m_buffer.data() + span.m_offset, span.m_size);
+    }
+    const Value* find(std::string_view section, std::string_view key) const;
+    const Number& getNumber(std::string_view section, std::string_view key) const;
 
 public:
     ini() = default;
@@ -17,26 +62,34 @@ public:
     {
         read(fileName);
     }
+    ini(const datasource& source, const std::string& name)
+    {
+        read(source, name);
+    }
+    ini(const ini& other);
+    ini& operator=(const ini& other);
 
     void read(const std::string& fileName);
+    void read(const datasource& source, const std::string& name);
     void dump(std::ostream& stream) const;
     bool dump(const std::string& fileName) const;
-    std::string getValue(const std::string& section, const std::string& key) const;
-    int getIntValue(const std::string& section, const std::string& key) const;
-    float getFloatValue(const std::string& section, const std::string& key) const;
-    float getFloatValue(const std::string& section, const std::string& key, const float value) const;
-    std::array<float,3> getFloatArray3Value(const std::string& section, const std::string& key) const;
-    bool hasSection(const std::string& section) const;
-    bool hasValue(const std::string& section, const std::string& key) const;
+    std::string getValue(std::string_view section, std::string_view key) const;
+    // the value without a copy, valid while the ini isn't changed, empty when there is no such value
+    std::string_view getView(std::string_view section, std::string_view key) const;
+    int getIntValue(std::string_view section, std::string_view key) const;
+    float getFloatValue(std::string_view section, std::string_view key) const;
+    float getFloatValue(std::string_view section, std::string_view key, const float value) const;
+    std::array<float,3> getFloatArray3Value(std::string_view section, std::string_view key) const;
+    bool hasSection(std::string_view section) const;
+    bool hasValue(std::string_view section, std::string_view key) const;
     const std::string& getFileName() const
     {
         return m_fileName;
     }
     bool hasSections() const
     {
-        return m_sections.size() > 0;
+        return m_values.size() > 0;
     }
 };
 
 #endif
-
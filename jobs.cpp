@@ -0,0 +1,252 @@
+#include "jobs.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace
+{
+    // the pool and queue of the worker running on this thread
+    thread_local const void*    currentPool = nullptr;
+    thread_local size_t         currentWorker = 0;
+}
+
+jobs::jobs(unsigned int count) : m_ownPool(std::make_unique<Pool>())
+{
+    m_pool = m_ownPool.get();
+    m_pool->m_count = count;
+
+    if (m_pool->m_count == 0)
+        m_pool->m_count = std::max(1u, std::thread::hardware_concurrency());
+}
+
+jobs::jobs(jobs& pool) : m_pool(pool.m_pool)
+{
+}
+
+jobs::~jobs()
+{
+    if (!m_ownPool)
+    {
+        // the jobs refer to this, so they have to finish first
+        wait();
+
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_pool->m_mutex);
+
+        m_pool->m_stop = true;
+    }
+
+    m_pool->m_work.notify_all();
+
+    for (auto& thread : m_pool->m_threads)
+        thread.join();
+}
+
+void jobs::add(const std::string& name, std::function<void()> function)
+{
+    Job job;
+
+    job.m_owner = this;
+    job.m_name = name;
+    job.m_function = std::move(function);
+
+    if (m_pool->m_count == 1)
+    {
+        job.m_index = m_added++;
+
+        execute(job);
+
+        return;
+    }
+
+    bool helpable = false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_pool->m_mutex);
+
+        job.m_index = m_added++;
+        m_pending++;
+        m_pool->m_active++;
+
+        // a worker keeps the jobs it adds, the other workers steal them when they run out
+        helpable = currentPool == m_pool;
+
+        if (helpable)
+            m_pool->m_workerQueues[currentWorker].push_back(std::move(job));
+        else
+            m_pool->m_queue.push_back(std::move(job));
+
+        // threads are only started when there is work for them
+        if (m_pool->m_threads.size() < m_pool->m_count && m_pool->m_threads.size() < m_pool->m_active)
+        {
+            m_pool->m_workerQueues.emplace_back();
+            m_pool->m_threads.emplace_back(&jobs::run, m_pool, m_pool->m_threads.size());
+        }
+    }
+
+    // only idle workers wait for work, so one of them gets the job, the workers waiting in wait
+    // wait on their own condition so they can't take the notification for a job they won't run
+    m_pool->m_work.notify_one();
+
+    if (helpable)
+        m_pool->m_help.notify_all();
+}
+
+std::vector<jobs::Error> jobs::wait()
+{
+    std::unique_lock<std::mutex> lock(m_pool->m_mutex);
+
+    if (currentPool == m_pool)
+    {
+        // a worker waiting for other jobs would hold up the pool, so it runs jobs until they are done,
+        // only the jobs added by workers so it doesn't start more of the jobs it is part of
+        while (m_pending > 0)
+        {
+            Job job;
+
+            if (take(*m_pool, job, false))
+            {
+                lock.unlock();
+
+                job.m_owner->execute(job);
+                job.m_owner->finish(job);
+
+                lock.lock();
+            }
+            else
+                m_pool->m_help.wait(lock);
+        }
+    }
+    else
+        m_pool->m_done.wait(lock, [this] { return m_pending == 0; });
+
+    std::vector<size_t> order(m_errors.size());
+
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b) { return m_errorIndices[a] < m_errorIndices[b]; });
+
+    std::vector<Error> errors;
+
+    errors.reserve(order.size());
+
+    for (auto i : order)
+        errors.push_back(std::move(m_errors[i]));
+
+    m_errors.clear();
+    m_errorIndices.clear();
+
+    return errors;
+}
+
+// the newest job of this worker, then the oldest job added from outside the pool, then the oldest job of another worker
+bool jobs::take(Pool& pool, Job& job, bool external)
+{
+    if (currentPool == &pool && !pool.m_workerQueues[currentWorker].empty())
+    {
+        job = std::move(pool.m_workerQueues[currentWorker].back());
+        pool.m_workerQueues[currentWorker].pop_back();
+
+        return true;
+    }
+
+    if (external && !pool.m_queue.empty())
+    {
+        job = std::move(pool.m_queue.front());
+        pool.m_queue.pop_front();
+
+        return true;
+    }
+
+    for (auto& queue : pool.m_workerQueues)
+    {
+        if (!queue.empty())
+        {
+            job = std::move(queue.front());
+            queue.pop_front();
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void jobs::run(Pool* pool, size_t worker)
+{
+    currentPool = pool;
+    currentWorker = worker;
+
+    for (;;)
+    {
+        Job job;
+
+        {
+            std::unique_lock<std::mutex> lock(pool->m_mutex);
+
+            while (!take(*pool, job, true))
+            {
+                if (pool->m_stop)
+                    return;
+
+                pool->m_work.wait(lock);
+            }
+        }
+
+        job.m_owner->execute(job);
+        job.m_owner->finish(job);
+    }
+}
+
+void jobs::execute(Job& job)
+{
+    std::string message;
+
+    try
+    {
+        job.m_function();
+
+        return;
+    }
+    catch (std::exception& e)
+    {
+        message = e.what();
+    }
+    catch (...)
+    {
+        message = "unknown error";
+    }
+
+    std::lock_guard<std::mutex> lock(m_pool->m_mutex);
+
+    m_errors.push_back({ job.m_name, message });
+    m_errorIndices.push_back(job.m_index);
+}
+
+void jobs::finish(Job& job)
+{
+    // the function can hold on to things that have to be released before wait returns
+    job.m_function = nullptr;
+
+    // this can be destroyed as soon as the lock is released
+    Pool*   pool = m_pool;
+    bool    done = false;
+
+    {
+        std::lock_guard<std::mutex> lock(pool->m_mutex);
+
+        m_pending--;
+        pool->m_active--;
+        done = m_pending == 0;
+    }
+
+    // workers waiting for these jobs wait for jobs to help with
+    if (done)
+    {
+        pool->m_done.notify_all();
+        pool->m_help.notify_all();
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef _JOBS_H_
+#define _JOBS_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Bounded pool of worker threads.
+// A job reports a failure by throwing, the errors are returned in the order the jobs were added.
+// A jobs made from another one shares its threads, so jobs can add and wait for more jobs without
+// starting more threads. Every worker has its own queue, idle workers steal from the others and a
+// worker waiting for jobs runs the jobs added by workers instead of blocking.
+class jobs
+{
+public:
+    struct Error
+    {
+        std::string m_name;
+        std::string m_message;
+    };
+
+private:
+    struct Job
+    {
+        jobs*                   m_owner = nullptr;
+        size_t                  m_index = 0;
+        std::string             m_name;
+        std::function<void()>   m_function;
+    };
+
+    struct Pool
+    {
+        unsigned int                    m_count = 1;
+        std::vector<std::thread>        m_threads;
+        std::deque<Job>                 m_queue;
+        std::vector<std::deque<Job>>    m_workerQueues;
+        size_t                          m_active = 0;
+        bool                            m_stop = false;
+        std::mutex                      m_mutex;
+        std::condition_variable         m_work;
+        std::condition_variable         m_help;
+        std::condition_variable         m_done;
+    };
+
+    std::unique_ptr<Pool>       m_ownPool;
+    Pool*                       m_pool = nullptr;
+    std::vector<Error>          m_errors;
+    std::vector<size_t>         m_errorIndices;
+    size_t                      m_added = 0;
+    size_t                      m_pending = 0;
+
+    static void run(Pool* pool, size_t worker);
+    static bool take(Pool& pool, Job& job, bool external);
+    void execute(Job& job);
+    void finish(Job& job);
+
+public:
+    // a count of 0 uses one thread per core, a count of 1 runs the jobs when they are added
+    explicit jobs(unsigned int count = 0);
+    // uses the threads of pool, which must outlive it
+    explicit jobs(jobs& pool);
+    jobs(const jobs&) = delete;
+    jobs& operator=(const jobs&) = delete;
+    ~jobs();
+
+    void add(const std::string& name, std::function<void()> function);
+    std::vector<Error> wait();
+    unsigned int getCount() const
+    {
+        return m_pool->m_count;
+    }
+};
+
+#endif
@@ -0,0 +1,156 @@
+#include "kn5model.h"
+
+#include <map>
+
+namespace
+{
+    void addBatches(const kn5& model, const kn5::Node& node, const kn5::Matrix& matrix, bool useDiffuse, std::vector<kn5model::Batch>& batches, std::map<int, size_t>& materials)
+    {
+        if (node.m_type == kn5::Node::Transform)
+        {
+            if (!node.m_active)
+                return;
+
+            const kn5::Matrix newXform = matrix.multiply(node.m_matrix);
+
+            for (const auto& child : node.m_children)
+                addBatches(model, child, newXform, useDiffuse, batches, materials);
+
+            return;
+        }
+
+        if (!node.m_vertices.empty() && !node.m_indices.empty())
+        {
+            auto it = materials.find(node.m_materialID);
+
+            if (it == materials.end())
+            {
+                it = materials.emplace(node.m_materialID, batches.size()).first;
+                batches.emplace_back();
+                batches.back().m_materialID = node.m_materialID;
+            }
+
+            kn5model::Batch& batch = batches[it->second];
+            const size_t     first = batch.m_vertices.size();
+
+            batch.m_vertices.resize(first + node.m_vertices.size());
+            // the uvs are scaled like the AC3D and glTF files so the batches match them
+            kn5model::interleave(node, matrix, kn5model::getUVMultiplier(model.m_materials[node.m_materialID], useDiffuse), batch.m_vertices.data() + first);
+
+            batch.m_indices.reserve(batch.m_indices.size() + node.m_indices.size());
+
+            for (const auto index : node.m_indices)
+                batch.m_indices.push_back(static_cast<uint32_t>(first + index));
+        }
+
+        for (const auto& child : node.m_children)
+            addBatches(model, child, matrix, useDiffuse, batches, materials);
+    }
+}
+
+kn5model::Handle kn5model::load(const std::string& fileName, bool useDiffuse)
+{
+    return std::make_shared<const kn5model>(fileName, useDiffuse);
+}
+
+kn5model::kn5model(const std::string& fileName, bool useDiffuse) : m_useDiffuse(useDiffuse)
+{
+    // the kn5 is read in place because the nodes have pointers to their parents
+    m_model.read(fileName);
+
+    m_batches = makeBatches(m_model, m_model.m_node, m_useDiffuse);
+}
+
+std::vector<kn5model::Batch> kn5model::getBatches(const std::string& transformName) const
+{
+    const kn5::Node* node = m_model.findNode(kn5::Node::Transform, transformName);
+
+    if (node == nullptr)
+        return std::vector<Batch>();
+
+    // relative to the transform so the part can be animated around its own origin
+    std::vector<Batch>      batches;
+    std::map<int, size_t>   materials;
+
+    for (const auto& child : node->m_children)
+        addBatches(m_model, child, kn5::Matrix(), m_useDiffuse, batches, materials);
+
+    return batches;
+}
+
+const kn5::Texture* kn5model::findTexture(const std::string& name) const
+{
+    for (const auto& texture : m_model.m_textures)
+    {
+        if (texture.m_name == name)
+            return &texture;
+    }
+
+    return nullptr;
+}
+
+void kn5model::interleave(const kn5::Node& node, const kn5::Matrix& matrix, float uvMultiplier, Vertex* vertices)
+{
+    const bool identity = matrix.isIdentity();
+
+    for (const auto& vertex : node.m_vertices)
+    {
+        const kn5::Vec3 position = identity ? vertex.m_position : vertex.m_position.transformPoint(matrix);
+        const kn5::Vec3 normal = identity ? vertex.m_normal : vertex.m_normal.transformVector(matrix);
+
+        for (size_t i = 0; i < 3; i++)
+        {
+            vertices->m_position[i] = position[i];
+            vertices->m_normal[i] = normal[i];
+        }
+
+        vertices->m_uv[0] = vertex.m_texture[0] * uvMultiplier;
+        vertices->m_uv[1] = vertex.m_texture[1] * uvMultiplier;
+
+        vertices++;
+    }
+}
+
+std::vector<kn5model::Batch> kn5model::makeBatches(const kn5& model, const kn5::Node& node, bool useDiffuse)
+{
+    std::vector<Batch>      batches;
+    std::map<int, size_t>   materials;
+
+    addBatches(model, node, kn5::Matrix(), useDiffuse, batches, materials);
+
+    return batches;
+}
+
+float kn5model::getUVMultiplier(const kn5::Material& material, bool useDiffuse)
+{
+    float uvMult = 1.0f;
+
+    if (useDiffuse)
+    {
+        const kn5::ShaderProperty* property = material.findShaderProperty("diffuseMult");
+
+        if (property != nullptr)
+            uvMult = property->m_value;
+    }
+    else
+    {
+        const kn5::ShaderProperty* property = material.findShaderProperty("useDetail");
+
+        if (property == nullptr || property->m_value == 0.0f)
+        {
+            property = material.findShaderProperty("diffuseMult");
+
+            if (property != nullptr)
+                uvMult = property->m_value;
+        }
+        else
+        {
+            property = material.findShaderProperty("detailUVMultiplier");
+
+            if (property != nullptr)
+                uvMult = 1 / property->m_value;
+        }
+    }
+
+    return uvMult;
+}
@@ -0,0 +1,65 @@
+#ifndef _KN5MODEL_H_
+#define _KN5MODEL_H_
+
+#include "kn5.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Read only kn5 model with draw ready vertex and index buffers.
+// All methods are const so a handle can be shared between threads without locking.
+class kn5model
+{
+public:
+    struct Vertex
+    {
+        float   m_position[3] = { 0, 0, 0 };
+        float   m_normal[3] = { 0, 0, 0 };
+        float   m_uv[2] = { 0, 0 };
+    };
+
+    // all the triangles using one material with the node transforms applied
+    struct Batch
+    {
+        int                     m_materialID = 0;
+        std::vector<Vertex>     m_vertices;
+        std::vector<uint32_t>   m_indices;
+    };
+
+    using Handle = std::shared_ptr<const kn5model>;
+
+    // the uvs are scaled for the diffuse texture, or with useDiffuse false for the detail texture of the materials using it
+    static Handle load(const std::string& fileName, bool useDiffuse = true);
+
+    explicit kn5model(const std::string& fileName, bool useDiffuse = true);
+    kn5model(const kn5model&) = delete;
+    kn5model& operator=(const kn5model&) = delete;
+
+    const kn5& getModel() const
+    {
+        return m_model;
+    }
+    const std::vector<Batch>& getBatches() const
+    {
+        return m_batches;
+    }
+    std::vector<Batch> getBatches(const std::string& transformName) const;
+    const kn5::Material& getMaterial(const Batch& batch) const
+    {
+        return m_model.m_materials[batch.m_materialID];
+    }
+    const kn5::Texture* findTexture(const std::string& name) const;
+
+    // the uv scale of the texture a material shows, diffuseMult or 1 / detailUVMultiplier
+    static float getUVMultiplier(const kn5::Material& material, bool useDiffuse);
+    static void interleave(const kn5::Node& node, const kn5::Matrix& matrix, float uvMultiplier, Vertex* vertices);
+    static std::vector<Batch> makeBatches(const kn5& model, const kn5::Node& node, bool useDiffuse);
+
+private:
+    kn5                 m_model;
+    bool                m_useDiffuse = true;
+    std::vector<Batch>  m_batches;
+};
+
+#endif
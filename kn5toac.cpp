@@ -1,11 +1,40 @@
 #include "kn5.h"
+#include "kn5model.h"
 #include "ini.h"
 #include "lut.h"
 #include "acd.h"
+#include "datasource.h"
+#include "carconfig.h"
 #include "knh.h"
+#include "dds.h"
+#include "png.h"
+#include "jobs.h"
+#include "contenthash.h"
+#include "assetstore.h"
+#include "bake.h"
+#include "xmlwriter.h"
+#include "taskgraph.h"
+#include "manifest.h"
 
 #include <fstream>
 #include <filesystem>
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <map>
+#include <limits>
+#include <charconv>
+#include <cstring>
+#include <cstddef>
+#include <cstdio>
+#include <sstream>
+#include <csignal>
+#include <chrono>
+#include <iomanip>
+#include <cctype>
+#include <functional>
+#include <memory>
+#include <mutex>
 
 namespace
 {
@@ -26,364 +55,358 @@ namespace
             node->m_parent->removeChild(node);
     }
 
-    void writeConfig(const std::filesystem::path& inputPath, const std::string& dataDirectoryPath, const std::string& filename, const kn5& model, float length, float width, float height, const std::string& category, bool outputACC)
+    // the Speed Dreams car parameters, the params element is closed when this returns
+    void makeConfig(xmlwriter& xml, const std::filesystem::path& inputPath, const carconfig& config, const kn5& model, float length, float width, const std::string& category, bool outputACC)
     {
-        ini aero(std::filesystem::path(dataDirectoryPath).append("aero.ini").string());
-        ini brakes(std::filesystem::path(dataDirectoryPath).append("brakes.ini").string());
-        ini car(std::filesystem::path(dataDirectoryPath).append("car.ini").string());
-        //ini colliders(std::filesystem::path(dataDirectoryPath).append("colliders.ini").string());
-        ini drivetrain(std::filesystem::path(dataDirectoryPath).append("drivetrain.ini").string());
-        //ini electronics;
-        //if (std::filesystem::exists(std::filesystem::path(dataDirectoryPath).append("electronics.ini").string()))
-        //    electronics.read(std::filesystem::path(dataDirectoryPath).append("electronics.ini").string());
-        ini engine(std::filesystem::path(dataDirectoryPath).append("engine.ini").string());
-        //ini lods(std::filesystem::path(dataDirectoryPath).append("lods.ini").string());
-        //ini flames;
-        //if (std::filesystem::exists(std::filesystem::path(dataDirectoryPath).append("flames.ini").string()))
-        //    flames.read(std::filesystem::path(dataDirectoryPath).append("flames.ini").string());
-        ini setup(std::filesystem::path(dataDirectoryPath).append("setup.ini").string());
-        ini suspensions(std::filesystem::path(dataDirectoryPath).append("suspensions.ini").string());
-        ini tires(std::filesystem::path(dataDirectoryPath).append("tyres.ini").string());
+        const ini& aero = config.get(carconfig::Aero);
+        const ini& brakes = config.get(carconfig::Brakes);
+        const ini& car = config.get(carconfig::Car);
+        const ini& drivetrain = config.get(carconfig::Drivetrain);
+        const ini& engine = config.get(carconfig::Engine);
+        const ini& setup = config.get(carconfig::Setup);
+        const ini& suspensions = config.get(carconfig::Suspensions);
+        const ini& tires = config.get(carconfig::Tyres);
 
         std::string modelFileName = inputPath.filename().string() + (outputACC ? ".acc" : ".ac");
 
-        std::ofstream   fout(filename);
-
-        if (!fout)
-            throw std::runtime_error("Couldn't create: " + filename);
-
         std::array<float, 3> graphicsCorrection = car.getFloatArray3Value("BASIC", "GRAPHICS_OFFSET");
 
-        fout << "<?xml version=\"1.0\"?>" << std::endl;
-        fout << "<!DOCTYPE params SYSTEM \"../../../../src/libs/tgf/params.dtd\">" << std::endl;
+        xml.line("<?xml version=\"1.0\"?>");
+        xml.line("<!DOCTYPE params SYSTEM \"../../../../src/libs/tgf/params.dtd\">");
 
         //---------------------------------------------------------------------
 
-        fout << "<params name=\"" << car.getValue("INFO", "SCREEN_NAME") << "\" type=\"template\">" << std::endl;
+        const auto params = xml.open("params", { { "name", car.getView("INFO", "SCREEN_NAME") }, { "type", "template" } });
 
         //---------------------------------------------------------------------
 
-        fout << "\t<section name=\"Features\">" << std::endl;
-        //fout << "\t\t<attstr name=\"shifting aero coordinate\" in=\"yes\" val=\"" << "yes" << "\"/>>" << std::endl;
-        //fout << "\t\t<attstr name=\"tire temperature and degradation\" in=\"yes\" val=\"" << "yes" << "\"/>>" << std::endl;
-        //fout << "\t\t<attstr name=\"enable abs\" in=\"yes\" val=\"" << "yes" << "\"/>>" << std::endl;
-        //fout << "\t\t<attstr name=\"enable tcl\" in=\"yes\" val=\"" << "yes" << "\"/>>" << std::endl;
-        //fout << "\t\t<attstr name=\"enable esp\" in=\"yes\" val=\"" << "yes" << "\"/>>" << std::endl;
-        fout << "\t</section>" << std::endl;
+        {
+            const auto section = xml.section("Features");
+            //xml.attstr("shifting aero coordinate", "yes");
+            //xml.attstr("tire temperature and degradation", "yes");
+            //xml.attstr("enable abs", "yes");
+            //xml.attstr("enable tcl", "yes");
+            //xml.attstr("enable esp", "yes");
+        }
 
         //---------------------------------------------------------------------
 
-        fout << "\t<section name=\"Bonnet\">" << std::endl;
-        std::array<float, 3> bonnet = car.getFloatArray3Value("GRAPHICS", "BONNET_CAMERA_POS");
-        fout << "\t\t<attnum name=\"xpos\" unit=\"m\" val=\"" << bonnet[2] << "\"/>" << std::endl;
-        fout << "\t\t<attnum name=\"ypos\" unit=\"m\" val=\"" << bonnet[0] << "\"/>" << std::endl;
-        fout << "\t\t<attnum name=\"zpos\" unit=\"m\" val=\"" << bonnet[1] << "\"/>" << std::endl;
-        fout << "\t</section>" << std::endl;
+        {
+            const auto section = xml.section("Bonnet");
+            std::array<float, 3> bonnet = car.getFloatArray3Value("GRAPHICS", "BONNET_CAMERA_POS");
+            xml.attnum("xpos", "m", bonnet[2]);
+            xml.attnum("ypos", "m", bonnet[0]);
+            xml.attnum("zpos", "m", bonnet[1]);
+        }
 
         //---------------------------------------------------------------------
 
-        fout << "\t<section name=\"Driver\">" << std::endl;
-        std::array<float, 3> driverEyes = car.getFloatArray3Value("GRAPHICS", "DRIVEREYES");
-        fout << "\t\t<attnum name=\"xpos\" unit=\"m\" val=\"" << driverEyes[2] << "\"/>" << std::endl;
-        fout << "\t\t<attnum name=\"ypos\" unit=\"m\" val=\"" << driverEyes[0] << "\"/>" << std::endl;
-        fout << "\t\t<attnum name=\"zpos\" unit=\"m\" val=\"" << driverEyes[1] << "\"/>" << std::endl;
-        fout << "\t</section>" << std::endl;
+        {
+            const auto section = xml.section("Driver");
+            std::array<float, 3> driverEyes = car.getFloatArray3Value("GRAPHICS", "DRIVEREYES");
+            xml.attnum("xpos", "m", driverEyes[2]);
+            xml.attnum("ypos", "m", driverEyes[0]);
+            xml.attnum("zpos", "m", driverEyes[1]);
+        }
 
         //---------------------------------------------------------------------
 
-        fout << "\t<section name=\"Sound\">" << std::endl;
-        //	<attstr name="engine sample" val="aichiv10.wav"/>
-        //	<attnum name="rpm	scale" val="0.37"/>
-        fout << "\t</section>" << std::endl;
+        {
+            const auto section = xml.section("Sound");
+            //	<attstr name="engine sample" val="aichiv10.wav"/>
+            //	<attnum name="rpm	scale" val="0.37"/>
+        }
 
         //---------------------------------------------------------------------
 
-        fout << "\t<section name=\"Graphic Objects\">" << std::endl;
-        fout << "\t\t<attstr name=\"env\" val=\"" << modelFileName << "\"/>" << std::endl;
-        // fout << "\t\t<attstr name=\"wheel texture\" val=\"" << "tex-wheel.png" << "\"/>" << std::endl;
-        // fout << "\t\t<attstr name=\"shadow texture\" val=\"" << "shadow.png" << "\"/>" << std::endl;
-        // fout << "\t\t<attstr name=\"tachometer texture\" val=\"" << "rpm20000.png" << "\"/>" << std::endl;
-        // fout << "\t\t<attnum name=\"tachometer min value\" val=\"" << 0 << " unit=\"rpm\"\"/>" << std::endl;
-        // fout << "\t\t<attnum name=\"tachometer max value\" val=\"" << 20000 << " unit=\"rpm\"\"/>" << std::endl;
-        // fout << "\t\t<attstr name=\"speedometer texture\" val=\"" << "speed360.png" << "\"/>" << std::endl;
-        // fout << "\t\t<attnum name=\"speedometer min value\" val=\"" << 0 << " unit=\"km/h\"\"/>" << std::endl;
-        // fout << "\t\t<attnum name=\"speedometer max value\" val=\"" << 360<< " unit=\"km/h\"\"/>" << std::endl;
-        // fout << "\t\t<attnum name=\"needle red\" val=\"" << 0.95 << "\"/>" << std::endl;
-        // fout << "\t\t<attnum name=\"needle green\" val=\"" << 0.95 << "\"/>" << std::endl;
-        // fout << "\t\t<attnum name=\"needle blue\" val=\"" << 0.95 << "\"/>" << std::endl;
-        // fout << "\t\t<attnum name=\"needle alpha\" val=\"" << 1 << "\"/>" << std::endl;
-        fout << "\t\t<section name=\"Ranges\">" << std::endl;
-        fout << "\t\t\t<section name=\"1\">" << std::endl;
-        fout << "\t\t\t\t<attnum name=\"threshold\" val=\"" << 0 << "\"/>" << std::endl;
-        fout << "\t\t\t\t<attstr name=\"car\" val=\"" << modelFileName << "\"/>" << std::endl;
-        // fout << "\t\t\t\t<attstr name=\"wheels\" val=\"yes\"/>" << std::endl;
-        fout << "\t\t\t</section>" << std::endl;
-        fout << "\t\t</section>" << std::endl;
-        fout << "\t\t<section name=\"Light\">" << std::endl;
-        fout << "\t\t</section>" << std::endl;
-        fout << "\t\t<section name=\"Steer Wheel\">" << std::endl;
-        fout << "\t\t\t<attstr name=\"model\" val=\"steer.acc\"/>" << std::endl;
-        fout << "\t\t\t<attstr name=\"hi res model\" val=\"histeer.acc\"/>" << std::endl;
-        kn5::Vec3   steer = { 0, 0, 0 };
-        const kn5::Node* steerNode = model.findNode(kn5::Node::Transform, "STEER_LR");
-
-        if (steerNode)
-        {
-            kn5::Matrix matrix = steerNode->getTransform();
-
-            steer[0] = matrix.m_data[3][2];
-            steer[1] = matrix.m_data[3][0];
-            steer[2] = matrix.m_data[3][1];
-
-            fout << "\t\t\t<attnum name=\"xpos\" val=\"" << steer[0] << "\"/>" << std::endl;
-            fout << "\t\t\t<attnum name=\"ypos\" val=\"" << steer[1] << "\"/>" << std::endl;
-            fout << "\t\t\t<attnum name=\"zpos\" val=\"" << steer[2] << "\"/>" << std::endl;
-        }
-        else
         {
-            kn5::Vec3   steerHi = { 0, 0, 0 };
-            const kn5::Node* steerNodeHi = model.findNode(kn5::Node::Transform, "STEER_HR");
-
-            if (steerNodeHi)
+            const auto section = xml.section("Graphic Objects");
+            xml.attstr("env", modelFileName);
+            // xml.attstr("wheel texture", "tex-wheel.png");
+            // xml.attstr("shadow texture", "shadow.png");
+            // xml.attstr("tachometer texture", "rpm20000.png");
+            // xml.attnum("tachometer min value", "rpm", 0);
+            // xml.attnum("tachometer max value", "rpm", 20000);
+            // xml.attstr("speedometer texture", "speed360.png");
+            // xml.attnum("speedometer min value", "km/h", 0);
+            // xml.attnum("speedometer max value", "km/h", 360);
+            // xml.attnum("needle red", 0.95);
+            // xml.attnum("needle green", 0.95);
+            // xml.attnum("needle blue", 0.95);
+            // xml.attnum("needle alpha", 1);
             {
-                kn5::Matrix matrix = steerNodeHi->getTransform();
+                const auto ranges = xml.section("Ranges");
+                const auto range = xml.section("1");
+                xml.attnum("threshold", 0);
+                xml.attstr("car", modelFileName);
+                // xml.attstr("wheels", "yes");
+            }
+            {
+                const auto light = xml.section("Light");
+            }
+            {
+                const auto steerWheel = xml.section("Steer Wheel");
+                xml.attstr("model", "steer.acc");
+                xml.attstr("hi res model", "histeer.acc");
+                kn5::Vec3   steer = { 0, 0, 0 };
+                const kn5::Node* steerNode = model.findNode(kn5::Node::Transform, "STEER_LR");
 
-                steerHi[0] = matrix.m_data[3][2];
-                steerHi[1] = matrix.m_data[3][0];
-                steerHi[2] = matrix.m_data[3][1];
+                if (steerNode)
+                {
+                    kn5::Matrix matrix = steerNode->getTransform();
 
-                fout << "\t\t\t<attnum name=\"xpos\" val=\"" << steerHi[0] << "\"/>" << std::endl;
-                fout << "\t\t\t<attnum name=\"ypos\" val=\"" << steerHi[1] << "\"/>" << std::endl;
-                fout << "\t\t\t<attnum name=\"zpos\" val=\"" << steerHi[2] << "\"/>" << std::endl;
-            }
-        }
+                    steer[0] = matrix.m_data[3][2];
+                    steer[1] = matrix.m_data[3][0];
+                    steer[2] = matrix.m_data[3][1];
 
-        //	<attnum name="angle" val="0"/>
-        fout << "\t\t</section>" << std::endl;
-        fout << "\t\t<section name=\"Driver\">" << std::endl;
-        fout << "\t\t</section>" << std::endl;
-        fout << "\t</section>" << std::endl;
+                    xml.attnum("xpos", steer[0]);
+                    xml.attnum("ypos", steer[1]);
+                    xml.attnum("zpos", steer[2]);
+                }
+                else
+                {
+                    kn5::Vec3   steerHi = { 0, 0, 0 };
+                    const kn5::Node* steerNodeHi = model.findNode(kn5::Node::Transform, "STEER_HR");
 
-        //---------------------------------------------------------------------
+                    if (steerNodeHi)
+                    {
+                        kn5::Matrix matrix = steerNodeHi->getTransform();
 
-        fout << "\t<section name=\"Car\">" << std::endl;
-        fout << "\t\t<attstr name=\"category\" val=\"" << category << "\"/>" << std::endl;
-        //    fout << "\t\t<attnum name=\"body length\" unit=\"m\" val=\"" << 4.86 << "\"/>" << std::endl;
-        //    fout << "\t\t<attnum name=\"body width\" unit=\"m\" val=\"" << 2.00 << "\"/>" << std::endl;
-        //    fout << "\t\t<attnum name=\"body height\" unit=\"m\" val=\"" << 1.05 << "\"/>" << std::endl;
-        fout << "\t\t<attnum name=\"overall length\" unit=\"m\" val=\"" << length << "\"/>" << std::endl;
-        fout << "\t\t<attnum name=\"overall width\" unit=\"m\" val=\"" << width << "\"/>" << std::endl;
-        fout << "\t\t<attnum name=\"mass\" unit=\"kg\" val=\"" << car.getValue("BASIC", "TOTALMASS") << "\"/>" << std::endl;
-        //    fout << "\t\t<attnum name=\"GC height\" unit=\"m\" val=\"" << 0.24 << "\"/>" << std::endl;
-        fout << "\t\t<attnum name=\"front-rear weight repartition\" val=\"" << suspensions.getValue("BASIC", "CG_LOCATION") << "\"/>" << std::endl;
-        fout << "\t\t<attnum name=\"front right-left weight repartition\" val=\"" << 0.5 << "\"/>" << std::endl;
-        fout << "\t\t<attnum name=\"rear right-left weight repartition\" val=\"" << 0.5 << "\"/>" << std::endl;
-        //    fout << "\t\t<attnum name=\"mass repartition coefficient\" val=\"" << 0.8 << "\"/>" << std::endl;
-        fout << "\t\t<attnum name=\"fuel tank\" unit=\"l\" val=\"" << car.getValue("FUEL", "MAX_FUEL") << "\"/>" << std::endl;
-        fout << "\t\t<attnum name=\"initial fuel\" unit=\"l\" min=\"1.0\" max=\"" << car.getValue("FUEL", "MAX_FUEL") << "\" val=\"" << car.getValue("FUEL", "FUEL") << "\"/>" << std::endl;
-        fout << "\t</section>" << std::endl;
+                        steerHi[0] = matrix.m_data[3][2];
+                        steerHi[1] = matrix.m_data[3][0];
+                        steerHi[2] = matrix.m_data[3][1];
 
-        //---------------------------------------------------------------------
+                        xml.attnum("xpos", steerHi[0]);
+                        xml.attnum("ypos", steerHi[1]);
+                        xml.attnum("zpos", steerHi[2]);
+                    }
+                }
 
-        fout << "\t<section name=\"Exhaust\">" << std::endl;
-        //	<attnum name="power" val="1.5"/>
-        fout << "\t</section>" << std::endl;
+                //	<attnum name="angle" val="0"/>
+            }
+            {
+                const auto driver = xml.section("Driver");
+            }
+        }
 
         //---------------------------------------------------------------------
 
-        fout << "\t<section name=\"Aerodynamics\">" << std::endl;
-        if (aero.getValue("WING_0", "NAME") == "BODY")
         {
-            std::string cdLutFile = aero.getValue("WING_0", "LUT_AOA_CD");
-
-            std::filesystem::path   cdLutFilePath = dataDirectoryPath;
+            const auto section = xml.section("Car");
+            xml.attstr("category", category);
+            //    xml.attnum("body length", "m", 4.86);
+            //    xml.attnum("body width", "m", 2.00);
+            //    xml.attnum("body height", "m", 1.05);
+            xml.attnum("overall length", "m", length);
+            xml.attnum("overall width", "m", width);
+            xml.attnum("mass", "kg", car.getView("BASIC", "TOTALMASS"));
+            //    xml.attnum("GC height", "m", 0.24);
+            xml.attnum("front-rear weight repartition", suspensions.getView("BASIC", "CG_LOCATION"));
+            xml.attnum("front right-left weight repartition", 0.5);
+            xml.attnum("rear right-left weight repartition", 0.5);
+            //    xml.attnum("mass repartition coefficient", 0.8);
+            xml.attnum("fuel tank", "l", car.getView("FUEL", "MAX_FUEL"));
+            xml.attnum("initial fuel", "l", "1.0", car.getView("FUEL", "MAX_FUEL"), car.getView("FUEL", "FUEL"));
+        }
 
-            cdLutFilePath.append(cdLutFile);
+        //---------------------------------------------------------------------
 
-            if (std::filesystem::exists(cdLutFilePath))
-            {
-                lut cdLut(cdLutFilePath.string());
+        {
+            const auto section = xml.section("Exhaust");
+            //	<attnum name="power" val="1.5"/>
+        }
 
-                fout << "\t\t<attnum name=\"Cx\" val=\"" << cdLut.lookup(0) << "\"/>" << std::endl;
-            }
+        //---------------------------------------------------------------------
 
-            fout << "\t\t<attnum name=\"front area\" unit=\"m2\" val=\"" << (aero.getFloatValue("WING_0", "CHORD") * aero.getFloatValue("WING_0", "SPAN")) << "\"/>" << std::endl;
+        {
+            const auto section = xml.section("Aerodynamics");
+            if (aero.getValue("WING_0", "NAME") == "BODY")
+            {
+                std::string cdLutFile = aero.getValue("WING_0", "LUT_AOA_CD");
 
-            float clGain = aero.getFloatValue("WING_0", "CL_GAIN");
+                if (config.hasLut(cdLutFile))
+                {
+                    const lut& cdLut = config.getLut(cdLutFile);
 
-            if (clGain != 0)
-            {
-                std::string clLutFile = aero.getValue("WING_0", "LUT_AOA_CL");
+                    xml.attnum("Cx", cdLut.lookup(0));
+                }
 
-                std::filesystem::path   clLutFilePath = dataDirectoryPath;
+                xml.attnum("front area", "m2", (aero.getFloatValue("WING_0", "CHORD") * aero.getFloatValue("WING_0", "SPAN")));
 
-                clLutFilePath.append(clLutFile);
+                float clGain = aero.getFloatValue("WING_0", "CL_GAIN");
 
-                if (std::filesystem::exists(cdLutFilePath))
+                if (clGain != 0)
                 {
-                    lut clLut(clLutFilePath.string());
+                    std::string clLutFile = aero.getValue("WING_0", "LUT_AOA_CL");
 
-                    const float value = clLut.lookup(0) * clGain;
+                    if (config.hasLut(clLutFile))
+                    {
+                        const lut& clLut = config.getLut(clLutFile);
+
+                        const float value = clLut.lookup(0) * clGain;
 
-                    fout << "\t\t<attnum name=\"front Clift\" min=\"0.0\" max=\"1.0\" val=\"" << value << "\"/>" << std::endl;
-                    fout << "\t\t<attnum name=\"rear Clift\" min=\"0.0\" max=\"1.0\" val=\"" << value << "\"/>" << std::endl;
+                        xml.attnum("front Clift", "", "0.0", "1.0", value);
+                        xml.attnum("rear Clift", "", "0.0", "1.0", value);
+                    }
                 }
             }
+            else
+                std::cerr << "Couldnt find BODY in [WING_0] NAME: " << aero.getFileName() << std::endl;
         }
-        else
-            std::cerr << "Couldnt find BODY in [WING_0] NAME: " << aero.getFileName() << std::endl;
-        fout << "\t</section>" << std::endl;
 
         //---------------------------------------------------------------------
 
-        fout << "\t<section name=\"Front Wing\">" << std::endl;
-        //	<attnum name="area" unit="m2" val="0.23"/>
-        //	<attnum name="angle" unit="deg" min="0" max="12" val="7"/>
-        //	<attnum name="xpos" unit="m" val="2.23"/>
-        //	<attnum name="zpos" unit="m" val="0.05"/>
-        fout << "\t</section>" << std::endl;
+        {
+            const auto section = xml.section("Front Wing");
+            //	<attnum name="area" unit="m2" val="0.23"/>
+            //	<attnum name="angle" unit="deg" min="0" max="12" val="7"/>
+            //	<attnum name="xpos" unit="m" val="2.23"/>
+            //	<attnum name="zpos" unit="m" val="0.05"/>
+        }
 
         //---------------------------------------------------------------------
 
-        fout << "\t<section name=\"Rear Wing\">" << std::endl;
-        //	<attnum name="area" unit="m2" val="0.68"/>
-        //	<attnum name="angle" unit="deg" min="0" max="18" val="13"/>
-        //	<attnum name="xpos" unit="m" val="-1.95"/>
-        //	<attnum name="zpos" unit="m" val="0.95"/>
-        fout << "\t</section>" << std::endl;
+        {
+            const auto section = xml.section("Rear Wing");
+            //	<attnum name="area" unit="m2" val="0.68"/>
+            //	<attnum name="angle" unit="deg" min="0" max="18" val="13"/>
+            //	<attnum name="xpos" unit="m" val="-1.95"/>
+            //	<attnum name="zpos" unit="m" val="0.95"/>
+        }
 
         //---------------------------------------------------------------------
 
-        fout << "\t<section name=\"Engine\">" << std::endl;
-        if (engine.hasSections())
         {
-            //	<attnum name="capacity" unit="l" val="3.6"/>
-            //	<attnum name="cylinders" val="6"/>
-            //	<attstr name="shape" in="v,l,h,w" val="h"/>
-            //	<attstr name="position" in="front,front-mid,mid,rear-mid,rear," val="rear"/>
-            std::vector<std::pair<float, float>> values;
-            std::string powerLutFileName = engine.getValue("HEADER", "POWER_CURVE");
-            if (!powerLutFileName.empty())
+            const auto section = xml.section("Engine");
+            if (engine.hasSections())
             {
-                std::filesystem::path powerPath = dataDirectoryPath;
-                powerPath.append(powerLutFileName);
-                lut power(powerPath.string());
-                values = power.getValues();
-                fout << "\t\t<attnum name=\"revs maxi\" unit=\"rpm\" min=\"5000\" max=\"10000\" val=\"" << values[values.size() - 1].first << "\"/>" << std::endl;
-            }
-            else
-                std::cerr << "Couldn't find [HEADER] POEWR_CURVE: " << engine.getFileName() << std::endl;
-            fout << "\t\t<attnum name=\"revs limiter\" unit=\"rpm\" val=\"" << engine.getValue("ENGINE_DATA", "LIMITER") << "\"/>" << std::endl;
-            fout << "\t\t<attnum name=\"tickover\" unit=\"rpm\" val=\"" << engine.getValue("ENGINE_DATA", "MINIMUM") << "\"/>" << std::endl;
-            //	<attnum name="fuel cons factor" min="1.1" max="1.3" val="1.13"/>
-            //  <attnum name="brake linear coefficient" val="0.04"/>
-            //  <attnum name="brake coefficient" val="0.04"/>
-            fout << "\t\t<attnum name=\"inertia\" unit=\"kg.m2\" val=\"" << engine.getValue("ENGINE_DATA", "INERTIA") << "\"/>" << std::endl;
-            if (engine.hasSection("TURBO_0"))
-            {
-                fout << "\t\t<attstr name=\"turbo\" val=\"true\"/>" << std::endl;
-                fout << "\t\t<attnum name=\"turbo rpm\" unit=\"rpm\" val=\"" << engine.getValue("TURBO_0", "REFERENCE_RPM") << "\"/>" << std::endl;
-                fout << "\t\t<attnum name=\"turbo lag\" val=\"" << engine.getValue("TURBO_0", "LAG_UP") << "\"/>" << std::endl;
-                //	<attnum name="turbo factor" val="1.0"/>
-            }
-            else
-                fout << "\t\t<attstr name=\"turbo\" val=\"false\"/>" << std::endl;
+                //	<attnum name="capacity" unit="l" val="3.6"/>
+                //	<attnum name="cylinders" val="6"/>
+                //	<attstr name="shape" in="v,l,h,w" val="h"/>
+                //	<attstr name="position" in="front,front-mid,mid,rear-mid,rear," val="rear"/>
+                std::vector<std::pair<float, float>> values;
+                std::string powerLutFileName = engine.getValue("HEADER", "POWER_CURVE");
+                if (!powerLutFileName.empty())
+                {
+                    const lut& power = config.getLut(powerLutFileName);
+                    values = power.getValues();
+                    xml.attnum("revs maxi", "rpm", "5000", "10000", values[values.size() - 1].first);
+                }
+                else
+                    std::cerr << "Couldn't find [HEADER] POEWR_CURVE: " << engine.getFileName() << std::endl;
+                xml.attnum("revs limiter", "rpm", engine.getView("ENGINE_DATA", "LIMITER"));
+                xml.attnum("tickover", "rpm", engine.getView("ENGINE_DATA", "MINIMUM"));
+                //	<attnum name="fuel cons factor" min="1.1" max="1.3" val="1.13"/>
+                //  <attnum name="brake linear coefficient" val="0.04"/>
+                //  <attnum name="brake coefficient" val="0.04"/>
+                xml.attnum("inertia", "kg.m2", engine.getView("ENGINE_DATA", "INERTIA"));
+                if (engine.hasSection("TURBO_0"))
+                {
+                    xml.attstr("turbo", "true");
+                    xml.attnum("turbo rpm", "rpm", engine.getView("TURBO_0", "REFERENCE_RPM"));
+                    xml.attnum("turbo lag", engine.getView("TURBO_0", "LAG_UP"));
+                    //	<attnum name="turbo factor" val="1.0"/>
+                }
+                else
+                    xml.attstr("turbo", "false");
 
-            //  <attnum name="enable tcl" min="0" max="1" val="1" / >
+                //  <attnum name="enable tcl" min="0" max="1" val="1" / >
 
-            fout << "\t\t<section name=\"data points\">" << std::endl;
-            size_t count = 0;
-            for (size_t i = 0; i < values.size(); i++)
-            {
-                // TODO this is torque at wheels
-                if (values[i].first >= 0)
+                const auto dataPoints = xml.section("data points");
+                size_t count = 0;
+                for (size_t i = 0; i < values.size(); i++)
                 {
-                    fout << "\t\t\t<section name=\"" << (count + 1) << "\">" << std::endl;
-                    fout << "\t\t\t\t<attnum name=\"rpm\" unit=\"rpm\" val=\"" << values[i].first << "\"/>" << std::endl;
-                    fout << "\t\t\t\t<attnum name=\"Tq\" unit=\"N.m\" val=\"" << values[i].second << "\"/>" << std::endl;
-                    fout << "\t\t\t</section>" << std::endl;
-                    count++;
+                    // TODO this is torque at wheels
+                    if (values[i].first >= 0)
+                    {
+                        const auto point = xml.section(count + 1);
+                        xml.attnum("rpm", "rpm", values[i].first);
+                        xml.attnum("Tq", "N.m", values[i].second);
+                        count++;
+                    }
                 }
             }
-            fout << "\t\t</section>" << std::endl;
+            else
+                std::cerr << "Couldn't find any sections: " << engine.getFileName() << std::endl;
         }
-        else
-            std::cerr << "Couldn't find any sections: " << engine.getFileName() << std::endl;
-        fout << "\t</section>" << std::endl;
 
         //---------------------------------------------------------------------
 
-        fout << "\t<section name=\"Clutch\">" << std::endl;
-        //  fout << "\t\t<attnum name=\"inertia\" unit=\"kg.m2\" val=\"" << 0.1150<< "\"/>" << std::endl;
-        fout << "\t</section>" << std::endl;
+        {
+            const auto section = xml.section("Clutch");
+            //  xml.attnum("inertia", "kg.m2", 0.1150);
+        }
 
         //---------------------------------------------------------------------
 
-        fout << "\t<section name=\"Gearbox\">" << std::endl;
-        //	<attnum name="shift time" unit="s" val="0.15"/>
-        if (drivetrain.hasSection("GEARS"))
         {
-            fout << "\t\t<section name=\"gears\">" << std::endl;
-            fout << "\t\t\t<section name=\"r\">" << std::endl;
-            fout << "\t\t\t\t<attnum name=\"ratio\" val=\"" << drivetrain.getValue("GEARS", "GEAR_R") << "\"/>" << std::endl;
-            // fout << "\t\t\t\t<attnum name=\"inertia\" val=\"" << 0.0037 << "\"/>" << std::endl;
-            // fout << "\t\t\t\t<attnum name=\"efficiency\" val=\"" << 0.954 << "\"/>" << std::endl;
-            fout << "\t\t\t</section>" << std::endl;
-            try
+            const auto section = xml.section("Gearbox");
+            //	<attnum name="shift time" unit="s" val="0.15"/>
+            if (drivetrain.hasSection("GEARS"))
             {
-                const size_t gears = drivetrain.getIntValue("GEARS", "COUNT");
-                for (size_t i = 0; i < gears; i++)
+                const auto gearsSection = xml.section("gears");
                 {
-                    fout << "\t\t\t<section name=\"" << (i + 1) << "\">" << std::endl;
-                    fout << "\t\t\t\t<attnum name=\"ratio\" val=\"" << drivetrain.getValue("GEARS", "GEAR_" + std::to_string(i + 1)) << "\"/>" << std::endl;
-                    // fout << "\t\t\t\t<attnum name=\"inertia\" val=\"" << 0.0037 << "\"/>" << std::endl;
-                    // fout << "\t\t\t\t<attnum name=\"efficiency\" val=\"" << 0.954 << "\"/>" << std::endl;
-                    fout << "\t\t\t</section>" << std::endl;
+                    const auto reverse = xml.section("r");
+                    xml.attnum("ratio", drivetrain.getView("GEARS", "GEAR_R"));
+                    // xml.attnum("inertia", 0.0037);
+                    // xml.attnum("efficiency", 0.954);
+                }
+                try
+                {
+                    const size_t gears = drivetrain.getIntValue("GEARS", "COUNT");
+                    for (size_t i = 0; i < gears; i++)
+                    {
+                        const auto gear = xml.section(i + 1);
+                        xml.attnum("ratio", drivetrain.getView("GEARS", "GEAR_" + std::to_string(i + 1)));
+                        // xml.attnum("inertia", 0.0037);
+                        // xml.attnum("efficiency", 0.954);
+                    }
+                }
+                catch (...)
+                {
+                    std::cerr << "Couldn't find [GEARS] COUNT: " << drivetrain.getFileName() << std::endl;
                 }
             }
-            catch (...)
-            {
-                std::cerr << "Couldn't find [GEARS] COUNT: " << drivetrain.getFileName() << std::endl;
-            }
-            fout << "\t\t</section>" << std::endl;
         }
-        fout << "\t</section>" << std::endl;
 
         //---------------------------------------------------------------------
 
-        fout << "\t<section name=\"Drivetrain\">" << std::endl;
-        std::string traction = drivetrain.getValue("TRACTION", "TYPE");
-        if (traction == "AWD")
-            traction = "4WD";
-        if (!traction.empty())
-            fout << "\t\t<attstr name=\"type\" val=\"" << traction << "\"/>" << std::endl;
-        //fout << "\t\t<attnum name=\"inertia\" unit=\"kg.m2\" val=\"" << 0.0091 << "\"/>" << std::endl;
-        fout << "\t</section>" << std::endl;
+        {
+            const auto section = xml.section("Drivetrain");
+            std::string traction = drivetrain.getValue("TRACTION", "TYPE");
+            if (traction == "AWD")
+                traction = "4WD";
+            if (!traction.empty())
+                xml.attstr("type", traction);
+            //xml.attnum("inertia", "kg.m2", 0.0091);
+        }
 
         //---------------------------------------------------------------------
 
-        fout << "\t<section name=\"Steer\">" << std::endl;
-        fout << "\t\t<attnum name=\"steer lock\" unit=\"deg\" val=\"" << (car.getFloatValue("CONTROLS", "STEER_LOCK") / car.getFloatValue("CONTROLS", "STEER_RATIO")) << "\"/>" << std::endl;
-        fout << "\t\t<attnum name=\"steering wheel rotation\" unit=\"deg\" val=\"" << (car.getFloatValue("CONTROLS", "STEER_LOCK") * 2) << "\"/>" << std::endl;
-        //	<attnum name="max steer speed" unit="deg/s" min="1" max="360" val="360"/>
-        fout << "\t</section>" << std::endl;
+        {
+            const auto section = xml.section("Steer");
+            xml.attnum("steer lock", "deg", (car.getFloatValue("CONTROLS", "STEER_LOCK") / car.getFloatValue("CONTROLS", "STEER_RATIO")));
+            xml.attnum("steering wheel rotation", "deg", (car.getFloatValue("CONTROLS", "STEER_LOCK") * 2));
+            //	<attnum name="max steer speed" unit="deg/s" min="1" max="360" val="360"/>
+        }
 
         //---------------------------------------------------------------------
 
-        fout << "\t<section name=\"Brake System\">" << std::endl;
-        try
-        {
-            if (brakes.getIntValue("DATA", "COCKPIT_ADJUSTABLE") == 1)
-                fout << "\t\t<attnum name=\"front-rear brake repartition\" min=\"0.3\" max=\"0.7\" val=\"" << brakes.getValue("DATA", "FRONT_SHARE") << "\"/>" << std::endl;
-            else
-                fout << "\t\t<attnum name=\"front-rear brake repartition\" val=\"" << brakes.getValue("DATA", "FRONT_SHARE") << "\"/>" << std::endl;
-        }
-        catch (...)
         {
-            std::cerr << "Couldn't find [DATA]: " << brakes.getFileName() << std::endl;
+            const auto section = xml.section("Brake System");
+            try
+            {
+                if (brakes.getIntValue("DATA", "COCKPIT_ADJUSTABLE") == 1)
+                    xml.attnum("front-rear brake repartition", "", "0.3", "0.7", brakes.getView("DATA", "FRONT_SHARE"));
+                else
+                    xml.attnum("front-rear brake repartition", brakes.getView("DATA", "FRONT_SHARE"));
+            }
+            catch (...)
+            {
+                std::cerr << "Couldn't find [DATA]: " << brakes.getFileName() << std::endl;
+            }
+            //	<attnum name="max pressure" unit="kPa" min="100" max="150000" val="25000"/>
         }
-        //	<attnum name="max pressure" unit="kPa" min="100" max="150000" val="25000"/>
-        fout << "\t</section>" << std::endl;
 
         //---------------------------------------------------------------------
 
@@ -393,21 +416,23 @@ namespace
             float cg = suspensions.getFloatValue("BASIC", "CG_LOCATION");
             float xpos = ((wheelbase * (1 - cg)) - graphicsCorrection[2]);
 
-            fout << "\t<section name=\"Front Axle\">" << std::endl;
-            fout << "\t\t<attnum name=\"xpos\" val=\"" << xpos << "\"/>" << std::endl;
-            //	<attnum name="inertia" unit="kg.m2" val="0.0056"/>
-            //	<attnum name="roll center height" unit="m" min="0" max="0.5" val="0.11"/>
-            fout << "\t</section>" << std::endl;
+            {
+                const auto section = xml.section("Front Axle");
+                xml.attnum("xpos", xpos);
+                //	<attnum name="inertia" unit="kg.m2" val="0.0056"/>
+                //	<attnum name="roll center height" unit="m" min="0" max="0.5" val="0.11"/>
+            }
 
             //---------------------------------------------------------------------
 
             xpos = (-cg * wheelbase) - graphicsCorrection[2];
 
-            fout << "\t<section name=\"Rear Axle\">" << std::endl;
-            fout << "\t\t<attnum name=\"xpos\" val=\"" << xpos << "\"/>" << std::endl;
-            //	<attnum name="inertia" unit="kg.m2" val="0.0080"/>
-            //	<attnum name="roll center height" unit="m" min="0" max="0.5" val="0.14"/>
-            fout << "\t</section>" << std::endl;
+            {
+                const auto section = xml.section("Rear Axle");
+                xml.attnum("xpos", xpos);
+                //	<attnum name="inertia" unit="kg.m2" val="0.0080"/>
+                //	<attnum name="roll center height" unit="m" min="0" max="0.5" val="0.14"/>
+            }
         }
         catch (...)
         {
@@ -416,28 +441,31 @@ namespace
 
         //---------------------------------------------------------------------
 
-        fout << "\t<section name=\"Front Differential\">" << std::endl;
-        //	<attstr name="type" in="SPOOL,FREE,LIMITED SLIP" val="LIMITED SLIP"/>
-        if (drivetrain.hasSections() && drivetrain.getValue("TRACTION", "TYPE") != "RWD")
-            fout << "\t\t<attnum name=\"ratio\" val=\"" << drivetrain.getValue("GEARS", "FINAL") << "\"/>" << std::endl;
-        //	<attnum name="inertia" unit="kg.m2" val="0.0488"/>
-        //	<attnum name="efficiency" val="1.0"/>
-        fout << "\t</section>" << std::endl;
+        {
+            const auto section = xml.section("Front Differential");
+            //	<attstr name="type" in="SPOOL,FREE,LIMITED SLIP" val="LIMITED SLIP"/>
+            if (drivetrain.hasSections() && drivetrain.getValue("TRACTION", "TYPE") != "RWD")
+                xml.attnum("ratio", drivetrain.getView("GEARS", "FINAL"));
+            //	<attnum name="inertia" unit="kg.m2" val="0.0488"/>
+            //	<attnum name="efficiency" val="1.0"/>
+        }
 
         //---------------------------------------------------------------------
 
-        fout << "\t<section name=\"Rear Differential\">" << std::endl;
-        //	<attstr name="type" in="SPOOL,FREE,LIMITED SLIP" val="LIMITED SLIP"/>
-        if (drivetrain.hasSections() && drivetrain.getValue("TRACTION", "TYPE") != "FWD")
-            fout << "\t\t<attnum name=\"ratio\" val=\"" << drivetrain.getValue("GEARS", "FINAL") << "\"/>" << std::endl;
-        //	<attnum name="inertia" unit="kg.m2" val="0.0488"/>
-        //	<attnum name="efficiency" val="1.0"/>
-        fout << "\t</section>" << std::endl;
+        {
+            const auto section = xml.section("Rear Differential");
+            //	<attstr name="type" in="SPOOL,FREE,LIMITED SLIP" val="LIMITED SLIP"/>
+            if (drivetrain.hasSections() && drivetrain.getValue("TRACTION", "TYPE") != "FWD")
+                xml.attnum("ratio", drivetrain.getView("GEARS", "FINAL"));
+            //	<attnum name="inertia" unit="kg.m2" val="0.0488"/>
+            //	<attnum name="efficiency" val="1.0"/>
+        }
 
         //---------------------------------------------------------------------
 
-        fout << "\t<section name=\"Central Differential\">" << std::endl;
-        fout << "\t</section>" << std::endl;
+        {
+            const auto section = xml.section("Central Differential");
+        }
 
         //---------------------------------------------------------------------
 
@@ -450,48 +478,50 @@ namespace
             float frontRimRadius = tires.getFloatValue("FRONT", "RIM_RADIUS") - 0.0254f;
             float frontTireAspectRatio = (tires.getFloatValue("FRONT", "RADIUS") - frontRimRadius) / tires.getFloatValue("FRONT", "WIDTH");
             float frontWheelTireInertia = tires.getFloatValue("FRONT", "ANGULAR_INERTIA") - frontBrakeInertia;
-            fout << "\t<section name=\"Front Right Wheel\">" << std::endl;
-            fout << "\t\t<attnum name=\"ypos\" unit=\"m\" val=\"" << (-frontTrack / 2) << "\"/>" << std::endl;
-            fout << "\t\t<attnum name=\"rim diameter\" unit=\"m\" val=\"" << (frontRimRadius * 2.0f) << "\"/>" << std::endl;
-            fout << "\t\t<attnum name=\"tire width\" unit=\"m\" val=\"" << tires.getValue("FRONT", "WIDTH") << "\"/>" << std::endl;
-            //  fout << "\t\t<attnum name=\"tire height\" unit=\"m\" val=\"" << (tires.getFloatValue("FRONT", "RADIUS") * 2.0f) << "\"/>" << std::endl;
-            fout << "\t\t<attnum name=\"tire height-width ratio\" val=\"" << frontTireAspectRatio << "\"/>" << std::endl;
-            fout << "\t\t<attnum name=\"inertia\" unit=\"kg.m2\" val=\"" << frontWheelTireInertia << "\"/>" << std::endl;
-            //  <attnum name="mass" unit="kg" val="24.5"/>
-            //  fout << "\t\t<attnum name = "ride height" unit = "mm" min = "100" max = "300" val = "100" / >" << std::endl;
-            //  fout << "\t\t<attnum name = "toe" unit = "deg" min = "-5" max = "5" val = "0" / >" << std::endl;
-            //  fout << "\t\t<attnum name = "camber" min = "-5" max = "0" unit = "deg" val = "-5" / >" << std::endl;
-            //  <attnum name="pressure" unit="PSI" min="22" max="55" val="29.0"/>
-            //  fout << "\t\t<attnum name = "stiffness" val = "27.0" / >" << std::endl;
-            //  fout << "\t\t<attnum name = "dynamic friction" unit = "%" val = "80" / >" << std::endl;
-            //  <attnum name="elasticity factor" val="0.87"/>
-            //  <attnum name = "operating load" unit = "N" val = "3123.75" / >
-            //  fout << "\t\t<attnum name = "rolling resistance" val = "0.02" / >" << std::endl;
-            //  fout << "\t\t<attnum name = "mu" min = "0.05" max = "1.6" val = "1.6" / >" << std::endl;
-            //  <attnum name="cold mu factor" val="0.82"/>
-            //  <attnum name="falloff grip multiplier" val="0.88"/>
-            //  <attnum name="optimal temperature" val="353.15"/>
-            //  <attnum name="heating multiplier" val="0.00002"/>
-            //  <attnum name="air cooling multiplier" val="0.0028"/>
-            fout << "\t</section>" << std::endl;
+            {
+                const auto section = xml.section("Front Right Wheel");
+                xml.attnum("ypos", "m", (-frontTrack / 2));
+                xml.attnum("rim diameter", "m", (frontRimRadius * 2.0f));
+                xml.attnum("tire width", "m", tires.getView("FRONT", "WIDTH"));
+                //  xml.attnum("tire height", "m", (tires.getFloatValue("FRONT", "RADIUS") * 2.0f));
+                xml.attnum("tire height-width ratio", frontTireAspectRatio);
+                xml.attnum("inertia", "kg.m2", frontWheelTireInertia);
+                //  <attnum name="mass" unit="kg" val="24.5"/>
+                //  <attnum name = "ride height" unit = "mm" min = "100" max = "300" val = "100" / >
+                //  <attnum name = "toe" unit = "deg" min = "-5" max = "5" val = "0" / >
+                //  <attnum name = "camber" min = "-5" max = "0" unit = "deg" val = "-5" / >
+                //  <attnum name="pressure" unit="PSI" min="22" max="55" val="29.0"/>
+                //  <attnum name = "stiffness" val = "27.0" / >
+                //  <attnum name = "dynamic friction" unit = "%" val = "80" / >
+                //  <attnum name="elasticity factor" val="0.87"/>
+                //  <attnum name = "operating load" unit = "N" val = "3123.75" / >
+                //  <attnum name = "rolling resistance" val = "0.02" / >
+                //  <attnum name = "mu" min = "0.05" max = "1.6" val = "1.6" / >
+                //  <attnum name="cold mu factor" val="0.82"/>
+                //  <attnum name="falloff grip multiplier" val="0.88"/>
+                //  <attnum name="optimal temperature" val="353.15"/>
+                //  <attnum name="heating multiplier" val="0.00002"/>
+                //  <attnum name="air cooling multiplier" val="0.0028"/>
+            }
 
             //---------------------------------------------------------------------
 
-            fout << "\t<section name=\"Front Left Wheel\">" << std::endl;
-            fout << "\t\t<attnum name=\"ypos\" unit=\"m\" val=\"" << (frontTrack / 2) << "\"/>" << std::endl;
-            fout << "\t\t<attnum name=\"rim diameter\" unit=\"m\" val=\"" << (frontRimRadius * 2.0f) << "\"/>" << std::endl;
-            fout << "\t\t<attnum name=\"tire width\" unit=\"m\" val=\"" << tires.getValue("FRONT", "WIDTH") << "\"/>" << std::endl;
-            //  fout << "\t\t<attnum name=\"tire height\" unit=\"m\" val=\"" << (tires.getFloatValue("FRONT", "RADIUS") * 2.0f) << "\"/>" << std::endl;
-            fout << "\t\t<attnum name=\"tire height-width ratio\" val=\"" << frontTireAspectRatio << "\"/>" << std::endl;
-            fout << "\t\t<attnum name=\"inertia\" unit=\"kg.m2\" val=\"" << frontWheelTireInertia << "\"/>" << std::endl;
-            //  <attnum name = "ride height" unit = "mm" min = "100" max = "300" val = "100" / >
-            //  <attnum name = "toe" unit = "deg" min = "-5" max = "5" val = "0" / >
-            //  <attnum name = "camber" min = "-5" max = "0" unit = "deg" val = "-5" / >
-            //  <attnum name = "stiffness" val = "27.0" / >
-            //  <attnum name = "dynamic friction" unit = "%" val = "80" / >
-            //  <attnum name = "rolling resistance" val = "0.02" / >
-            //  <attnum name = "mu" min = "0.05" max = "1.6" val = "1.6" / >
-            fout << "\t</section>" << std::endl;
+            {
+                const auto section = xml.section("Front Left Wheel");
+                xml.attnum("ypos", "m", (frontTrack / 2));
+                xml.attnum("rim diameter", "m", (frontRimRadius * 2.0f));
+                xml.attnum("tire width", "m", tires.getView("FRONT", "WIDTH"));
+                //  xml.attnum("tire height", "m", (tires.getFloatValue("FRONT", "RADIUS") * 2.0f));
+                xml.attnum("tire height-width ratio", frontTireAspectRatio);
+                xml.attnum("inertia", "kg.m2", frontWheelTireInertia);
+                //  <attnum name = "ride height" unit = "mm" min = "100" max = "300" val = "100" / >
+                //  <attnum name = "toe" unit = "deg" min = "-5" max = "5" val = "0" / >
+                //  <attnum name = "camber" min = "-5" max = "0" unit = "deg" val = "-5" / >
+                //  <attnum name = "stiffness" val = "27.0" / >
+                //  <attnum name = "dynamic friction" unit = "%" val = "80" / >
+                //  <attnum name = "rolling resistance" val = "0.02" / >
+                //  <attnum name = "mu" min = "0.05" max = "1.6" val = "1.6" / >
+            }
 
             //---------------------------------------------------------------------
 
@@ -499,1302 +529,3560 @@ namespace
             float rearRimRadius = tires.getFloatValue("REAR", "RIM_RADIUS") - 0.0254f;
             float rearTireAspectRatio = (tires.getFloatValue("REAR", "RADIUS") - rearRimRadius) / tires.getFloatValue("REAR", "WIDTH");
             float rearWheelTireInertia = tires.getFloatValue("REAR", "ANGULAR_INERTIA") - rearBrakeInertia;
-            fout << "\t<section name=\"Rear Right Wheel\">" << std::endl;
-            fout << "\t\t<attnum name=\"ypos\" unit=\"m\" val=\"" << -(rearTrack / 2) << "\"/>" << std::endl;
-            fout << "\t\t<attnum name=\"rim diameter\" unit=\"m\" val=\"" << (rearRimRadius * 2.0f) << "\"/>" << std::endl;
-            fout << "\t\t<attnum name=\"tire width\" unit=\"m\" val=\"" << tires.getValue("REAR", "WIDTH") << "\"/>" << std::endl;
-            //  fout << "\t\t<attnum name=\"tire height\" unit=\"m\" val=\"" << (tires.getFloatValue("REAR", "RADIUS") * 2.0f) << "\"/>" << std::endl;
-            fout << "\t\t<attnum name=\"tire height-width ratio\" val=\"" << rearTireAspectRatio << "\"/>" << std::endl;
-            fout << "\t\t<attnum name=\"inertia\" unit=\"kg.m2\" val=\"" << rearWheelTireInertia << "\"/>" << std::endl;
-            //  <attnum name = "ride height" unit = "mm" min = "100" max = "300" val = "100" / >
-            //  <attnum name = "toe" unit = "deg" min = "-5" max = "5" val = "0" / >
-            //  <attnum name = "camber" min = "-5" max = "0" unit = "deg" val = "-5" / >
-            //  <attnum name = "stiffness" val = "27.0" / >
-            //  <attnum name = "dynamic friction" unit = "%" val = "80" / >
-            //  <attnum name = "rolling resistance" val = "0.02" / >
-            //  <attnum name = "mu" min = "0.05" max = "1.6" val = "1.6" / >
-            fout << "\t</section>" << std::endl;
+            {
+                const auto section = xml.section("Rear Right Wheel");
+                xml.attnum("ypos", "m", -(rearTrack / 2));
+                xml.attnum("rim diameter", "m", (rearRimRadius * 2.0f));
+                xml.attnum("tire width", "m", tires.getView("REAR", "WIDTH"));
+                //  xml.attnum("tire height", "m", (tires.getFloatValue("REAR", "RADIUS") * 2.0f));
+                xml.attnum("tire height-width ratio", rearTireAspectRatio);
+                xml.attnum("inertia", "kg.m2", rearWheelTireInertia);
+                //  <attnum name = "ride height" unit = "mm" min = "100" max = "300" val = "100" / >
+                //  <attnum name = "toe" unit = "deg" min = "-5" max = "5" val = "0" / >
+                //  <attnum name = "camber" min = "-5" max = "0" unit = "deg" val = "-5" / >
+                //  <attnum name = "stiffness" val = "27.0" / >
+                //  <attnum name = "dynamic friction" unit = "%" val = "80" / >
+                //  <attnum name = "rolling resistance" val = "0.02" / >
+                //  <attnum name = "mu" min = "0.05" max = "1.6" val = "1.6" / >
+            }
 
             //---------------------------------------------------------------------
 
-            fout << "\t<section name=\"Rear Left Wheel\">" << std::endl;
-            fout << "\t\t<attnum name=\"ypos\" unit=\"m\" val=\"" << (rearTrack / 2) << "\"/>" << std::endl;
-            fout << "\t\t<attnum name=\"rim diameter\" unit=\"m\" val=\"" << (rearRimRadius * 2.0f) << "\"/>" << std::endl;
-            fout << "\t\t<attnum name=\"tire width\" unit=\"m\" val=\"" << tires.getValue("REAR", "WIDTH") << "\"/>" << std::endl;
-            //  fout << "\t\t<attnum name=\"tire height\" unit=\"m\" val=\"" << (tires.getFloatValue("REAR", "RADIUS") * 2.0f) << "\"/>" << std::endl;
-            fout << "\t\t<attnum name=\"tire height-width ratio\" val=\"" << rearTireAspectRatio << "\"/>" << std::endl;
-            fout << "\t\t<attnum name=\"inertia\" unit=\"kg.m2\" val=\"" << rearWheelTireInertia << "\"/>" << std::endl;
-            //  <attnum name = "ride height" unit = "mm" min = "100" max = "300" val = "100" / >
-            //  <attnum name = "toe" unit = "deg" min = "-5" max = "5" val = "0" / >
-            //  <attnum name = "camber" min = "-5" max = "0" unit = "deg" val = "-5" / >
-            //  <attnum name = "stiffness" val = "27.0" / >
-            //  <attnum name = "dynamic friction" unit = "%" val = "80" / >
-            //  <attnum name = "rolling resistance" val = "0.02" / >
-            //  <attnum name = "mu" min = "0.05" max = "1.6" val = "1.6" / >
-            fout << "\t</section>" << std::endl;
+            {
+                const auto section = xml.section("Rear Left Wheel");
+                xml.attnum("ypos", "m", (rearTrack / 2));
+                xml.attnum("rim diameter", "m", (rearRimRadius * 2.0f));
+                xml.attnum("tire width", "m", tires.getView("REAR", "WIDTH"));
+                //  xml.attnum("tire height", "m", (tires.getFloatValue("REAR", "RADIUS") * 2.0f));
+                xml.attnum("tire height-width ratio", rearTireAspectRatio);
+                xml.attnum("inertia", "kg.m2", rearWheelTireInertia);
+                //  <attnum name = "ride height" unit = "mm" min = "100" max = "300" val = "100" / >
+                //  <attnum name = "toe" unit = "deg" min = "-5" max = "5" val = "0" / >
+                //  <attnum name = "camber" min = "-5" max = "0" unit = "deg" val = "-5" / >
+                //  <attnum name = "stiffness" val = "27.0" / >
+                //  <attnum name = "dynamic friction" unit = "%" val = "80" / >
+                //  <attnum name = "rolling resistance" val = "0.02" / >
+                //  <attnum name = "mu" min = "0.05" max = "1.6" val = "1.6" / >
+            }
         }
 
         //---------------------------------------------------------------------
 
-        fout << "\t<section name=\"Front Anti-Roll Bar\">" << std::endl;
-        if (suspensions.hasSection("ARB"))
         {
-            fout << "\t\t<attnum name=\"spring\" unit=\"N/m\" min=\""
-                 << setup.getFloatValue("ARB_FRONT", "MIN", 0.0f) << "\" max=\""
-                 << setup.getFloatValue("ARB_FRONT", "MAX", 200000.0f)  << "\" val=\""
-                 << suspensions.getValue("ARB", "FRONT") << "\"/>" << std::endl;
+            const auto section = xml.section("Front Anti-Roll Bar");
+            if (suspensions.hasSection("ARB"))
+            {
+                xml.attnum("spring", "N/m",
+                           setup.getFloatValue("ARB_FRONT", "MIN", 0.0f),
+                           setup.getFloatValue("ARB_FRONT", "MAX", 200000.0f),
+                           suspensions.getView("ARB", "FRONT"));
+            }
         }
-        fout << "\t</section>" << std::endl;
 
         //---------------------------------------------------------------------
 
-        fout << "\t<section name=\"Rear Anti-Roll Bar\">" << std::endl;
-        if (suspensions.hasSection("ARB"))
         {
-            fout << "\t\t<attnum name=\"spring\" unit=\"N/m\" min=\""
-                 << setup.getFloatValue("ARB_REAR", "MIN", 0.0f) << "\" max=\""
-                 << setup.getFloatValue("ARB_REAR", "MIN", 200000.0f) << "\" val=\""
-                 << suspensions.getValue("ARB", "REAR") << "\"/>" << std::endl;
+            const auto section = xml.section("Rear Anti-Roll Bar");
+            if (suspensions.hasSection("ARB"))
+            {
+                xml.attnum("spring", "N/m",
+                           setup.getFloatValue("ARB_REAR", "MIN", 0.0f),
+                           setup.getFloatValue("ARB_REAR", "MIN", 200000.0f),
+                           suspensions.getView("ARB", "REAR"));
+            }
         }
-        fout << "\t</section>" << std::endl;
 
         //---------------------------------------------------------------------
 
-        fout << "\t<section name=\"Front Right Suspension\">" << std::endl;
-        //	<attnum name="spring" unit="lbs/in" min="0" max="10000" val="5500"/>
-        //	<attnum name="suspension course" unit="m" min="0" max="0.25" val="0.07"/>
-        //	<attnum name="bellcrank" min="0.1" max="5" val="0.9"/>
-        //	<attnum name="packers" unit="mm" min="0" max="20" val="10"/>
-        //	<attnum name="slow bump" unit="lbs/in/s" min="0" max="1000" val="500"/>
-        //	<attnum name="slow rebound" unit="lbs/in/s" min="0" max="1000" val="300"/>
-        //	<attnum name="fast bump" unit="lbs/in/s" min="0" max="1000" val="60"/>
-        //	<attnum name="fast rebound" unit="lbs/in/s" min="0" max="1000" val="60"/>
-        fout << "\t</section>" << std::endl;
+        for (const char* name : { "Front Right Suspension", "Front Left Suspension", "Rear Right Suspension", "Rear Left Suspension" })
+        {
+            const auto section = xml.section(name);
+            //	<attnum name="spring" unit="lbs/in" min="0" max="10000" val="5500"/>
+            //	<attnum name="suspension course" unit="m" min="0" max="0.25" val="0.07"/>
+            //	<attnum name="bellcrank" min="0.1" max="5" val="0.9"/>
+            //	<attnum name="packers" unit="mm" min="0" max="20" val="10"/>
+            //	<attnum name="slow bump" unit="lbs/in/s" min="0" max="1000" val="500"/>
+            //	<attnum name="slow rebound" unit="lbs/in/s" min="0" max="1000" val="300"/>
+            //	<attnum name="fast bump" unit="lbs/in/s" min="0" max="1000" val="60"/>
+            //	<attnum name="fast rebound" unit="lbs/in/s" min="0" max="1000" val="60"/>
+        }
 
         //---------------------------------------------------------------------
 
-        fout << "\t<section name=\"Front Left Suspension\">" << std::endl;
-        //	<attnum name="spring" unit="lbs/in" min="0" max="10000" val="5500"/>
-        //	<attnum name="suspension course" unit="m" min="0" max="0.25" val="0.07"/>
-        //	<attnum name="bellcrank" min="0.1" max="5" val="0.9"/>
-        //	<attnum name="packers" unit="mm" min="0" max="20" val="10"/>
-        //	<attnum name="slow bump" unit="lbs/in/s" min="0" max="1000" val="500"/>
-        //	<attnum name="slow rebound" unit="lbs/in/s" min="0" max="1000" val="300"/>
-        //	<attnum name="fast bump" unit="lbs/in/s" min="0" max="1000" val="60"/>
-        //	<attnum name="fast rebound" unit="lbs/in/s" min="0" max="1000" val="60"/>
-        fout << "\t</section>" << std::endl;
+        const std::pair<const char*, const char*> disks[] =
+        {
+            { "Front Right Brake", "DISC_RF" }, { "Front Left Brake", "DISC_LF" }, { "Rear Right Brake", "DISC_RR" }, { "Rear Left Brake", "DISC_LR" }
+        };
 
-        //---------------------------------------------------------------------
+        for (const auto& brake : disks)
+        {
+            const auto section = xml.section(brake.first);
+            const kn5::Node* disk = model.findNode(kn5::Node::Mesh, brakes.getValue("DISCS_GRAPHICS", brake.second));
+            if (disk)
+                xml.attnum("disk diameter", "m", (disk->m_boundingSphere.m_radius * 2.0f));
+            //	<attnum name="piston area" unit="cm2" val="50"/>
+            //	<attnum name="mu" val="0.45"/>
+            xml.attnum("inertia", "kg.m2", brake.first[0] == 'F' ? frontBrakeInertia : rearBrakeInertia);
+            //  <attnum name="enable abs" min="0" max="1" val="1"/>
+        }
+    }
 
-        fout << "\t<section name=\"Rear Right Suspension\">" << std::endl;
-        //	<attnum name="spring" unit="lbs/in" min="0" max="10000" val="5500"/>
-        //	<attnum name="suspension course" unit="m" min="0" max="0.25" val="0.07"/>
-        //	<attnum name="bellcrank" min="0.1" max="5" val="0.9"/>
-        //	<attnum name="packers" unit="mm" min="0" max="20" val="10"/>
-        //	<attnum name="slow bump" unit="lbs/in/s" min="0" max="1000" val="500"/>
-        //	<attnum name="slow rebound" unit="lbs/in/s" min="0" max="1000" val="300"/>
-        //	<attnum name="fast bump" unit="lbs/in/s" min="0" max="1000" val="60"/>
-        //	<attnum name="fast rebound" unit="lbs/in/s" min="0" max="1000" val="60"/>
-        fout << "\t</section>" << std::endl;
+    void writeConfig(const std::filesystem::path& inputPath, const carconfig& config, const std::string& filename, const kn5& model, float length, float width, float height, const std::string& category, bool outputACC)
+    {
+        std::ofstream   fout(filename);
 
-        //---------------------------------------------------------------------
+        if (!fout)
+            throw std::runtime_error("Couldn't create: " + filename);
 
-        fout << "\t<section name=\"Rear Left Suspension\">" << std::endl;
-        //	<attnum name="spring" unit="lbs/in" min="0" max="10000" val="5500"/>
-        //	<attnum name="suspension course" unit="m" min="0" max="0.25" val="0.07"/>
-        //	<attnum name="bellcrank" min="0.1" max="5" val="0.9"/>
-        //	<attnum name="packers" unit="mm" min="0" max="20" val="10"/>
-        //	<attnum name="slow bump" unit="lbs/in/s" min="0" max="1000" val="500"/>
-        //	<attnum name="slow rebound" unit="lbs/in/s" min="0" max="1000" val="300"/>
-        //	<attnum name="fast bump" unit="lbs/in/s" min="0" max="1000" val="60"/>
-        //	<attnum name="fast rebound" unit="lbs/in/s" min="0" max="1000" val="60"/>
-        fout << "\t</section>" << std::endl;
+        xmlwriter   xml;
 
-        //---------------------------------------------------------------------
+        makeConfig(xml, inputPath, config, model, length, width, category, outputACC);
 
-        fout << "\t<section name=\"Front Right Brake\">" << std::endl;
-        std::string nodeName = brakes.getValue("DISCS_GRAPHICS", "DISC_RF");
-        const kn5::Node* disk = model.findNode(kn5::Node::Mesh, nodeName);
-        if (disk)
-            fout << "\t\t<attnum name=\"disk diameter\" unit=\"m\" val=\"" << (disk->m_boundingSphere.m_radius * 2.0f) << "\"/>" << std::endl;
-        //	<attnum name="piston area" unit="cm2" val="50"/>
-        //	<attnum name="mu" val="0.45"/>
-        fout << "\t\t<attnum name=\"inertia\" unit=\"kg.m2\" val=\"" << frontBrakeInertia << "\"/>" << std::endl;
-        //  <attnum name="enable abs" min="0" max="1" val="1"/>
-        fout << "\t</section>" << std::endl;
+        fout.write(xml.getBuffer().data(), xml.getBuffer().size());
 
-        //---------------------------------------------------------------------
+        fout.close();
+    }
 
-        fout << "\t<section name=\"Front Left Brake\">" << std::endl;
-        nodeName = brakes.getValue("DISCS_GRAPHICS", "DISC_LF");
-        disk = model.findNode(kn5::Node::Mesh, nodeName);
-        if (disk)
-            fout << "\t\t<attnum name=\"disk diameter\" unit=\"m\" val=\"" << (disk->m_boundingSphere.m_radius * 2.0f) << "\"/>" << std::endl;
-        //	<attnum name="piston area" unit="cm2" val="50"/>
-        //	<attnum name="mu" val="0.45"/>
-        fout << "\t\t<attnum name=\"inertia\" unit=\"kg.m2\" val=\"" << frontBrakeInertia << "\"/>" << std::endl;
-        //  <attnum name="enable abs" min="0" max="1" val="1"/>
-        fout << "\t</section>" << std::endl;
+    std::string getTextureName(const kn5::Material& material, bool useDiffuse)
+    {
+        const kn5::TextureMapping* txDiffuse = material.findTextureMapping("txDiffuse");
 
-        //---------------------------------------------------------------------
+        if (useDiffuse)
+            return txDiffuse->m_textureName;
 
-        fout << "\t<section name=\"Rear Right Brake\">" << std::endl;
-        nodeName = brakes.getValue("DISCS_GRAPHICS", "DISC_RR");
-        disk = model.findNode(kn5::Node::Mesh, nodeName);
-        if (disk)
-            fout << "\t\t<attnum name=\"disk diameter\" unit=\"m\" val=\"" << (disk->m_boundingSphere.m_radius * 2.0f) << "\"/>" << std::endl;
-        //	<attnum name="piston area" unit="cm2" val="50"/>
-        //	<attnum name="mu" val="0.45"/>
-        fout << "\t\t<attnum name=\"inertia\" unit=\"kg.m2\" val=\"" << rearBrakeInertia << "\"/>" << std::endl;
-        //  <attnum name="enable abs" min="0" max="1" val="1"/>
-        fout << "\t</section>" << std::endl;
+        const kn5::ShaderProperty* useDetail = material.findShaderProperty("useDetail");
+        const kn5::TextureMapping* txDetail = material.findTextureMapping("txDetail");
 
-        //---------------------------------------------------------------------
+        return ((useDetail && useDetail->m_value != 0.0f) && txDetail) ? txDetail->m_textureName : txDiffuse->m_textureName;
+    }
 
-        fout << "\t<section name=\"Rear Left Brake\">" << std::endl;
-        nodeName = brakes.getValue("DISCS_GRAPHICS", "DISC_LR");
-        disk = model.findNode(kn5::Node::Mesh, nodeName);
-        if (disk)
-            fout << "\t\t<attnum name=\"disk diameter\" unit=\"m\" val=\"" << (disk->m_boundingSphere.m_radius * 2.0f) << "\"/>" << std::endl;
-        //	<attnum name="piston area" unit="cm2" val="50"/>
-        //	<attnum name="mu" val="0.45"/>
-        fout << "\t\t<attnum name=\"inertia\" unit=\"kg.m2\" val=\"" << rearBrakeInertia << "\"/>" << std::endl;
-        //  <attnum name="enable abs" min="0" max="1" val="1"/>
-        fout << "\t</section>" << std::endl;
+    std::string getOutputTextureName(const std::string& texture, bool convertToPNG)
+    {
+        if (convertToPNG && (texture.find(".png") == std::string::npos && texture.find(".PNG") == std::string::npos))
+        {
+            size_t extension = texture.find(".dds");
 
-        //---------------------------------------------------------------------
+            if (extension != std::string::npos)
+                return texture.substr(0, extension) + ".png";
 
-        fout << "</params>" << std::endl;
+            if ((extension = texture.find(".DDS")) != std::string::npos)
+                return texture.substr(0, extension) + ".png";
+        }
 
-        fout.close();
+        return texture;
     }
 
-    void writeTextureFiles(const kn5 &model, const std::string& directory, bool convertToPNG, bool deleteDDS)
+    // the main textures of opaque materials, their alpha channel holds other data
+    std::set<std::string> getOpaqueTextures(const kn5& model)
     {
-        if (!std::filesystem::exists(directory))
-        {
-            if (!std::filesystem::create_directory(directory))
-                throw std::runtime_error("Couldn't create directory: " + directory);
-        }
+        std::set<std::string> textures;
 
-        std::set<std::string>   filesToDelete;
-
-        for (size_t i = 0; i < model.m_textures.size(); i++)
+        for (const auto& material : model.m_materials)
         {
-            std::filesystem::path texturePath(directory);
-
-            texturePath.append(model.m_textures[i].m_name);
+            if (!material.m_textureMappings.empty() && material.m_alphaBlendMode == kn5::Material::Opaque)
+                textures.insert(material.m_textureMappings[0].m_textureName);
+        }
 
-            std::string texturePathString = texturePath.string();
+        return textures;
+    }
 
-            if (!std::filesystem::exists(texturePath))
-            {
-                std::ofstream   fout(texturePath.string(), std::ios::binary);
+    // the textures the meshes of a node are written with
+    void getUsedTextures(const kn5& model, const kn5::Node& node, bool useDiffuse, std::set<std::string>& textures)
+    {
+        if (node.m_type == kn5::Node::Mesh || node.m_type == kn5::Node::SkinnedMesh)
+            textures.insert(getTextureName(model.m_materials[node.m_materialID], useDiffuse));
 
-                if (!fout)
-                    throw std::runtime_error("Couldn't create texture: " + texturePathString);
+        for (const auto& child : node.m_children)
+            getUsedTextures(model, child, useDiffuse, textures);
+    }
 
-                fout.write(model.m_textures[i].m_data.data(), model.m_textures[i].m_data.size());
+    // the magick option limiting the size of the png, maxSize 0 keeps the size
+    std::string getResize(uint32_t maxSize)
+    {
+        if (maxSize == 0)
+            return "";
 
-                fout.close();
-            }
+        return " -resize \"" + std::to_string(maxSize) + "x" + std::to_string(maxSize) + ">\"";
+    }
 
-            if (convertToPNG && (texturePathString.find(".png") == std::string::npos && texturePathString.find(".PNG") == std::string::npos))
-            {
-                std::string png;
+    // a dds texture multiplied with the texture it is baked into
+    struct TextureLayer
+    {
+        const char* m_data;
+        size_t      m_size;
+        float       m_uvMultiplier;
+    };
 
-                size_t extension = texturePathString.find(".dds");
+    // images larger than maxSize use the largest mip level that fits or are halved until they fit
+    dds::Image decodeTexture(const dds& texture, uint32_t maxSize)
+    {
+        dds::Image  image = texture.decode(maxSize != 0 ? texture.getLevel(maxSize) : 0);
 
-                if (extension != std::string::npos)
-                    png = texturePathString.substr(0, extension) + ".png";
-                else if ((extension = texturePathString.find(".DDS")) != std::string::npos)
-                    png = texturePathString.substr(0, extension) + ".png";
+        while (maxSize != 0 && std::max(image.m_width, image.m_height) > maxSize)
+            image = dds::downscale(image);
 
-                if (!png.empty() && !std::filesystem::exists(png))
-                {
-                    if (deleteDDS)
-                        filesToDelete.insert(texturePathString);
+        return image;
+    }
 
-                    quote(texturePathString);
+    // the size decodeTexture returns
+    std::pair<uint32_t, uint32_t> getTextureSize(const dds& texture, uint32_t maxSize)
+    {
+        const uint32_t  level = maxSize != 0 ? texture.getLevel(maxSize) : 0;
+        uint32_t        width = texture.getWidth(level);
+        uint32_t        height = texture.getHeight(level);
 
-                    std::string command("magick convert " + texturePathString + " ");
+        while (maxSize != 0 && std::max(width, height) > maxSize)
+        {
+            width = std::max((width + 1) / 2, 1u);
+            height = std::max((height + 1) / 2, 1u);
+        }
 
-                    for (const auto& material : model.m_materials)
-                    {
-                        if (material.m_textureMappings[0].m_textureName == model.m_textures[i].m_name)
-                        {
-                            if (material.m_alphaBlendMode == kn5::Material::Opaque)
-                            {
-                                command += "-alpha off ";
-
-                                break;
-                            }
-                        }
-                    }
+        return { width, height };
+    }
 
-                    quote(png);
+    // decodes a dds image in memory and writes it as a png, throws when the format isn't supported
+    // the png has no alpha channel when alpha is false or every pixel is opaque
+    void convertTexture(const void* data, size_t size, const std::vector<TextureLayer>& layers, const std::string& pngFileName, bool alpha, const png::Options& options, uint32_t maxSize)
+    {
+        const dds         texture(data, size);
+        dds::Image        image = decodeTexture(texture, maxSize);
 
-                    command += png;
+        for (const auto& layer : layers)
+        {
+            const dds layerTexture(layer.m_data, layer.m_size);
 
-                    if (system(command.c_str()) != 0)
-                        std::cerr << "failed to convert " << texturePathString << " to " << png << std::endl;
-                }
-            }
+            bake::multiply(image, layerTexture.decode(), layer.m_uvMultiplier, *options.m_jobs);
         }
 
-        for (const auto& file : filesToDelete)
-            std::filesystem::remove(file);
+        png::write(pngFileName, image.m_width, image.m_height, image.m_pixels.data(), alpha, options);
     }
 
-    void writeAc3dMaterials(const kn5& model, std::ostream& fout, const kn5::Node& node, const std::set<int>& usedMaterialIDs)
+    // a texture copied into an atlas with its top left corner at x, y
+    struct AtlasTile
     {
-        for (auto materialID : usedMaterialIDs)
-        {
-            const kn5::Material& material = model.m_materials[materialID];
+        const char* m_data;
+        size_t      m_size;
+        uint32_t    m_x;
+        uint32_t    m_y;
+    };
 
-            std::string materialName = material.m_name;
+    // the space around the textures of an atlas, filled with their edge pixels so they don't bleed into each other
+    constexpr uint32_t atlasPadding = 2;
 
-            for (size_t i = 0; i < materialName.size(); i++)
-            {
-                if (materialName[i] == ' ')
-                    materialName[i] = '_';
-            }
+    void writeAtlas(uint32_t width, uint32_t height, const std::vector<AtlasTile>& tiles, const std::string& pngFileName, bool alpha, const png::Options& options, uint32_t maxSize)
+    {
+        std::vector<uint8_t>    pixels(static_cast<size_t>(width) * height * 4, 0);
 
-            fout << "MATERIAL " << "\"" << materialName << "\"";
+        for (const auto& tile : tiles)
+        {
+            const dds           texture(tile.m_data, tile.m_size);
+            const dds::Image    image = decodeTexture(texture, maxSize);
 
-            const kn5::ShaderProperty* property = material.findShaderProperty("ksDiffuse");
+            if (tile.m_x < atlasPadding || tile.m_y < atlasPadding || tile.m_x + image.m_width + atlasPadding > width || tile.m_y + image.m_height + atlasPadding > height)
+                throw std::runtime_error("Texture doesn't fit in atlas");
 
-            if (property != nullptr)
+            for (uint32_t y = 0; y < image.m_height + atlasPadding * 2; y++)
             {
-                const float rgb = std::clamp(property->m_value, 0.0f, 1.0f);
-                fout << " rgb " << rgb << " " << rgb << " " << rgb;
-            }
-            else
-                fout << " rgb 1 1 1";
+                const uint32_t  sourceY = std::min(y > atlasPadding ? y - atlasPadding : 0, image.m_height - 1);
+                const uint8_t*  source = image.m_pixels.data() + static_cast<size_t>(sourceY) * image.m_width * 4;
+                uint8_t*        row = pixels.data() + (static_cast<size_t>(tile.m_y - atlasPadding + y) * width + tile.m_x - atlasPadding) * 4;
 
-            property = material.findShaderProperty("ksAmbient");
+                for (uint32_t x = 0; x < atlasPadding; x++)
+                {
+                    std::memcpy(row + x * 4, source, 4);
+                    std::memcpy(row + (atlasPadding + image.m_width + x) * 4, source + (image.m_width - 1) * 4, 4);
+                }
 
-            if (property != nullptr)
-            {
-                const float amb = std::clamp(property->m_value, 0.0f, 1.0f);
-                fout << "  amb " << amb << " " << amb << " " << amb;
+                std::memcpy(row + atlasPadding * 4, source, static_cast<size_t>(image.m_width) * 4);
             }
-            else
-                fout << "  amb 1 1 1";
+        }
 
-            property = material.findShaderProperty("ksEmissive");
+        png::write(pngFileName, width, height, pixels.data(), alpha, options);
+    }
 
-            if (property != nullptr)
-            {
-                const float emis = std::clamp(property->m_value, 0.0f, 1.0f);
-                fout << "  emis " << emis << " " << emis << " " << emis;
-            }
-            else
-                fout << "  emis 1 1 1";
+    // fallback for images that can't be converted in memory
+    bool convertTexture(std::string fileName, std::string pngFileName, bool alpha, uint32_t maxSize)
+    {
+        quote(fileName);
+        quote(pngFileName);
 
-            property = material.findShaderProperty("ksSpecular");
+        const std::string command("magick convert " + fileName + (alpha ? "" : " -alpha off") + getResize(maxSize) + " " + pngFileName);
 
-            if (property != nullptr)
-            {
-                const float spec = std::clamp(property->m_value, 0.0f, 1.0f);
-                fout << "  spec " << spec << " " << spec << " " << spec;
-            }
-            else
-                fout << "  spec 1 1 1";
+        return system(command.c_str()) == 0;
+    }
 
-            property = material.findShaderProperty("ksSpecularEXP");  // FIXME is this the right parameter?
+    // fallback for textures in memory, the dds is piped to the converter instead of written to a file
+    bool convertTexture(const void* data, size_t size, std::string pngFileName, bool alpha, uint32_t maxSize)
+    {
+        quote(pngFileName);
 
-            if (property != nullptr)
-            {
-                // FIXME should this be scaled?
-                const float shi = std::clamp(property->m_value, 0.0f, 128.0f);
-                fout << "  shi " << static_cast<int>(shi);
-            }
-            else
-                fout << "  shi 0";
+        const std::string command("magick convert dds:-" + std::string(alpha ? "" : " -alpha off") + getResize(maxSize) + " " + pngFileName);
 
-            property = material.findShaderProperty("ksAlphaRef");  // FIXME is this the right parameter?
+#ifdef _WIN32
+        FILE* pipe = _popen(command.c_str(), "wb");
+#else
+        FILE* pipe = popen(command.c_str(), "w");
+#endif
 
-            if (property != nullptr)
-            {
-                const float trans = std::clamp(property->m_value, 0.0f, 1.0f);
-                fout << "  trans " << trans;
-            }
-            else
-                fout << "  trans 0";
+        if (pipe == nullptr)
+            return false;
 
-            fout << std::endl;
-        }
+        const bool written = fwrite(data, 1, size, pipe) == size;
+
+#ifdef _WIN32
+        return _pclose(pipe) == 0 && written;
+#else
+        return pclose(pipe) == 0 && written;
+#endif
     }
 
-    int getNewMaterialID(int materialID, const std::set<int>& usedMaterialIDs)
+    void writeTextureFile(const void* data, size_t size, const std::string& fileName)
     {
-        int newMaterialID = 0;
+        if (std::filesystem::exists(fileName))
+            return;
 
-        for (auto id : usedMaterialIDs)
-        {
-            if (id == materialID)
-                return newMaterialID;
+        std::ofstream   fout(fileName, std::ios::binary);
 
-            newMaterialID++;
-        }
-        return 0;
+        if (!fout)
+            throw std::runtime_error("Couldn't create texture: " + fileName);
+
+        fout.write(static_cast<const char*>(data), size);
+
+        fout.close();
     }
 
-    void writeAc3dObject(const kn5& model, std::ostream& fout, const kn5::Node& node, const std::set<int>& usedMaterialIDs, bool convertToPNG, bool outputACC, bool useDiffuse)
+    // The files converted the same way for several cars, the first car converts the file and the others link to it.
+    // A file that couldn't be converted is tried again by the next car asking for it.
+    // A conversion must not wait for jobs of the shared pool, the waiting thread can run the job of another car
+    // asking for the same file and wait for itself.
+    class convertedFiles
     {
-        if (node.m_type == kn5::Node::Transform)
+        struct File
         {
-            fout << "OBJECT group" << std::endl;
-            fout << "name \"" << node.m_name << "\"" << std::endl;
+            std::once_flag  m_converted;
+            std::string     m_fileName;
+        };
 
-            if (node.m_matrix.isRotation())
-            {
-                fout << "rot " << node.m_matrix.m_data[0][0] << " " << node.m_matrix.m_data[0][1] << " " << node.m_matrix.m_data[0][2];
-                fout << " " << node.m_matrix.m_data[1][0] << " " << node.m_matrix.m_data[1][1] << " " << node.m_matrix.m_data[1][2];
-                fout << " " << node.m_matrix.m_data[2][0] << " " << node.m_matrix.m_data[2][1] << " " << node.m_matrix.m_data[2][2] << std::endl;
-            }
+        std::mutex                                      m_mutex;
+        std::map<std::string, std::unique_ptr<File>>    m_files;
 
-            if (node.m_matrix.isTranslation())
-                fout << "loc " << node.m_matrix.m_data[3][0] << " " << node.m_matrix.m_data[3][1] << " " << node.m_matrix.m_data[3][2] << std::endl;
-        }
-        else if (node.m_type == kn5::Node::Mesh || node.m_type == kn5::Node::SkinnedMesh)
+    public:
+        // the key describes the content of the file and how it is converted
+        void get(const std::string& key, const std::string& fileName, const std::function<void()>& convert)
         {
-            fout << "OBJECT poly" << std::endl;
-            fout << "name \"" << node.m_name << "\"" << std::endl;
-
-            std::string texture;
-            const kn5::TextureMapping* txDiffuse = model.m_materials[node.m_materialID].findTextureMapping("txDiffuse");
+            File* file;
 
-            if (useDiffuse)
-                texture = txDiffuse->m_textureName;
-            else
             {
-                const kn5::ShaderProperty* useDetail = model.m_materials[node.m_materialID].findShaderProperty("useDetail");
-                const kn5::TextureMapping* txDetail = model.m_materials[node.m_materialID].findTextureMapping("txDetail");
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                std::unique_ptr<File>& entry = m_files[key];
 
-                texture = ((useDetail && useDetail->m_value != 0.0f) && txDetail) ? txDetail->m_textureName : txDiffuse->m_textureName;
+                if (!entry)
+                    entry = std::make_unique<File>();
+
+                file = entry.get();
             }
 
-            if (convertToPNG && (texture.find(".png") == std::string::npos && texture.find(".PNG") == std::string::npos))
+            bool converted = false;
+
+            std::call_once(file->m_converted, [&]()
             {
-                const std::string png = texture;
+                // the old file may be linked to the file of another car
+                std::filesystem::remove(fileName);
 
-                size_t extension = texture.find(".dds");
+                convert();
 
-                if (extension != std::string::npos)
-                    texture = texture.substr(0, extension) + ".png";
-                else if ((extension = png.find(".DDS")) != std::string::npos)
-                    texture = texture.substr(0, extension) + ".png";
-            }
+                file->m_fileName = fileName;
+                converted = true;
+            });
 
-            if (outputACC)
-            {
-                fout << "texture \"" << texture << "\" base" << std::endl;
-                fout << "texture empty_texture_no_mapping tiled" << std::endl;
-                fout << "texture empty_texture_no_mapping skids" << std::endl;
-                fout << "texture empty_texture_no_mapping shad" << std::endl;
-            }
-            else
-                fout << "texture \"" << texture << "\"" << std::endl;
+            if (!converted && file->m_fileName != fileName && !assetstore::link(file->m_fileName, fileName))
+                throw std::runtime_error("Couldn't link " + file->m_fileName + " to " + fileName);
+        }
+    };
 
-            fout << "numvert " << node.m_vertices.size() << std::endl;
+    // Writes and converts the textures and skins on a pool of worker threads.
+    // Identical textures are only converted once.
+    // The models must not change until wait is called.
+    class textureWriter
+    {
+        struct Output
+        {
+            std::string     m_name;
+            std::string     m_path;
+            std::string     m_fileName;
+            std::string     m_storeKey;
+            const char*     m_data;
+            size_t          m_size;
+            bool            m_alpha;
+            bool            m_keepName;
+            bool            m_queued;
+            std::vector<TextureLayer>   m_layers;
+            std::vector<AtlasTile>      m_tiles;
+            uint32_t                    m_width = 0;
+            uint32_t                    m_height = 0;
+        };
+
+        struct Link
+        {
+            std::string m_name;
+            std::string m_source;
+            std::string m_sourceFileName;
+            std::string m_fileName;
+            std::string m_storeKey;
+            bool        m_used;
+        };
+
+        using Key = std::pair<contenthash, bool>;
+
+        jobs                    m_jobs;
+        bool                    m_convertToPNG;
+        bool                    m_deleteDDS;
+        png::Options            m_options;
+        uint32_t                m_maxSize = 0;
+        bool                    m_bake = false;
+        const assetstore*       m_store = nullptr;
+        convertedFiles*         m_files = nullptr;
+        manifest*               m_manifest = nullptr;
+        std::set<std::string>   m_prepared;
+        std::map<Key, Output>   m_outputs;
+        std::map<std::string, std::string>  m_renamed;
+        std::set<std::string>   m_keepNames;
+        std::vector<Link>       m_links;
+        size_t                  m_failures = 0;
+
+        void convert(const void* data, size_t size, const std::vector<TextureLayer>& layers, const std::string& pngFileName, bool alpha, const png::Options& options)
+        {
+            std::string reason;
 
-            for (const auto& vertex : node.m_vertices)
+            try
             {
-                fout << vertex.m_position[0] << " " << vertex.m_position[1] << " " << vertex.m_position[2];
-
-                if (outputACC)
-                    fout << " " << vertex.m_normal[0] << " " << vertex.m_normal[1] << " " << vertex.m_normal[2];
+                convertTexture(data, size, layers, pngFileName, alpha, options, m_maxSize);
 
-                fout << std::endl;
+                return;
             }
-
-            float uvMult = 1.0f;
-
-            if (useDiffuse)
+            catch (std::runtime_error& e)
             {
-                const kn5::ShaderProperty* property = model.m_materials[node.m_materialID].findShaderProperty("diffuseMult");
-
-                if (property != nullptr)
-                    uvMult = property->m_value;
+                reason = e.what();
             }
-            else
-            {
-                const kn5::ShaderProperty* property = model.m_materials[node.m_materialID].findShaderProperty("useDetail");
 
-                if (property == nullptr || property->m_value == 0.0f)
-                {
-                    property = model.m_materials[node.m_materialID].findShaderProperty("diffuseMult");
+            // the external converter reads the texture from a pipe, it can't bake layers
+            if (!layers.empty() || !convertTexture(data, size, pngFileName, alpha, m_maxSize))
+                throw std::runtime_error(reason);
+        }
 
-                    if (property != nullptr)
-                        uvMult = property->m_value;
-                }
-                else
-                {
-                    property = model.m_materials[node.m_materialID].findShaderProperty("detailUVMultiplier");
+        // the conversion settings are part of the key
+        std::string getStoreKey(const std::string& hash, bool alpha) const
+        {
+            static const char* const levels[] = { "fast", "default", "small" };
 
-                    if (property != nullptr)
-                        uvMult = 1 / property->m_value;
-                }
-            }
+            const std::string size = m_maxSize != 0 ? "-" + std::to_string(m_maxSize) : "";
 
-            struct Surface
-            {
-                int m_materialID = 0;
+            return hash + (alpha ? "-rgba-" : "-rgb-") + levels[m_options.m_level] + size + ".png";
+        }
 
-                struct Ref
-                {
-                    int          m_index = 0;
-                    kn5::Vec3    m_vertex = { 0, 0, 0 };
-                    kn5::Vec2    m_uv = { 0, 0 };
-                };
+        std::string getStoreKey(const contenthash& hash, bool alpha) const
+        {
+            return getStoreKey(hash.to_string(), alpha);
+        }
 
-                std::array<Ref, 3>  m_refs;
+        // without a manifest a texture that exists is kept
+        bool isCurrent(const std::string& fileName, const std::string& key) const
+        {
+            if (m_manifest)
+                return m_manifest->isCurrentOutput(fileName, key);
 
-                bool collinearVertices() const
-                {
-                    constexpr float epsilon = std::numeric_limits<float>::epsilon();
-                    kn5::Vec3 v = kn5::Vec3{ m_refs[1].m_vertex - m_refs[0].m_vertex }.cross(m_refs[2].m_vertex - m_refs[0].m_vertex);
-                    return std::fabs(v[0]) < epsilon &&
-                        std::fabs(v[1]) < epsilon &&
-                        std::fabs(v[2]) < epsilon;
-                }
-            };
+            return std::filesystem::exists(fileName);
+        }
 
-            std::list<Surface>  surfaces;
+        void addOutput(const std::string& target, const std::string& fileName, const std::string& key)
+        {
+            if (m_manifest)
+                m_manifest->addOutput(target, fileName, key);
+        }
 
-            for (size_t i = 0; i < node.m_indices.size(); i += 3)
+        // converts once for every car sharing the converted files
+        void convert(const Output& output)
+        {
+            if (m_files)
             {
-                Surface surface;
-
-                surface.m_materialID = getNewMaterialID(node.m_materialID, usedMaterialIDs);
-
-                for (size_t j = 0; j < 3; j++)
-                {
-                    const int index = node.m_indices[i + j];
-
-                    surface.m_refs[j].m_index = index;
-
-                    surface.m_refs[j].m_vertex = node.m_vertices[index].m_position;
-                    surface.m_refs[j].m_uv[0] = node.m_vertices[index].m_texture[0] * uvMult;
-                    surface.m_refs[j].m_uv[1] = -node.m_vertices[index].m_texture[1] * uvMult;
-                }
-
-                if (surface.collinearVertices())
+                // on this thread only, see convertedFiles
+                m_files->get(output.m_storeKey, output.m_fileName, [this, &output]()
                 {
-                    //std::cerr << "found collinear vertices" << std::endl;
-                    continue;
-                }
+                    jobs            single(1);
+                    png::Options    options = m_options;
 
-                surfaces.push_back(surface);
-            }
+                    options.m_jobs = &single;
 
-            fout << "numsurf " << surfaces.size() << std::endl;
-            for (const auto& surface : surfaces)
-            {
-                fout << "SURF 0x10" << std::endl;
-                fout << "mat " << surface.m_materialID << std::endl;
-                fout << "refs 3" << std::endl;
-                for (const auto& ref : surface.m_refs)
-                    fout << ref.m_index << " " << ref.m_uv[0] << " " << ref.m_uv[1] << std::endl;
+                    store(output, options);
+                });
             }
+            else
+                store(output, m_options);
         }
-        else
-            return;
-
-        fout << "kids " << node.m_children.size() << std::endl;
-
-        for (const auto& child : node.m_children)
-            writeAc3dObject(model, fout, child, usedMaterialIDs, convertToPNG, outputACC, useDiffuse);
-    }
-
-    void getUsedMaterials(const kn5::Node& node, std::set<int>& usedMaterialIDs)
-    {
-        if (node.m_type != kn5::Node::Transform)
-            usedMaterialIDs.insert(node.m_materialID);
 
-        for (const auto& child : node.m_children)
-            getUsedMaterials(child, usedMaterialIDs);
-    }
-
-    void writeAc3d(const kn5& model, const std::string& file, const kn5::Node& node, bool convertToPNG, bool outputACC, bool useDiffuse)
-    {
-        std::set<int>   usedMaterialIDs;
-
-        getUsedMaterials(node, usedMaterialIDs);
-
-        std::ofstream fout(file);
-
-        if (fout)
+        // converts with the asset store when there is one
+        void store(const Output& output, const png::Options& options)
         {
-            fout << "AC3Db" << std::endl;
-
-            writeAc3dMaterials(model, fout, node, usedMaterialIDs);
-
-            fout << "OBJECT world" << std::endl;
-            fout << "kids 1" << std::endl;
+            if (m_store && m_store->materialize(output.m_storeKey, output.m_fileName))
+                return;
 
-            writeAc3dObject(model, fout, node, usedMaterialIDs, convertToPNG, outputACC, useDiffuse);
+            if (!output.m_tiles.empty())
+                writeAtlas(output.m_width, output.m_height, output.m_tiles, output.m_fileName, output.m_alpha, options, m_maxSize);
+            else
+                convert(output.m_data, output.m_size, output.m_layers, output.m_fileName, output.m_alpha, options);
 
-            fout.close();
+            if (m_store)
+                m_store->insert(output.m_storeKey, output.m_fileName);
         }
-    }
-
-    void writeAc3d(const kn5& model, const std::string& file, bool convertToPNG, bool outputACC, bool useDiffuse)
-    {
-        writeAc3d(model, file, model.m_node, convertToPNG, outputACC, useDiffuse);
-    }
-
-    bool extract(kn5& model, const std::string& name, const kn5::Matrix& xform, const std::string& file)
-    {
-        kn5::Node* transformNode = model.findNode(kn5::Node::Transform, name);
-
-        if (transformNode == nullptr)
-            return false;
-
-        kn5::Node   node = *transformNode;
 
-        node.m_matrix.makeIdentity();
+        void queue(const Output& output)
+        {
+            m_jobs.add(output.m_path + " to " + output.m_fileName, [this, output]()
+            {
+                // the dds is only written when it is kept, otherwise it is converted from memory
+                // baked textures and atlases only exist as png
+                const bool  original = output.m_layers.empty() && output.m_tiles.empty();
 
-        node.removeInactiveNodes();
-        node.transform(xform);
+                if (original && (output.m_fileName == output.m_path || !m_deleteDDS))
+                {
+                    // the old file may be linked to the file of another car
+                    if (m_manifest && !m_manifest->isCurrentOutput(output.m_path, output.m_storeKey))
+                        std::filesystem::remove(output.m_path);
 
-        writeAc3d(model, file, node, true, file.find(".acc") != std::string::npos, true);
+                    writeTextureFile(output.m_data, output.m_size, output.m_path);
+                    addOutput("textures", output.m_path, output.m_storeKey);
+                }
 
-        if (transformNode->m_parent)
-            transformNode->m_parent->removeChild(transformNode);
+                if (original && output.m_fileName == output.m_path)
+                    return;
 
-        return true;
-    }
+                if (!isCurrent(output.m_fileName, output.m_storeKey))
+                {
+                    std::filesystem::remove(output.m_fileName);
 
-    void usage()
-    {
-        std::cout << "Usage: kn5toac -c category -i input_directory [-o output_directory] [-n kn5_filename] [-s skin_filename] [-d]" << std::endl;
-        std::cout << " -c category           Speed Dreams category to add this car to." << std::endl;
-        std::cout << " -i input_directory    Assetto Corsa car directory of car to convert." << std::endl;
-        std::cout << " -o output_directory   Speed Dreams directory where converted car will be installed." << std::endl;
-        std::cout << " -n kn5_filename       Assetto Corsa car model to convert if different form directory name." << std::endl;
-        std::cout << " -s skin_filename      Assetto Corsa skin texture file name" << std::endl;
-        std::cout << " -d                    Dumps kn5 files and doesn't delete dds textures and data directory." << std::endl;
-    }
-}
+                    convert(output);
+                }
 
-int main(int argc, char* argv[])
-{
-    bool        writeModel = false;
-    bool        dumpModel = false;
-    bool        writeTextures = false;
-    bool        convertToPNG = false;
-    bool        deleteDDS = true;
-    bool        outputACC = false;
-    bool        useDiffuse = false;
-    bool        extractCarParts = false;
-    bool        writeCarConfig = false;
-    bool        dumpCollider = false;
-    bool        writeCmake = false;
-    bool        deleteData = true;
-    bool        writeSkins = false;
-    bool        writeDriver = false;
-    bool        dumpInputDriver = false;
-    bool        dumpDriverKnh = false;
-    bool        cockpitLR = true;
-    bool        dumpModelHierarchy = true;
-    std::string category;
-    std::string inputDirectory;
-    std::string outputDirectory;
-    std::string inputFileName;
-    std::string skinFileName;
-    std::string driverDirectory;
+                addOutput("textures", output.m_fileName, output.m_storeKey);
+            });
+        }
 
-    for (int i = 1; i < argc; i++)
-    {
-        std::string arg(argv[i]);
-        if (arg == "-c")
+    public:
+        // the textures are converted on the threads of pool
+        textureWriter(bool convertToPNG, bool deleteDDS, jobs& pool, deflate::Level level) :
+            m_jobs(pool), m_convertToPNG(convertToPNG), m_deleteDDS(deleteDDS)
         {
-            if (i < argc)
-            {
-                i++;
-                category = argv[i];
-            }
-            else
-            {
-                usage();
-                return EXIT_FAILURE;
-            }
+            // big images are also filtered and compressed on the threads of pool
+            m_options.m_level = level;
+            m_options.m_jobs = &m_jobs;
         }
-        else if (arg == "-d")
+
+        ~textureWriter()
         {
-            dumpModel = true;
-            dumpCollider = true;
-            deleteData = false;
-            deleteDDS = false;
-            dumpInputDriver = true;
-            dumpDriverKnh = true;
+            wait();
         }
-        else if (arg == "-h")
+
+        void setStore(const assetstore* store)
         {
-            usage();
-            return EXIT_SUCCESS;
+            m_store = store;
         }
-        else if (arg == "-i")
+
+        // the textures other cars convert the same way are linked instead of converted again
+        void setConvertedFiles(convertedFiles* files)
         {
-            if (i < argc)
-            {
-                i++;
-                inputDirectory = argv[i];
-            }
-            else
-            {
-                usage();
-                return EXIT_FAILURE;
-            }
+            m_files = files;
         }
-        else if (arg == "-n")
+
+        // the textures and skins that are up to date in the manifest aren't converted again,
+        // the others are added to it as the textures and skins targets
+        void setManifest(manifest* built)
         {
-            if (i < argc)
-            {
-                i++;
-                inputFileName = argv[i];
-            }
-            else
-            {
-                usage();
-                return EXIT_FAILURE;
-            }
+            m_manifest = built;
         }
-        else if (arg == "-o")
+
+        // textures and skins larger than maxSize are made smaller, 0 keeps their size
+        void setMaxSize(uint32_t maxSize)
         {
-            if (i < argc)
-            {
-                i++;
-                outputDirectory = argv[i];
-                writeTextures = true;
-                convertToPNG = true;
-                writeModel = true;
-                extractCarParts = true;
-                writeCarConfig = true;
-                useDiffuse = true;
-                writeCmake = true;
-                writeDriver = true;
-            }
-            else
-            {
-                usage();
-                return EXIT_FAILURE;
-            }
+            m_maxSize = maxSize;
         }
-        else if (arg == "-s")
+
+        bool keepsName(const std::string& textureName) const
         {
-            if (i < argc)
-            {
-                i++;
-                skinFileName = argv[i];
-                writeSkins = true;
-            }
-            else
-            {
-                usage();
-                return EXIT_FAILURE;
-            }
+            return m_keepNames.count(textureName) != 0;
         }
-        else
+
+        // an atlas of textures that is written like a texture, returns the name of the atlas
+        std::string addAtlas(const std::string& directory, uint32_t width, uint32_t height, bool alpha, const std::vector<AtlasTile>& tiles)
         {
-            std::cerr << "Unknown option: " << arg << std::endl;
-            usage();
-            return EXIT_FAILURE;
-        }
-    }
+            std::string description = std::to_string(width) + "x" + std::to_string(height);
 
-    std::filesystem::path   inputPath(inputDirectory);
-    std::filesystem::path   outputPath(outputDirectory);
+            for (const auto& tile : tiles)
+                description += " " + contenthash(tile.m_data, tile.m_size).to_string() + " " + std::to_string(tile.m_x) + " " + std::to_string(tile.m_y);
 
-    const std::string       inputFileDirectoryName(inputPath.filename().string());
+            const Key   key(contenthash(description.data(), description.size()), alpha);
+            const auto  output = m_outputs.find(key);
 
-    outputPath.append(inputFileDirectoryName);
+            if (output != m_outputs.end())
+                return output->second.m_name;
 
-    // create the output directory if it doesn't exixt
-    if (!std::filesystem::exists(outputPath))
-    {
-        if (!std::filesystem::create_directory(outputPath))
-        {
-            std::cerr << "Couldn't create: " << outputPath.string() << std::endl;
-            return EXIT_FAILURE;
-        }
-    }
+            const std::string name = "atlas_" + key.first.to_string().substr(0, 8) + ".png";
+            std::filesystem::path path(directory);
 
-    // use the data directory in the input directory if it exists
-    std::filesystem::path   dataDirectoryPath = inputPath;
+            path.append(name);
 
-    dataDirectoryPath.append("data");
+            m_outputs.emplace(key, Output{ name, path.string(), path.string(), getStoreKey(key.first, alpha), nullptr, 0, alpha, false, false, {}, tiles, width, height });
 
-    if (!std::filesystem::exists(dataDirectoryPath))
-    {
-        // otherwise use the data.acd file
-        std::filesystem::path acdPath = inputPath;
+            return name;
+        }
+
+        // materials using a detail texture get a diffuse texture with the detail baked in
+        void setBake(bool bake)
+        {
+            m_bake = bake;
+        }
 
-        acdPath.append("data.acd");
+        // textures that can't be renamed get a link to an identical texture instead
+        void keepName(const std::string& textureName)
+        {
+            m_keepNames.insert(textureName);
+        }
 
-        if (std::filesystem::exists(acdPath))
+        // the diffuse texture of a material multiplied by its detail and ambient occlusion textures
+        // materials with the same textures and settings share the baked texture
+        void bakeMaterials(kn5& model, const std::string& directory, const std::set<std::string>& opaqueTextures)
         {
-            acd data(acdPath.string());
+            auto findTexture = [&model](const kn5::TextureMapping* mapping) -> const kn5::Texture*
+            {
+                for (const auto& texture : model.m_textures)
+                {
+                    if (mapping && texture.m_name == mapping->m_textureName)
+                        return &texture;
+                }
 
-            dataDirectoryPath = outputPath;
+                return nullptr;
+            };
 
-            dataDirectoryPath.append("data");
+            for (auto& material : model.m_materials)
+            {
+                const kn5::ShaderProperty*  useDetail = material.findShaderProperty("useDetail");
+                kn5::TextureMapping*        txDiffuse = material.findTextureMapping("txDiffuse");
+                const kn5::Texture*         diffuse = findTexture(txDiffuse);
+                const kn5::Texture*         detail = findTexture(material.findTextureMapping("txDetail"));
+                const kn5::Texture*         occlusion = findTexture(material.findTextureMapping("txAO"));
 
-            if (!std::filesystem::exists(dataDirectoryPath))
-                std::filesystem::create_directory(dataDirectoryPath);
+                if (diffuse == nullptr || m_keepNames.count(diffuse->m_name) != 0)
+                    continue;
 
-            // write the ini files to the output data directory
-            data.writeEntries(dataDirectoryPath.string());
-        }
-    }
+                if (useDetail == nullptr || useDetail->m_value == 0.0f)
+                    detail = nullptr;
 
-    if (inputFileName.empty())
-        inputFileName = inputFileDirectoryName + ".kn5";
+                if (detail == nullptr && occlusion == nullptr)
+                    continue;
 
-    // textures are only in lod 0 file
-    std::filesystem::path   lodFilePath(dataDirectoryPath);
+                // the baked texture is mapped like the diffuse texture
+                const kn5::ShaderProperty*  detailMultiplier = material.findShaderProperty("detailUVMultiplier");
+                float                       diffuseMultiplier = kn5model::getUVMultiplier(material, true);
+                std::vector<TextureLayer>   layers;
+                std::string                 description = contenthash(diffuse->m_data.data(), diffuse->m_data.size()).to_string();
 
-    lodFilePath.append("lods.ini");
+                if (diffuseMultiplier == 0.0f)
+                    diffuseMultiplier = 1.0f;
 
-    ini lods(lodFilePath.string());
+                if (detail)
+                {
+                    layers.push_back(TextureLayer{ detail->m_data.data(), detail->m_data.size(), (detailMultiplier ? detailMultiplier->m_value : 1.0f) / diffuseMultiplier });
+                    description += " " + contenthash(detail->m_data.data(), detail->m_data.size()).to_string() + " " + std::to_string(layers.back().m_uvMultiplier);
+                }
 
-    std::string lod0FileName = lods.getValue("LOD_0", "FILE");
+                if (occlusion)
+                {
+                    layers.push_back(TextureLayer{ occlusion->m_data.data(), occlusion->m_data.size(), 1.0f / diffuseMultiplier });
+                    description += " " + contenthash(occlusion->m_data.data(), occlusion->m_data.size()).to_string() + " " + std::to_string(layers.back().m_uvMultiplier);
+                }
 
-    kn5 lod0model;
+                const bool      alpha = opaqueTextures.count(diffuse->m_name) == 0;
+                const Key       key(contenthash(description.data(), description.size()), alpha);
+                const auto      output = m_outputs.find(key);
 
-    if (inputFileName != lod0FileName)
-    {
-        // get the textures from lod 0
-        std::filesystem::path   lod0FilePath = inputPath;
+                if (output != m_outputs.end())
+                {
+                    txDiffuse->m_textureName = output->second.m_name;
+                    continue;
+                }
 
-        lod0FilePath.append(lod0FileName);
+                const std::string name = std::filesystem::path(diffuse->m_name).stem().string() + "_" + key.first.to_string().substr(0, 8) + ".png";
+                std::filesystem::path path(directory);
 
-        std::string lod0FilePathString = lod0FilePath.string();
+                path.append(name);
 
-        try
-        {
-            lod0model.read(lod0FilePathString);
-        }
-        catch (std::ifstream::failure& e)
-        {
-            std::cerr << "Error reading: " << lod0FilePathString << " : " << e.code().message() << std::endl;
-            return EXIT_FAILURE;
-        }
-        catch (std::runtime_error& e)
-        {
-            std::cerr << "Error reading: " << lod0FilePathString << " : " << e.what() << std::endl;
-            return EXIT_FAILURE;
+                m_outputs.emplace(key, Output{ name, path.string(), path.string(), getStoreKey(key.first, alpha),
+                                               diffuse->m_data.data(), diffuse->m_data.size(), alpha, false, false, layers, {} });
+
+                txDiffuse->m_textureName = name;
+            }
         }
 
-        // rename skin texture
-        if (!skinFileName.empty())
+        // textures identical to one already seen are renamed to it in the model and its materials
+        // the textures aren't written until they are known to be used
+        void prepare(kn5& model, const std::string& directory)
         {
-            for (auto& material : lod0model.m_materials)
+            if (!std::filesystem::exists(directory))
             {
-                kn5::TextureMapping* txDiffuse = material.findTextureMapping("txDiffuse");
+                if (!std::filesystem::create_directory(directory))
+                    throw std::runtime_error("Couldn't create directory: " + directory);
+            }
 
-                if (txDiffuse && txDiffuse->m_textureName == skinFileName)
-                {
-                    size_t extension = skinFileName.find('.');
+            const std::set<std::string> opaqueTextures = getOpaqueTextures(model);
 
-                    if (extension != std::string::npos)
-                    {
-                        txDiffuse->m_textureName = inputFileDirectoryName + skinFileName.substr(extension);
+            if (m_bake && m_convertToPNG)
+                bakeMaterials(model, directory, opaqueTextures);
 
-                        for (auto& texture : lod0model.m_textures)
-                        {
-                            if (texture.m_name == skinFileName)
-                                texture.m_name = txDiffuse->m_textureName;
-                        }
-                    }
+            for (auto& texture : model.m_textures)
+            {
+                // also renames the textures of the other models sharing the name
+                const auto renamed = m_renamed.find(texture.m_name);
+
+                if (renamed != m_renamed.end())
+                {
+                    texture.m_name = renamed->second;
+                    continue;
                 }
-            }
-        }
 
-        writeTextureFiles(lod0model, outputPath.string(), convertToPNG, deleteDDS);
+                std::filesystem::path texturePath(directory);
 
-        if (dumpModel)
-        {
-            std::filesystem::path dumpFilePath = outputPath;
+                texturePath.append(texture.m_name);
 
-            dumpFilePath.append(lod0FileName + ".dump");
+                const std::string texturePathString = texturePath.string();
 
-            std::ofstream of(dumpFilePath.string());
+                // the first model to use a texture name writes it
+                if (!m_prepared.insert(texturePathString).second)
+                    continue;
 
-            if (of)
-                lod0model.dump(of);
+                const std::string png = getOutputTextureName(texturePathString, m_convertToPNG);
+                const bool alpha = opaqueTextures.count(texture.m_name) == 0;
+                const Key key(contenthash(texture.m_data.data(), texture.m_data.size()), alpha);
+                const bool keep = m_keepNames.count(texture.m_name) != 0;
+                const auto output = m_outputs.find(key);
 
-            of.close();
-        }
+                if (output != m_outputs.end())
+                {
+                    if (keep || output->second.m_keepName)
+                        m_links.push_back(Link{ texture.m_name, output->second.m_name, output->second.m_fileName, png, output->second.m_storeKey, false });
+                    else
+                    {
+                        m_renamed[texture.m_name] = output->second.m_name;
+                        texture.m_name = output->second.m_name;
+                    }
 
-        if (dumpModelHierarchy)
-        {
-            std::filesystem::path dumpFilePath = outputPath;
+                    continue;
+                }
 
-            dumpFilePath.append(lod0FileName + ".hierarchy.dump");
+                m_outputs.emplace(key, Output{ texture.m_name, texturePathString, png, getStoreKey(key.first, alpha),
+                                               texture.m_data.data(), texture.m_data.size(), alpha, keep, false, {}, {} });
+            }
 
-            std::ofstream of(dumpFilePath.string());
-
-            if (of)
-                lod0model.dumpHierarchy(of);
+            for (auto& material : model.m_materials)
+            {
+                for (auto& mapping : material.m_textureMappings)
+                {
+                    const auto it = m_renamed.find(mapping.m_textureName);
 
-            of.close();
+                    if (it != m_renamed.end())
+                        mapping.m_textureName = it->second;
+                }
+            }
         }
-    }
-
-    std::filesystem::path   inputFilePath(inputPath);
-
-    inputFilePath.append(inputFileName);
-
-    kn5 model;
-
-    try
-    {
-        model.read(inputFilePath.string());
-    }
-    catch (std::ifstream::failure& e)
-    {
-        std::cerr << "Error reading: " << inputFilePath.string() << " : " << e.code().message() << std::endl;
-        return EXIT_FAILURE;
-    }
-    catch (std::runtime_error& e)
-    {
-        std::cerr << "Error reading: " << inputFilePath.string() << " : " << e.what() << std::endl;
-        return EXIT_FAILURE;
-    }
 
-    if (dumpModel)
-    {
-        std::filesystem::path dumpFilePath = outputPath;
-
-        dumpFilePath.append(inputFileName + ".dump");
+        // queues the prepared textures in use, the model they came from must outlive the jobs
+        void write(const std::set<std::string>& usedTextures)
+        {
+            std::set<std::string> names(usedTextures);
 
-        std::ofstream of(dumpFilePath.string());
+            // a linked texture needs the texture it is linked to
+            for (auto& link : m_links)
+            {
+                if (usedTextures.count(link.m_name) != 0)
+                {
+                    link.m_used = true;
+                    names.insert(link.m_source);
+                }
+            }
 
-        if (of)
-            model.dump(of);
-    }
+            for (auto& output : m_outputs)
+            {
+                if (output.second.m_queued || names.count(output.second.m_name) == 0)
+                    continue;
 
-    if (dumpModelHierarchy)
-    {
-        std::filesystem::path dumpFilePath = outputPath;
+                output.second.m_queued = true;
 
-        dumpFilePath.append(lod0FileName + ".hierarchy.dump");
+                queue(output.second);
+            }
+        }
 
-        std::ofstream of(dumpFilePath.string());
+        // queues every prepared texture
+        void write()
+        {
+            for (auto& link : m_links)
+                link.m_used = true;
 
-        if (of)
-            model.dumpHierarchy(of);
+            for (auto& output : m_outputs)
+            {
+                if (output.second.m_queued)
+                    continue;
 
-        of.close();
-    }
+                output.second.m_queued = true;
 
-    if (writeCarConfig)
-    {
-        std::filesystem::path   colliderFilePath = inputPath;
+                queue(output.second);
+            }
+        }
 
-        colliderFilePath.append("collider.kn5");
+        // prints the size and number of the textures that weren't used
+        void reportSkipped() const
+        {
+            size_t count = 0;
+            size_t bytes = 0;
 
-        kn5 collider;
+            for (const auto& output : m_outputs)
+            {
+                if (!output.second.m_queued)
+                {
+                    count++;
+                    bytes += output.second.m_size;
+                }
+            }
 
-        try
-        {
-            collider.read(colliderFilePath.string());
-        }
-        catch (std::ifstream::failure& e)
-        {
-            std::cerr << "Error reading: " << colliderFilePath.string() << " : " << e.code().message() << std::endl;
-            return EXIT_FAILURE;
-        }
-        catch (std::runtime_error& e)
-        {
-            std::cerr << "Error reading: " << colliderFilePath.string() << " : " << e.what() << std::endl;
-            return EXIT_FAILURE;
+            if (count != 0)
+                std::cout << "skipped " << count << " unused textures (" << bytes << " bytes)" << std::endl;
         }
 
-        if (dumpCollider)
+        // the preview is copied once the skin is converted
+        void writeSkin(const std::string& skinFileName, const std::string& pngFileName, const std::string& previewFileName, const std::string& pngPreviewFileName)
         {
-            std::filesystem::path dumpFilePath = outputPath;
-
-            dumpFilePath.append("collider.kn5.dump");
-
-            std::ofstream of1(dumpFilePath.string());
+            m_jobs.add(skinFileName + " to " + pngFileName, [this, skinFileName, pngFileName, previewFileName, pngPreviewFileName]()
+            {
+                // a preview that didn't change isn't copied again
+                auto copyPreview = [&]()
+                {
+                    if (!std::filesystem::exists(previewFileName))
+                        return;
 
-            if (of1)
-                collider.dump(of1);
-        }
+                    const std::string previewKey = m_manifest ? m_manifest->hash(previewFileName) : std::string();
 
-        kn5::Vec3 minimum = { 100000, 100000, 100000 };
-        kn5::Vec3 maximum = { -100000, -100000, -100000 };
+                    if (!m_manifest || !m_manifest->isCurrentOutput(pngPreviewFileName, previewKey))
+                        std::filesystem::copy(previewFileName, pngPreviewFileName, std::filesystem::copy_options::overwrite_existing);
 
-        kn5::Node& mesh = collider.m_node;
-        while (mesh.m_type == kn5::Node::Transform && mesh.m_children.size() == 1)
-            mesh = mesh.m_children[0];
+                    addOutput("skins", pngPreviewFileName, previewKey);
+                };
 
-        if (mesh.m_type == kn5::Node::Mesh)
-        {
-            for (const auto& vertex : mesh.m_vertices)
-            {
-                for (size_t i = 0; i < 3; i++)
+                // a skin that didn't change isn't read
+                if (m_manifest)
                 {
-                    if (vertex.m_position[i] < minimum[i])
-                        minimum[i] = vertex.m_position[i];
+                    const std::string storeKey = getStoreKey(m_manifest->hash(skinFileName), true);
 
-                    if (vertex.m_position[i] > maximum[i])
-                        maximum[i] = vertex.m_position[i];
+                    if (m_manifest->isCurrentOutput(pngFileName, storeKey))
+                    {
+                        addOutput("skins", pngFileName, storeKey);
+                        copyPreview();
+                        return;
+                    }
                 }
-            }
-        }
 
-        float length = maximum[2] - minimum[2];
-        float width = maximum[0] - minimum[0];
-        float height = maximum[1] - minimum[1];
+                std::ifstream   fin(skinFileName, std::ios::binary);
+                const std::vector<char> skin((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
 
-        std::filesystem::path   configFilePath = outputPath;
+                fin.close();
 
-        configFilePath.append(inputFileDirectoryName + ".xml");
+                const std::string storeKey = getStoreKey(contenthash(skin.data(), skin.size()), true);
 
-        try
-        {
-            writeConfig(inputPath, dataDirectoryPath.string(), configFilePath.string(), inputFileName != lod0FileName ? lod0model : model, length, width, height, category, outputACC);
-        }
-        catch (std::runtime_error& e)
-        {
-            std::cerr << "Error writing : " << configFilePath.string() << " : " << e.what() << std::endl;
-            return EXIT_FAILURE;
-        }
-    }
+                if (m_store == nullptr || !m_store->materialize(storeKey, pngFileName))
+                {
+                    // the old file may share its data with the asset store of this or an earlier conversion
+                    std::filesystem::remove(pngFileName);
 
-    if (writeModel)
-    {
-        kn5::Matrix xform;
+                    try
+                    {
+                        if (!dds::isDDS(skin.data(), skin.size()))
+                            throw std::runtime_error("not a dds file");
 
-        xform.m_data[0][0] = 0;
-        xform.m_data[0][1] = 0;
-        xform.m_data[0][2] = -1;
-        xform.m_data[0][3] = 0;
+                        convertTexture(skin.data(), skin.size(), {}, pngFileName, true, m_options, m_maxSize);
+                    }
+                    catch (std::runtime_error&)
+                    {
+                        if (!convertTexture(skinFileName, pngFileName, true, m_maxSize))
+                            throw;
+                    }
 
-        xform.m_data[1][0] = 0;
-        xform.m_data[1][1] = 1;
-        xform.m_data[1][2] = 0;
-        xform.m_data[1][3] = 0;
+                    if (m_store)
+                        m_store->insert(storeKey, pngFileName);
+                }
 
-        xform.m_data[2][0] = 1;
-        xform.m_data[2][1] = 0;
-        xform.m_data[2][2] = 0;
-        xform.m_data[2][3] = 0;
+                addOutput("skins", pngFileName, storeKey);
 
-        xform.m_data[3][0] = 0;
-        xform.m_data[3][1] = 0;
-        xform.m_data[3][2] = 0;
-        xform.m_data[3][3] = 1;
+                copyPreview();
+            });
+        }
 
-        if (extractCarParts)
+        // waits for the queued jobs, reports the failures and links the textures that kept their names
+        // returns the number of failures so far
+        size_t wait()
         {
-            std::filesystem::path extractFilePath = outputPath;
-
-            extractFilePath.append("steer.acc");
-
-            // get steering wheel from lod 0 model
-            if (inputFileName != lod0FileName)
+            for (const auto& error : m_jobs.wait())
             {
-                extract(lod0model, "STEER_LR", xform, extractFilePath.string());
-                remove(model, kn5::Node::Transform, "STEER_LR");
+                std::cerr << "failed to convert " << error.m_name << " : " << error.m_message << std::endl;
+                m_failures++;
             }
-            else
-                extract(model, "STEER_LR", xform, extractFilePath.string());
-
-            extractFilePath = outputPath;
 
-            extractFilePath.append("histeer.acc");
-
-            if (inputFileName != lod0FileName)
+            for (auto& link : m_links)
             {
-                extract(lod0model, "STEER_HR", xform, extractFilePath.string());
-                remove(model, kn5::Node::Transform, "STEER_HR");
-            }
-            else
-                extract(model, "STEER_HR", xform, extractFilePath.string());
+                if (!link.m_used)
+                    continue;
 
-            remove(model, kn5::Node::Transform, "WHEEL_RF");
-            remove(model, kn5::Node::Transform, "WHEEL_LF");
-            remove(model, kn5::Node::Transform, "WHEEL_RR");
-            remove(model, kn5::Node::Transform, "WHEEL_LR");
+                link.m_used = false;
 
-            std::filesystem::path iniFilePath = dataDirectoryPath;
+                if (!std::filesystem::exists(link.m_sourceFileName))
+                    continue;
 
-            iniFilePath.append("brakes.ini");
+                if (isCurrent(link.m_fileName, link.m_storeKey))
+                {
+                    addOutput("textures", link.m_fileName, link.m_storeKey);
+                    continue;
+                }
 
-            const ini brakes(iniFilePath.string());
+                if (!assetstore::link(link.m_sourceFileName, link.m_fileName))
+                {
+                    std::cerr << "failed to link " << link.m_sourceFileName << " to " << link.m_fileName << std::endl;
+                    m_failures++;
+                }
+                else
+                    addOutput("textures", link.m_fileName, link.m_storeKey);
+            }
 
-            remove(model, kn5::Node::Mesh, brakes.getValue("DISCS_GRAPHICS", "DISC_LF"));
-            remove(model, kn5::Node::Mesh, brakes.getValue("DISCS_GRAPHICS", "DISC_RF"));
-            remove(model, kn5::Node::Mesh, brakes.getValue("DISCS_GRAPHICS", "DISC_LR"));
-            remove(model, kn5::Node::Mesh, brakes.getValue("DISCS_GRAPHICS", "DISC_RR"));
+            return m_failures;
         }
+    };
 
-        // rename skin texture
-        if (!skinFileName.empty())
+    // the skin texture gets the name of the car so the liveries can replace it
+    void renameSkin(kn5& model, const std::string& skinFileName, const std::string& carName, textureWriter& textures)
+    {
+        for (auto& material : model.m_materials)
         {
-            for (auto& material : model.m_materials)
+            kn5::TextureMapping* txDiffuse = material.findTextureMapping("txDiffuse");
+
+            if (txDiffuse && txDiffuse->m_textureName == skinFileName)
             {
-                kn5::TextureMapping* txDiffuse = material.findTextureMapping("txDiffuse");
+                size_t extension = skinFileName.find('.');
 
-                if (txDiffuse && txDiffuse->m_textureName == skinFileName)
+                if (extension != std::string::npos)
                 {
-                    size_t extension = skinFileName.find('.');
+                    txDiffuse->m_textureName = carName + skinFileName.substr(extension);
+                    textures.keepName(txDiffuse->m_textureName);
 
-                    if (extension != std::string::npos)
+                    for (auto& texture : model.m_textures)
                     {
-                        txDiffuse->m_textureName = inputFileDirectoryName + skinFileName.substr(extension);
-
-                        for (auto& texture : model.m_textures)
-                        {
-                            if (texture.m_name == skinFileName)
-                                texture.m_name = txDiffuse->m_textureName;
-                        }
+                        if (texture.m_name == skinFileName)
+                            texture.m_name = txDiffuse->m_textureName;
                     }
                 }
             }
         }
+    }
+
+    // the colors of a material, materials with the same colors can share an AC3D material
+    void writeAc3dMaterial(std::ostream& fout, const kn5::Material& material)
+    {
+        const kn5::ShaderProperty* property = material.findShaderProperty("ksDiffuse");
 
-        if (cockpitLR)
+        if (property != nullptr)
         {
-            kn5::Node* cockpitHRNode = model.findNode(kn5::Node::Transform, "COCKPIT_HR");
+            const float rgb = std::clamp(property->m_value, 0.0f, 1.0f);
+            fout << " rgb " << rgb << " " << rgb << " " << rgb;
+        }
+        else
+            fout << " rgb 1 1 1";
 
-            if (cockpitHRNode && cockpitHRNode->m_active)
-            {
-                kn5::Node* cockpitLRNode = model.findNode(kn5::Node::Transform, "COCKPIT_LR");
+        property = material.findShaderProperty("ksAmbient");
 
-                if (cockpitHRNode)
-                {
-                    cockpitHRNode->m_active = false;
-                    cockpitLRNode->m_active = true;
-                }
-            }
+        if (property != nullptr)
+        {
+            const float amb = std::clamp(property->m_value, 0.0f, 1.0f);
+            fout << "  amb " << amb << " " << amb << " " << amb;
         }
+        else
+            fout << "  amb 1 1 1";
 
-        model.removeInactiveNodes();
-        model.transform(xform);
-        model.removeEmptyNodes();
+        property = material.findShaderProperty("ksEmissive");
 
-        std::filesystem::path outputFilePath = outputPath;
+        if (property != nullptr)
+        {
+            const float emis = std::clamp(property->m_value, 0.0f, 1.0f);
+            fout << "  emis " << emis << " " << emis << " " << emis;
+        }
+        else
+            fout << "  emis 1 1 1";
 
-        outputFilePath.append(inputFileDirectoryName + (outputACC ? ".acc" : ".ac"));
+        property = material.findShaderProperty("ksSpecular");
 
-        writeAc3d(model, outputFilePath.string(), convertToPNG, outputACC, useDiffuse);
-    }
+        if (property != nullptr)
+        {
+            const float spec = std::clamp(property->m_value, 0.0f, 1.0f);
+            fout << "  spec " << spec << " " << spec << " " << spec;
+        }
+        else
+            fout << "  spec 1 1 1";
 
-    if (writeTextures)
-        writeTextureFiles(model, outputPath.string(), convertToPNG, deleteDDS);
+        property = material.findShaderProperty("ksSpecularEXP");  // FIXME is this the right parameter?
 
-    if (writeCmake)
-    {
-        std::filesystem::path cmakeFileName = outputPath;
+        if (property != nullptr)
+        {
+            // FIXME should this be scaled?
+            const float shi = std::clamp(property->m_value, 0.0f, 128.0f);
+            fout << "  shi " << static_cast<int>(shi);
+        }
+        else
+            fout << "  shi 0";
 
-        cmakeFileName.append("CMakeLists.txt");
+        property = material.findShaderProperty("ksAlphaRef");  // FIXME is this the right parameter?
 
-        std::ofstream   fout(cmakeFileName.string());
+        if (property != nullptr)
+        {
+            const float trans = std::clamp(property->m_value, 0.0f, 1.0f);
+            fout << "  trans " << trans;
+        }
+        else
+            fout << "  trans 0";
+    }
 
-        if (fout)
+    void writeAc3dMaterials(const kn5& model, std::ostream& fout, const kn5::Node& node, const std::set<int>& usedMaterialIDs)
+    {
+        for (auto materialID : usedMaterialIDs)
         {
-            fout << "INCLUDE(../../../../cmake/macros.cmake)" << std::endl;
-            fout << std::endl;
-            fout << "SD_INSTALL_CAR(" << inputFileDirectoryName << ")" << std::endl;
+            const kn5::Material& material = model.m_materials[materialID];
 
-            fout.close();
+            std::string materialName = material.m_name;
+
+            for (size_t i = 0; i < materialName.size(); i++)
+            {
+                if (materialName[i] == ' ')
+                    materialName[i] = '_';
+            }
+
+            fout << "MATERIAL " << "\"" << materialName << "\"";
+
+            writeAc3dMaterial(fout, material);
+
+            fout << std::endl;
         }
     }
 
-    if (deleteData)
+    void getMeshes(kn5::Node& node, std::vector<kn5::Node*>& meshes)
     {
-        std::filesystem::path dataDirectory = outputPath;
+        if (node.m_type == kn5::Node::Mesh || node.m_type == kn5::Node::SkinnedMesh)
+            meshes.push_back(&node);
 
-        dataDirectory.append("data");
-
-        if (std::filesystem::exists(dataDirectory))
-            std::filesystem::remove_all(dataDirectory);
+        for (auto& child : node.m_children)
+            getMeshes(child, meshes);
     }
 
-    if (writeSkins)
+    // the texture mapping getTextureName returns the texture of
+    kn5::TextureMapping* getTextureMapping(kn5::Material& material, bool useDiffuse)
     {
-        std::filesystem::path skinDirectory = inputPath;
+        const kn5::ShaderProperty* useDetail = material.findShaderProperty("useDetail");
+        kn5::TextureMapping* txDetail = material.findTextureMapping("txDetail");
 
-        skinDirectory.append("skins");
+        if (!useDiffuse && (useDetail && useDetail->m_value != 0.0f) && txDetail)
+            return txDetail;
 
-        if (std::filesystem::exists(skinDirectory))
-        {
-            for (const auto& entry : std::filesystem::directory_iterator(skinDirectory))
-            {
-                std::filesystem::path   skinFilePath = entry.path();
-                const std::string livery = skinFilePath.filename().string();
+        return material.findTextureMapping("txDiffuse");
+    }
 
-                skinFilePath.append(skinFileName);
+    uint32_t getPowerOfTwo(uint32_t size)
+    {
+        uint32_t power = 1;
 
-                if (std::filesystem::exists(skinFilePath))
-                {
-                    std::filesystem::path liveryFilePath = outputPath;
+        while (power < size)
+            power *= 2;
 
-                    liveryFilePath.append(inputFileDirectoryName + "-" + livery + ".png");
+        return power;
+    }
+
+    // Packs the small textures of the meshes of a model into atlases and changes the uvs and materials of the meshes to use them.
+    // Textures repeated across a mesh (uvs outside 0 to 1) and textures that keep their names are left alone.
+    // Meshes with the same atlas and colors share one material.
+    void packAtlases(kn5& model, const kn5& textureModel, const std::string& directory, bool useDiffuse, uint32_t maxSize, textureWriter& textures)
+    {
+        constexpr uint32_t  maximumTextureSize = 512;
+        constexpr uint32_t  maximumAtlasSize = 2048;
+        constexpr float     tolerance = 0.0001f;
 
-                    std::string liveryFilePathString = liveryFilePath.string();
+        struct Placement
+        {
+            std::string m_atlas;
+            uint32_t    m_x = 0;
+            uint32_t    m_y = 0;
+            uint32_t    m_width = 0;
+            uint32_t    m_height = 0;
+            uint32_t    m_atlasWidth = 0;
+            uint32_t    m_atlasHeight = 0;
+        };
+
+        struct Candidate
+        {
+            std::string         m_name;
+            const kn5::Texture* m_texture = nullptr;
+            uint32_t            m_width = 0;
+            uint32_t            m_height = 0;
+        };
 
-                    quote(liveryFilePathString);
+        std::vector<kn5::Node*>     meshes;
+        std::map<std::string, bool> packable;
+        std::set<std::string>       texturesBefore;
+        std::set<int>               materialsBefore;
 
-                    std::string skinFilePathString = skinFilePath.string();
+        getMeshes(model.m_node, meshes);
 
-                    quote(skinFilePathString);
+        for (const auto* mesh : meshes)
+        {
+            const kn5::Material&    material = model.m_materials[mesh->m_materialID];
+            const std::string       name = getTextureName(material, useDiffuse);
+            const float             uvMult = kn5model::getUVMultiplier(material, useDiffuse);
+            bool                    inside = uvMult != 0.0f;
 
-                    const std::string command("magick convert " + skinFilePathString + " " + liveryFilePathString);
+            for (const auto& vertex : mesh->m_vertices)
+            {
+                for (size_t i = 0; i < 2 && inside; i++)
+                    inside = vertex.m_texture[i] * uvMult >= -tolerance && vertex.m_texture[i] * uvMult <= 1 + tolerance;
+            }
 
-                    if (system(command.c_str()) == -1)
-                    {
-                        std::cerr << "failed to convert " << skinFilePathString << " to " << liveryFilePathString << std::endl;
+            texturesBefore.insert(name);
+            materialsBefore.insert(mesh->m_materialID);
 
-                        continue;
-                    }
+            auto it = packable.emplace(name, true).first;
 
-                    std::filesystem::path previewPath = entry.path();
+            it->second = it->second && inside;
+        }
 
-                    previewPath.append("preview.jpg");
+        // opaque and transparent textures go in different atlases
+        const std::set<std::string>     opaqueTextures = getOpaqueTextures(model);
+        std::vector<Candidate>          candidates[2];
 
-                    if (std::filesystem::exists(previewPath))
-                    {
-                        std::filesystem::path liveryPreviewPath = outputPath;
+        for (const auto& entry : packable)
+        {
+            if (!entry.second || textures.keepsName(entry.first))
+                continue;
 
-                        liveryPreviewPath.append(inputFileDirectoryName + "-" + livery + "-preview.jpg");
+            const kn5*  models[] = { &textureModel, &model };
+            Candidate   candidate;
 
-                        std::filesystem::copy(previewPath, liveryPreviewPath, std::filesystem::copy_options::overwrite_existing);
-                    }
+            for (const auto* source : models)
+            {
+                for (const auto& texture : source->m_textures)
+                {
+                    if (candidate.m_texture == nullptr && texture.m_name == entry.first)
+                        candidate.m_texture = &texture;
                 }
             }
-        }
-    }
 
-    if (writeDriver)
-    {
-        std::filesystem::path drive3dPath = dataDirectoryPath;
+            if (candidate.m_texture == nullptr || !dds::isDDS(candidate.m_texture->m_data.data(), candidate.m_texture->m_data.size()))
+                continue;
 
-        drive3dPath.append("driver3d.ini");
+            try
+            {
+                // only textures that can be decoded in memory
+                const dds   texture(candidate.m_texture->m_data.data(), candidate.m_texture->m_data.size());
+                const auto  size = getTextureSize(texture, maxSize);
 
-        if (std::filesystem::exists(drive3dPath))
-        {
-            ini driver3d(drive3dPath.string());
+                candidate.m_width = size.first;
+                candidate.m_height = size.second;
+            }
+            catch (std::runtime_error&)
+            {
+                continue;
+            }
 
-            std::string driverFileName = driver3d.getValue("MODEL", "NAME");
+            if (candidate.m_width > maximumTextureSize || candidate.m_height > maximumTextureSize)
+                continue;
 
-            driverFileName += ".kn5";
+            candidate.m_name = entry.first;
+            candidates[opaqueTextures.count(entry.first) != 0 ? 0 : 1].push_back(candidate);
+        }
 
-            std::filesystem::path driverGraphicsPath; // = "C:\\Program Files (x86)\\Steam\\steamapps\\common\\assettocorsa\\content\\driver";
+        std::map<std::string, Placement>    placements;
+        size_t                              atlasCount = 0;
 
-            if (driverDirectory.empty())
-            {
-                // assume assetto corsa directory structure
-                driverGraphicsPath = inputPath;
-                driverGraphicsPath.append("../../driver");
-            }
-            else
-                driverGraphicsPath = driverDirectory;
+        for (int group = 0; group < 2; group++)
+        {
+            std::vector<Candidate>& list = candidates[group];
+            uint64_t                area = 0;
+            uint32_t                widest = 0;
 
-            driverGraphicsPath.append(driverFileName);
+            // shelves of textures from the highest to the lowest
+            std::sort(list.begin(), list.end(), [](const Candidate& a, const Candidate& b)
+            {
+                return a.m_height != b.m_height ? a.m_height > b.m_height : (a.m_width != b.m_width ? a.m_width > b.m_width : a.m_name < b.m_name);
+            });
 
-            if (std::filesystem::exists(driverGraphicsPath))
+            for (const auto& candidate : list)
             {
-                kn5 driverModel;
+                area += static_cast<uint64_t>(candidate.m_width + atlasPadding * 2) * (candidate.m_height + atlasPadding * 2);
+                widest = std::max(widest, candidate.m_width + atlasPadding * 2);
+            }
 
-                try
-                {
-                    driverModel.read(driverGraphicsPath.string());
-                }
-                catch (std::ifstream::failure& e)
-                {
-                    std::cerr << "Error reading: " << driverGraphicsPath.string() << " : " << e.code().message() << std::endl;
-                    return EXIT_FAILURE;
-                }
-                catch (std::runtime_error& e)
-                {
-                    std::cerr << "Error reading: " << driverGraphicsPath.string() << " : " << e.what() << std::endl;
-                    return EXIT_FAILURE;
-                }
+            const uint32_t  atlasWidth = std::min(maximumAtlasSize, getPowerOfTwo(std::max(widest, static_cast<uint32_t>(std::sqrt(static_cast<double>(area))))));
+            size_t          first = 0;
 
-                if (dumpInputDriver)
+            while (first < list.size())
+            {
+                std::vector<AtlasTile>  tiles;
+                std::vector<size_t>     packed;
+                uint32_t                x = 0;
+                uint32_t                y = 0;
+                uint32_t                shelf = 0;
+                size_t                  next = first;
+
+                for (; next < list.size(); next++)
                 {
-                    std::filesystem::path  driverDumpPath = outputPath;
+                    const uint32_t width = list[next].m_width + atlasPadding * 2;
+                    const uint32_t height = list[next].m_height + atlasPadding * 2;
 
-                    driverDumpPath.append(driverFileName + ".dump");
+                    if (x + width > atlasWidth)
+                    {
+                        x = 0;
+                        y += shelf;
+                        shelf = 0;
+                    }
 
-                    std::ofstream of(driverDumpPath.string());
+                    if (y + height > maximumAtlasSize)
+                        break;
 
-                    if (of)
-                        driverModel.dump(of);
+                    tiles.push_back(AtlasTile{ list[next].m_texture->m_data.data(), list[next].m_texture->m_data.size(), x + atlasPadding, y + atlasPadding });
+                    packed.push_back(next);
 
-                    of.close();
+                    x += width;
+                    shelf = std::max(shelf, height);
                 }
 
-                std::filesystem::path driverPath = inputPath;
+                first = next;
+
+                // a single texture doesn't save anything
+                if (tiles.size() < 2)
+                    continue;
 
-                driverPath.append("driver_base_pos.knh");
+                const uint32_t      atlasHeight = getPowerOfTwo(y + shelf);
+                const std::string   atlas = textures.addAtlas(directory, atlasWidth, atlasHeight, group == 1, tiles);
 
-                if (std::filesystem::exists(driverPath))
+                for (size_t i = 0; i < packed.size(); i++)
                 {
-                    knh driver(driverPath.string());
+                    const Candidate& candidate = list[packed[i]];
 
-                    if (dumpDriverKnh)
-                    {
-                        std::filesystem::path   driverDumpPath = outputPath;
+                    placements[candidate.m_name] = Placement{ atlas, tiles[i].m_x, tiles[i].m_y, candidate.m_width, candidate.m_height, atlasWidth, atlasHeight };
+                }
+
+                atlasCount++;
+            }
+        }
 
-                        driverDumpPath.append("driver_base_pos.knh.dump");
+        if (placements.empty())
+            return;
 
-                        std::ofstream of(driverDumpPath.string());
+        // the first material with an atlas and the same colors is used by the other meshes
+        std::map<std::pair<std::string, std::string>, int>  merged;
+        std::set<std::string>   texturesAfter;
+        std::set<int>           materialsAfter;
 
-                        if (of)
-                            driver.dump(of);
+        for (auto* mesh : meshes)
+        {
+            const int           oldID = mesh->m_materialID;
+            const std::string   name = getTextureName(model.m_materials[oldID], useDiffuse);
+            const auto          placement = placements.find(name);
 
-                        of.close();
-                    }
+            if (placement == placements.end())
+            {
+                texturesAfter.insert(name);
+                materialsAfter.insert(oldID);
+                continue;
+            }
 
-                    // TODO: position driver from knh file
+            std::ostringstream  colors;
 
-                    kn5::Matrix xform;
+            writeAc3dMaterial(colors, model.m_materials[oldID]);
 
-                    xform.m_data[0][0] = 0;
-                    xform.m_data[0][1] = 0;
-                    xform.m_data[0][2] = -1;
-                    xform.m_data[0][3] = 0;
+            const int           newID = merged.emplace(std::make_pair(placement->second.m_atlas, colors.str()), oldID).first->second;
+            const float         oldMult = kn5model::getUVMultiplier(model.m_materials[oldID], useDiffuse);
+            const float         newMult = kn5model::getUVMultiplier(model.m_materials[newID], useDiffuse);
+            const Placement&    place = placement->second;
 
-                    xform.m_data[1][0] = 0;
-                    xform.m_data[1][1] = 1;
-                    xform.m_data[1][2] = 0;
-                    xform.m_data[1][3] = 0;
+            // the uvs are multiplied by the uv multiplier of the new material when they are written
+            for (auto& vertex : mesh->m_vertices)
+            {
+                vertex.m_texture[0] = (place.m_x + vertex.m_texture[0] * oldMult * place.m_width) / place.m_atlasWidth / newMult;
+                vertex.m_texture[1] = (place.m_y + vertex.m_texture[1] * oldMult * place.m_height) / place.m_atlasHeight / newMult;
+            }
 
-                    xform.m_data[2][0] = 1;
-                    xform.m_data[2][1] = 0;
-                    xform.m_data[2][2] = 0;
-                    xform.m_data[2][3] = 0;
+            mesh->m_materialID = newID;
 
-                    xform.m_data[3][0] = 0;
-                    xform.m_data[3][1] = 0;
-                    xform.m_data[3][2] = 0;
-                    xform.m_data[3][3] = 1;
+            texturesAfter.insert(place.m_atlas);
+            materialsAfter.insert(newID);
+        }
 
-                    driverModel.removeInactiveNodes();
-                    driverModel.transform(xform);
-                    driverModel.removeEmptyNodes();
+        for (const auto& entry : merged)
+            getTextureMapping(model.m_materials[entry.second], useDiffuse)->m_textureName = entry.first.first;
 
-                    std::filesystem::path driverOutFilePath = outputPath;
+        std::cout << "packed " << placements.size() << " textures in " << atlasCount << " atlases, textures " << texturesBefore.size() << " to " << texturesAfter.size()
+                  << ", materials " << materialsBefore.size() << " to " << materialsAfter.size() << std::endl;
+    }
 
-                    driverOutFilePath.append("driver.ac");
+    int getNewMaterialID(int materialID, const std::set<int>& usedMaterialIDs)
+    {
+        int newMaterialID = 0;
 
-                    writeAc3d(driverModel, driverOutFilePath.string(), true, false, true);
+        for (auto id : usedMaterialIDs)
+        {
+            if (id == materialID)
+                return newMaterialID;
 
-                    if (writeTextures)
-                        writeTextureFiles(driverModel, outputPath.string(), convertToPNG, deleteDDS);
-                }
-            }
+            newMaterialID++;
         }
+        return 0;
+    }
+
+    // The OBJECT poly blocks of the AC3D files of a car, kept in one file next to its manifest and found by the hash of
+    // what each block is written from, so the meshes that didn't change since a file was written are copied instead of
+    // formatted again. The blocks of a file are replaced when it is written again, the others are kept.
+    class meshCache
+    {
+    public:
+        using Blocks = std::map<std::string, std::string>;
+
+    private:
+        std::string                     m_fileName;
+        std::map<std::string, Blocks>   m_files;
+        bool                            m_changed = false;
+        std::mutex                      m_mutex;
+
+    public:
+        // rebuild ignores the blocks written before so every mesh is formatted again
+        meshCache(const std::string& directory, bool rebuild) : m_fileName((std::filesystem::path(directory) / "kn5toac.meshes").string())
+        {
+            std::ifstream   fin(m_fileName, std::ios::binary);
+            std::string     line;
+
+            if (rebuild || !fin || !std::getline(fin, line) || line != "kn5toac meshes 2")
+                return;
+
+            std::map<std::string, Blocks>   files;
+            Blocks*                         blocks = nullptr;
+
+            // a file is its name on one line followed by its blocks, a block is its key and size on one line followed by its text
+            while (std::getline(fin, line))
+            {
+                if (line.compare(0, 5, "file ") == 0)
+                {
+                    blocks = &files[line.substr(5)];
+                    continue;
+                }
+
+                std::istringstream  header(line);
+                std::string         key;
+                size_t              size = 0;
+
+                if (!blocks || !(header >> key >> size))
+                    return;
+
+                std::string block(size, '\0');
+
+                if (!fin.read(&block[0], size))
+                    return;
+
+                (*blocks)[key] = std::move(block);
+            }
+
+            m_files = std::move(files);
+        }
+
+        // the blocks written before for the AC3D file name
+        Blocks take(const std::string& name)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            const auto found = m_files.find(name);
+
+            if (found == m_files.end())
+                return Blocks();
+
+            Blocks blocks = std::move(found->second);
+
+            m_files.erase(found);
+
+            return blocks;
+        }
+
+        // the blocks of the AC3D file name just written
+        void put(const std::string& name, Blocks blocks)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            m_files[name] = std::move(blocks);
+            m_changed = true;
+        }
+
+        // the cache only makes writing faster so it can't fail
+        void save()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (!m_changed)
+                return;
+
+            const std::string   temporary = m_fileName + ".tmp";
+            std::error_code     error;
+
+            {
+                std::ofstream fout(temporary, std::ios::binary);
+
+                fout << "kn5toac meshes 2" << '\n';
+
+                for (const auto& file : m_files)
+                {
+                    fout << "file " << file.first << '\n';
+
+                    for (const auto& block : file.second)
+                        fout << block.first << ' ' << block.second.size() << '\n' << block.second;
+                }
+
+                fout.close();
+
+                if (!fout)
+                {
+                    std::filesystem::remove(temporary, error);
+                    return;
+                }
+            }
+
+            std::filesystem::rename(temporary, m_fileName, error);
+        }
+    };
+
+    // the blocks of one AC3D file while it is written
+    class meshFile
+    {
+        meshCache&          m_cache;
+        std::string         m_name;
+        meshCache::Blocks   m_previous;
+        meshCache::Blocks   m_current;
+
+    public:
+        meshFile(meshCache& cache, const std::string& fileName) :
+            m_cache(cache), m_name(std::filesystem::path(fileName).filename().string()), m_previous(cache.take(m_name))
+        {
+        }
+
+        // copies the block written before with key, returns false when there is none
+        bool write(std::ostream& fout, const std::string& key)
+        {
+            const auto current = m_current.find(key);
+
+            if (current != m_current.end())
+            {
+                fout << current->second;
+                return true;
+            }
+
+            const auto found = m_previous.find(key);
+
+            if (found == m_previous.end())
+                return false;
+
+            fout << found->second;
+
+            m_current[key] = std::move(found->second);
+            m_previous.erase(found);
+
+            return true;
+        }
+
+        void add(const std::string& key, std::string block)
+        {
+            m_current[key] = std::move(block);
+        }
+
+        // gives the blocks of the file written to the cache
+        void save()
+        {
+            m_cache.put(m_name, std::move(m_current));
+        }
+    };
+
+    void writeAc3dMesh(std::ostream& fout, const kn5::Node& node, const std::string& texture, int materialID, float uvMult, bool outputACC)
+    {
+        fout << "OBJECT poly" << std::endl;
+        fout << "name \"" << node.m_name << "\"" << std::endl;
+
+        if (outputACC)
+        {
+            fout << "texture \"" << texture << "\" base" << std::endl;
+            fout << "texture empty_texture_no_mapping tiled" << std::endl;
+            fout << "texture empty_texture_no_mapping skids" << std::endl;
+            fout << "texture empty_texture_no_mapping shad" << std::endl;
+        }
+        else
+            fout << "texture \"" << texture << "\"" << std::endl;
+
+        fout << "numvert " << node.m_vertices.size() << std::endl;
+
+        for (const auto& vertex : node.m_vertices)
+        {
+            fout << vertex.m_position[0] << " " << vertex.m_position[1] << " " << vertex.m_position[2];
+
+            if (outputACC)
+                fout << " " << vertex.m_normal[0] << " " << vertex.m_normal[1] << " " << vertex.m_normal[2];
+
+            fout << std::endl;
+        }
+
+        struct Surface
+        {
+            int m_materialID = 0;
+
+            struct Ref
+            {
+                int          m_index = 0;
+                kn5::Vec3    m_vertex = { 0, 0, 0 };
+                kn5::Vec2    m_uv = { 0, 0 };
+            };
+
+            std::array<Ref, 3>  m_refs;
+
+            bool collinearVertices() const
+            {
+                constexpr float epsilon = std::numeric_limits<float>::epsilon();
+                kn5::Vec3 v = kn5::Vec3{ m_refs[1].m_vertex - m_refs[0].m_vertex }.cross(m_refs[2].m_vertex - m_refs[0].m_vertex);
+                return std::fabs(v[0]) < epsilon &&
+                    std::fabs(v[1]) < epsilon &&
+                    std::fabs(v[2]) < epsilon;
+            }
+        };
+
+        std::list<Surface>  surfaces;
+
+        for (size_t i = 0; i < node.m_indices.size(); i += 3)
+        {
+            Surface surface;
+
+            surface.m_materialID = materialID;
+
+            for (size_t j = 0; j < 3; j++)
+            {
+                const int index = node.m_indices[i + j];
+
+                surface.m_refs[j].m_index = index;
+
+                surface.m_refs[j].m_vertex = node.m_vertices[index].m_position;
+                surface.m_refs[j].m_uv[0] = node.m_vertices[index].m_texture[0] * uvMult;
+                surface.m_refs[j].m_uv[1] = -node.m_vertices[index].m_texture[1] * uvMult;
+            }
+
+            if (surface.collinearVertices())
+            {
+                //std::cerr << "found collinear vertices" << std::endl;
+                continue;
+            }
+
+            surfaces.push_back(surface);
+        }
+
+        fout << "numsurf " << surfaces.size() << std::endl;
+        for (const auto& surface : surfaces)
+        {
+            fout << "SURF 0x10" << std::endl;
+            fout << "mat " << surface.m_materialID << std::endl;
+            fout << "refs 3" << std::endl;
+            for (const auto& ref : surface.m_refs)
+                fout << ref.m_index << " " << ref.m_uv[0] << " " << ref.m_uv[1] << std::endl;
+        }
+    }
+
+    // what the OBJECT poly block of a mesh is written from, the vertices already have the transforms applied
+    std::string getMeshKey(const kn5::Node& node, const std::string& texture, int materialID, float uvMult, bool outputACC)
+    {
+        std::string data = node.m_name + '\n' + texture + '\n' + (outputACC ? "acc\n" : "ac\n");
+
+        auto append = [&data](const void* value, size_t size)
+        {
+            data.append(static_cast<const char*>(value), size);
+        };
+
+        append(&materialID, sizeof(materialID));
+        append(&uvMult, sizeof(uvMult));
+
+        for (const auto& vertex : node.m_vertices)
+        {
+            append(vertex.m_position.data(), sizeof(vertex.m_position));
+            append(vertex.m_normal.data(), sizeof(vertex.m_normal));
+            append(vertex.m_texture.data(), sizeof(vertex.m_texture));
+        }
+
+        append(node.m_indices.data(), node.m_indices.size() * sizeof(node.m_indices[0]));
+
+        return contenthash(data.data(), data.size()).to_string();
+    }
+
+    void writeAc3dObject(const kn5& model, std::ostream& fout, const kn5::Node& node, const std::set<int>& usedMaterialIDs, bool convertToPNG, bool outputACC, bool useDiffuse, meshFile& meshes)
+    {
+        if (node.m_type == kn5::Node::Transform)
+        {
+            fout << "OBJECT group" << std::endl;
+            fout << "name \"" << node.m_name << "\"" << std::endl;
+
+            if (node.m_matrix.isRotation())
+            {
+                fout << "rot " << node.m_matrix.m_data[0][0] << " " << node.m_matrix.m_data[0][1] << " " << node.m_matrix.m_data[0][2];
+                fout << " " << node.m_matrix.m_data[1][0] << " " << node.m_matrix.m_data[1][1] << " " << node.m_matrix.m_data[1][2];
+                fout << " " << node.m_matrix.m_data[2][0] << " " << node.m_matrix.m_data[2][1] << " " << node.m_matrix.m_data[2][2] << std::endl;
+            }
+
+            if (node.m_matrix.isTranslation())
+                fout << "loc " << node.m_matrix.m_data[3][0] << " " << node.m_matrix.m_data[3][1] << " " << node.m_matrix.m_data[3][2] << std::endl;
+        }
+        else if (node.m_type == kn5::Node::Mesh || node.m_type == kn5::Node::SkinnedMesh)
+        {
+            const std::string   texture = getOutputTextureName(getTextureName(model.m_materials[node.m_materialID], useDiffuse), convertToPNG);
+            const int           materialID = getNewMaterialID(node.m_materialID, usedMaterialIDs);
+            const float         uvMult = kn5model::getUVMultiplier(model.m_materials[node.m_materialID], useDiffuse);
+            const std::string   key = getMeshKey(node, texture, materialID, uvMult, outputACC);
+
+            if (!meshes.write(fout, key))
+            {
+                std::ostringstream block;
+
+                writeAc3dMesh(block, node, texture, materialID, uvMult, outputACC);
+
+                std::string text = block.str();
+
+                fout << text;
+
+                meshes.add(key, std::move(text));
+            }
+        }
+        else
+            return;
+
+        fout << "kids " << node.m_children.size() << std::endl;
+
+        for (const auto& child : node.m_children)
+            writeAc3dObject(model, fout, child, usedMaterialIDs, convertToPNG, outputACC, useDiffuse, meshes);
+    }
+
+    void getUsedMaterials(const kn5::Node& node, std::set<int>& usedMaterialIDs)
+    {
+        if (node.m_type != kn5::Node::Transform)
+            usedMaterialIDs.insert(node.m_materialID);
+
+        for (const auto& child : node.m_children)
+            getUsedMaterials(child, usedMaterialIDs);
+    }
+
+    void writeAc3d(const kn5& model, const std::string& file, const kn5::Node& node, bool convertToPNG, bool outputACC, bool useDiffuse, meshCache& cache)
+    {
+        std::set<int>   usedMaterialIDs;
+
+        getUsedMaterials(node, usedMaterialIDs);
+
+        meshFile        meshes(cache, file);
+        std::ofstream   fout(file);
+
+        if (fout)
+        {
+            fout << "AC3Db" << std::endl;
+
+            writeAc3dMaterials(model, fout, node, usedMaterialIDs);
+
+            fout << "OBJECT world" << std::endl;
+            fout << "kids 1" << std::endl;
+
+            writeAc3dObject(model, fout, node, usedMaterialIDs, convertToPNG, outputACC, useDiffuse, meshes);
+
+            fout.close();
+
+            meshes.save();
+        }
+    }
+
+    void writeAc3d(const kn5& model, const std::string& file, bool convertToPNG, bool outputACC, bool useDiffuse, meshCache& cache)
+    {
+        writeAc3d(model, file, model.m_node, convertToPNG, outputACC, useDiffuse, cache);
+    }
+
+    void appendJson(std::string& json, const std::string& string)
+    {
+        json += '"';
+
+        for (const char c : string)
+        {
+            if (c == '"' || c == '\\')
+            {
+                json += '\\';
+                json += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char escape[8];
+                snprintf(escape, sizeof(escape), "\\u%04x", c);
+                json += escape;
+            }
+            else
+                json += c;
+        }
+
+        json += '"';
+    }
+
+    void appendJson(std::string& json, float value)
+    {
+        char buffer[32];
+
+        if (!std::isfinite(value))
+            value = 0.0f;
+
+        const std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+
+        json.append(buffer, result.ptr);
+    }
+
+    void appendJson(std::string& json, size_t value)
+    {
+        json += std::to_string(value);
+    }
+
+    void appendJson(std::string& json, const kn5::Matrix& matrix)
+    {
+        // kn5 matrices are row vector matrices which is the same memory layout as glTF column major matrices
+        json += '[';
+
+        for (size_t i = 0; i < 16; i++)
+        {
+            if (i != 0)
+                json += ',';
+
+            appendJson(json, matrix.m_data[i / 4][i % 4]);
+        }
+
+        json += ']';
+    }
+
+    class glbWriter
+    {
+    public:
+        glbWriter(const kn5& model, const kn5& textureModel, bool convertToPNG, bool useDiffuse, bool embedTextures) :
+            m_model(model),
+            m_textureModel(textureModel),
+            m_convertToPNG(convertToPNG),
+            m_useDiffuse(useDiffuse),
+            m_embedTextures(embedTextures)
+        {
+        }
+
+        void write(const std::string& file, const kn5::Node& node, const kn5::Matrix& root)
+        {
+            // the vertices and indices are packed into a single vertex and a single index buffer view
+            // so a loader can upload each of them with one copy
+            const size_t rootIndex = addNode(node);
+
+            if (!root.isIdentity())
+            {
+                m_nodes.emplace_back();
+
+                std::string& json = m_nodes.back();
+
+                json = "{\"name\":\"world\",\"matrix\":";
+                appendJson(json, root);
+                json += ",\"children\":[";
+                appendJson(json, rootIndex);
+                json += "]}";
+            }
+
+            const size_t sceneIndex = m_nodes.size() - 1;
+            const size_t indicesOffset = m_vertices.size();
+
+            m_binary = std::move(m_vertices);
+            m_binary.insert(m_binary.end(), m_indices.begin(), m_indices.end());
+            m_binary.resize(align(m_binary.size()), 0);
+
+            const std::string           materialsJson = materials();
+            std::vector<std::string>    bufferViews;
+            bool                        usesDDS = false;
+
+            if (indicesOffset != 0)
+                bufferViews.push_back("{\"buffer\":0,\"byteOffset\":0,\"byteLength\":" + std::to_string(indicesOffset) + ",\"byteStride\":" + std::to_string(sizeof(Vertex)) + ",\"target\":34962}");
+
+            if (!m_indices.empty())
+                bufferViews.push_back("{\"buffer\":0,\"byteOffset\":" + std::to_string(indicesOffset) + ",\"byteLength\":" + std::to_string(m_indices.size()) + ",\"target\":34963}");
+
+            std::string images;
+            std::string textures;
+
+            for (size_t i = 0; i < m_images.size(); i++)
+            {
+                const std::string&  name = m_images[i];
+                const bool          dds = isDDS(getOutputTextureName(name, m_convertToPNG));
+                const kn5::Texture* texture = m_embedTextures ? findTexture(name) : nullptr;
+
+                if (i != 0)
+                {
+                    images += ',';
+                    textures += ',';
+                }
+
+                images += "{\"name\":";
+                appendJson(images, name);
+
+                if (texture)
+                {
+                    const bool embeddedDDS = isDDS(name);
+
+                    images += ",\"bufferView\":" + std::to_string(bufferViews.size());
+                    images += embeddedDDS ? ",\"mimeType\":\"image/vnd-ms.dds\"}" : (isJPEG(name) ? ",\"mimeType\":\"image/jpeg\"}" : ",\"mimeType\":\"image/png\"}");
+
+                    bufferViews.push_back("{\"buffer\":0,\"byteOffset\":" + std::to_string(m_binary.size()) + ",\"byteLength\":" + std::to_string(texture->m_data.size()) + "}");
+
+                    m_binary.insert(m_binary.end(), texture->m_data.begin(), texture->m_data.end());
+                    m_binary.resize(align(m_binary.size()), 0);
+
+                    if (embeddedDDS)
+                    {
+                        textures += "{\"sampler\":0,\"extensions\":{\"MSFT_texture_dds\":{\"source\":" + std::to_string(i) + "}}}";
+                        usesDDS = true;
+
+                        continue;
+                    }
+                }
+                else
+                {
+                    images += ",\"uri\":";
+                    appendJson(images, getOutputTextureName(name, m_convertToPNG));
+                    images += '}';
+
+                    if (dds)
+                    {
+                        textures += "{\"sampler\":0,\"extensions\":{\"MSFT_texture_dds\":{\"source\":" + std::to_string(i) + "}}}";
+                        usesDDS = true;
+
+                        continue;
+                    }
+                }
+
+                textures += "{\"sampler\":0,\"source\":" + std::to_string(i) + "}";
+            }
+
+            std::string json = "{\"asset\":{\"version\":\"2.0\",\"generator\":\"kn5toac\"}";
+
+            if (usesDDS)
+                json += ",\"extensionsUsed\":[\"MSFT_texture_dds\"],\"extensionsRequired\":[\"MSFT_texture_dds\"]";
+
+            json += ",\"scene\":0,\"scenes\":[{\"nodes\":[" + std::to_string(sceneIndex) + "]}]";
+            json += ",\"nodes\":[" + join(m_nodes) + "]";
+
+            if (!m_meshes.empty())
+                json += ",\"meshes\":[" + join(m_meshes) + "]";
+
+            if (!m_accessors.empty())
+                json += ",\"accessors\":[" + join(m_accessors) + "]";
+
+            if (!m_materialIDs.empty())
+                json += ",\"materials\":[" + materialsJson + "]";
+
+            if (!m_images.empty())
+            {
+                json += ",\"samplers\":[{\"magFilter\":9729,\"minFilter\":9987,\"wrapS\":10497,\"wrapT\":10497}]";
+                json += ",\"images\":[" + images + "]";
+                json += ",\"textures\":[" + textures + "]";
+            }
+
+            if (!bufferViews.empty())
+            {
+                json += ",\"bufferViews\":[" + join(bufferViews) + "]";
+                json += ",\"buffers\":[{\"byteLength\":" + std::to_string(m_binary.size()) + "}]";
+            }
+
+            json += '}';
+            json.resize(align(json.size()), ' ');
+
+            std::ofstream   fout(file, std::ios::binary);
+
+            if (!fout)
+                throw std::runtime_error("Couldn't create: " + file);
+
+            const uint32_t  jsonLength = static_cast<uint32_t>(json.size());
+            const uint32_t  binaryLength = static_cast<uint32_t>(m_binary.size());
+            const uint32_t  header[3] = { 0x46546C67, 2, static_cast<uint32_t>(12 + 8 + jsonLength + (binaryLength ? 8 + binaryLength : 0)) };
+            const uint32_t  jsonChunk[2] = { jsonLength, 0x4E4F534A };
+            const uint32_t  binaryChunk[2] = { binaryLength, 0x004E4942 };
+
+            fout.write(reinterpret_cast<const char*>(header), sizeof(header));
+            fout.write(reinterpret_cast<const char*>(jsonChunk), sizeof(jsonChunk));
+            fout.write(json.data(), json.size());
+
+            if (binaryLength)
+            {
+                fout.write(reinterpret_cast<const char*>(binaryChunk), sizeof(binaryChunk));
+                fout.write(m_binary.data(), m_binary.size());
+            }
+
+            fout.close();
+        }
+
+    private:
+        using Vertex = kn5model::Vertex;
+
+        static_assert(sizeof(Vertex) == 32, "glb vertex must be tightly packed");
+
+        const kn5&                  m_model;
+        const kn5&                  m_textureModel;
+        bool                        m_convertToPNG = false;
+        bool                        m_useDiffuse = false;
+        bool                        m_embedTextures = false;
+        std::vector<std::string>    m_nodes;
+        std::vector<std::string>    m_meshes;
+        std::vector<std::string>    m_accessors;
+        std::vector<int>            m_materialIDs;
+        std::vector<std::string>    m_images;
+        std::vector<char>           m_vertices;
+        std::vector<char>           m_indices;
+        std::vector<char>           m_binary;
+
+        static size_t align(size_t size)
+        {
+            return (size + 3) & ~static_cast<size_t>(3);
+        }
+
+        static bool isDDS(const std::string& name)
+        {
+            return name.find(".dds") != std::string::npos || name.find(".DDS") != std::string::npos;
+        }
+
+        static bool isJPEG(const std::string& name)
+        {
+            return name.find(".jpg") != std::string::npos || name.find(".JPG") != std::string::npos ||
+                   name.find(".jpeg") != std::string::npos || name.find(".JPEG") != std::string::npos;
+        }
+
+        static std::string join(const std::vector<std::string>& strings)
+        {
+            std::string joined;
+
+            for (size_t i = 0; i < strings.size(); i++)
+            {
+                if (i != 0)
+                    joined += ',';
+
+                joined += strings[i];
+            }
+
+            return joined;
+        }
+
+        const kn5::Texture* findTexture(const std::string& name) const
+        {
+            for (const auto& texture : m_textureModel.m_textures)
+            {
+                if (texture.m_name == name)
+                    return &texture;
+            }
+
+            for (const auto& texture : m_model.m_textures)
+            {
+                if (texture.m_name == name)
+                    return &texture;
+            }
+
+            return nullptr;
+        }
+
+        size_t getIndex(std::vector<int>& ids, int id)
+        {
+            std::vector<int>::const_iterator it = std::find(ids.begin(), ids.end(), id);
+
+            if (it != ids.end())
+                return it - ids.begin();
+
+            ids.push_back(id);
+
+            return ids.size() - 1;
+        }
+
+        size_t getImage(const std::string& name)
+        {
+            std::vector<std::string>::const_iterator it = std::find(m_images.begin(), m_images.end(), name);
+
+            if (it != m_images.end())
+                return it - m_images.begin();
+
+            m_images.push_back(name);
+
+            return m_images.size() - 1;
+        }
+
+        std::string materials()
+        {
+            std::string json;
+
+            for (size_t i = 0; i < m_materialIDs.size(); i++)
+            {
+                const kn5::Material& material = m_model.m_materials[m_materialIDs[i]];
+
+                if (i != 0)
+                    json += ',';
+
+                json += "{\"name\":";
+                appendJson(json, material.m_name);
+                json += ",\"pbrMetallicRoughness\":{\"baseColorFactor\":[";
+
+                const kn5::ShaderProperty* property = material.findShaderProperty("ksDiffuse");
+                const float rgb = property ? std::clamp(property->m_value, 0.0f, 1.0f) : 1.0f;
+
+                appendJson(json, rgb);
+                json += ',';
+                appendJson(json, rgb);
+                json += ',';
+                appendJson(json, rgb);
+                json += ",1],\"metallicFactor\":0,\"roughnessFactor\":1";
+
+                if (material.findTextureMapping("txDiffuse"))
+                    json += ",\"baseColorTexture\":{\"index\":" + std::to_string(getImage(getTextureName(material, m_useDiffuse))) + "}";
+
+                json += '}';
+
+                if (material.m_alphaBlendMode == kn5::Material::AlphaBlend)
+                    json += ",\"alphaMode\":\"BLEND\"";
+                else if (material.m_alphaTested)
+                {
+                    property = material.findShaderProperty("ksAlphaRef");
+
+                    json += ",\"alphaMode\":\"MASK\",\"alphaCutoff\":";
+                    appendJson(json, property ? std::clamp(property->m_value, 0.0f, 1.0f) : 0.5f);
+                }
+
+                json += '}';
+            }
+
+            return json;
+        }
+
+        size_t addMesh(const kn5::Node& node)
+        {
+            const size_t        vertexOffset = m_vertices.size();
+            const size_t        indexOffset = m_indices.size();
+            const kn5::Material& material = m_model.m_materials[node.m_materialID];
+            const float         uvMult = material.findTextureMapping("txDiffuse") ? kn5model::getUVMultiplier(material, m_useDiffuse) : 1.0f;
+            kn5::Vec3           minimum = node.m_vertices[0].m_position;
+            kn5::Vec3           maximum = node.m_vertices[0].m_position;
+
+            for (const auto& vertex : node.m_vertices)
+            {
+                for (size_t i = 0; i < 3; i++)
+                {
+                    minimum[i] = std::min(minimum[i], vertex.m_position[i]);
+                    maximum[i] = std::max(maximum[i], vertex.m_position[i]);
+                }
+            }
+
+            // glTF and kn5 both have the texture origin in the upper left corner
+            m_vertices.resize(vertexOffset + node.m_vertices.size() * sizeof(Vertex));
+            kn5model::interleave(node, kn5::Matrix(), uvMult, reinterpret_cast<Vertex*>(m_vertices.data() + vertexOffset));
+
+            m_indices.resize(indexOffset + node.m_indices.size() * sizeof(uint16_t));
+            std::memcpy(m_indices.data() + indexOffset, node.m_indices.data(), node.m_indices.size() * sizeof(uint16_t));
+
+            const size_t position = m_accessors.size();
+            const std::string count = std::to_string(node.m_vertices.size());
+
+            std::string json = "{\"bufferView\":0,\"byteOffset\":" + std::to_string(vertexOffset) + ",\"componentType\":5126,\"count\":" + count + ",\"type\":\"VEC3\",\"min\":[";
+            appendJson(json, minimum[0]);
+            json += ',';
+            appendJson(json, minimum[1]);
+            json += ',';
+            appendJson(json, minimum[2]);
+            json += "],\"max\":[";
+            appendJson(json, maximum[0]);
+            json += ',';
+            appendJson(json, maximum[1]);
+            json += ',';
+            appendJson(json, maximum[2]);
+            json += "]}";
+            m_accessors.push_back(json);
+
+            m_accessors.push_back("{\"bufferView\":0,\"byteOffset\":" + std::to_string(vertexOffset + offsetof(Vertex, m_normal)) + ",\"componentType\":5126,\"count\":" + count + ",\"type\":\"VEC3\"}");
+            m_accessors.push_back("{\"bufferView\":0,\"byteOffset\":" + std::to_string(vertexOffset + offsetof(Vertex, m_uv)) + ",\"componentType\":5126,\"count\":" + count + ",\"type\":\"VEC2\"}");
+            m_accessors.push_back("{\"bufferView\":1,\"byteOffset\":" + std::to_string(indexOffset) + ",\"componentType\":5123,\"count\":" + std::to_string(node.m_indices.size()) + ",\"type\":\"SCALAR\"}");
+
+            json = "{\"name\":";
+            appendJson(json, node.m_name);
+            json += ",\"primitives\":[{\"attributes\":{\"POSITION\":" + std::to_string(position) +
+                    ",\"NORMAL\":" + std::to_string(position + 1) +
+                    ",\"TEXCOORD_0\":" + std::to_string(position + 2) +
+                    "},\"indices\":" + std::to_string(position + 3) +
+                    ",\"material\":" + std::to_string(getIndex(m_materialIDs, node.m_materialID)) + "}]}";
+            m_meshes.push_back(json);
+
+            return m_meshes.size() - 1;
+        }
+
+        size_t addNode(const kn5::Node& node)
+        {
+            std::vector<size_t> children;
+
+            for (const auto& child : node.m_children)
+                children.push_back(addNode(child));
+
+            std::string json = "{\"name\":";
+            appendJson(json, node.m_name);
+
+            if (node.m_type == kn5::Node::Transform)
+            {
+                if (!node.m_matrix.isIdentity())
+                {
+                    json += ",\"matrix\":";
+                    appendJson(json, node.m_matrix);
+                }
+            }
+            else if (!node.m_vertices.empty() && !node.m_indices.empty())
+                json += ",\"mesh\":" + std::to_string(addMesh(node));
+
+            if (!children.empty())
+            {
+                json += ",\"children\":[";
+
+                for (size_t i = 0; i < children.size(); i++)
+                {
+                    if (i != 0)
+                        json += ',';
+
+                    appendJson(json, children[i]);
+                }
+
+                json += ']';
+            }
+
+            json += '}';
+
+            m_nodes.push_back(json);
+
+            return m_nodes.size() - 1;
+        }
+    };
+
+    void writeGlb(const kn5& model, const kn5& textureModel, const std::string& file, const kn5::Node& node, const kn5::Matrix& root, bool convertToPNG, bool useDiffuse, bool embedTextures)
+    {
+        glbWriter(model, textureModel, convertToPNG, useDiffuse, embedTextures).write(file, node, root);
+    }
+
+    kn5::Matrix getGlbRoot(const kn5::Matrix& xform)
+    {
+        // glTF is y up so the root node undoes the rotation to the Speed Dreams z up coordinate system
+        kn5::Matrix root;
+
+        for (size_t i = 0; i < 3; i++)
+        {
+            for (size_t j = 0; j < 3; j++)
+                root.m_data[i][j] = xform.m_data[j][i];
+        }
+
+        return root;
+    }
+
+    bool extract(kn5& model, const std::string& name, const kn5::Matrix& xform, const std::string& file, bool outputGLB, bool embedTextures, std::set<std::string>& usedTextures, meshCache& meshes)
+    {
+        kn5::Node* transformNode = model.findNode(kn5::Node::Transform, name);
+
+        if (transformNode == nullptr)
+            return false;
+
+        kn5::Node   node = *transformNode;
+
+        node.m_matrix.makeIdentity();
+
+        node.removeInactiveNodes();
+        node.transform(xform);
+
+        writeAc3d(model, file, node, true, file.find(".acc") != std::string::npos, true, meshes);
+
+        getUsedTextures(model, node, true, usedTextures);
+
+        if (outputGLB)
+            writeGlb(model, model, std::filesystem::path(file).replace_extension(".glb").string(), node, getGlbRoot(xform), true, true, embedTextures);
+
+        if (transformNode->m_parent)
+            transformNode->m_parent->removeChild(transformNode);
+
+        return true;
+    }
+
+    // the command line options shared by every car
+    struct Options
+    {
+        bool            m_writeModel = false;
+        bool            m_dumpModel = false;
+        bool            m_writeTextures = false;
+        bool            m_convertToPNG = false;
+        bool            m_deleteDDS = true;
+        bool            m_outputACC = false;
+        bool            m_useDiffuse = false;
+        bool            m_extractCarParts = false;
+        bool            m_writeCarConfig = false;
+        bool            m_dumpCollider = false;
+        bool            m_writeCmake = false;
+        bool            m_writeData = false;
+        bool            m_writeDriver = false;
+        bool            m_dumpInputDriver = false;
+        bool            m_dumpDriverKnh = false;
+        bool            m_cockpitLR = true;
+        bool            m_dumpModelHierarchy = true;
+        bool            m_outputGLB = false;
+        bool            m_embedTextures = false;
+        unsigned int    m_jobCount = 0;
+        deflate::Level  m_pngLevel = deflate::Default;
+        uint32_t        m_maxTextureSize = 0;
+        bool            m_bakeTextures = false;
+        bool            m_packTextures = false;
+        std::string     m_category;
+        std::string     m_outputDirectory;
+        std::string     m_driverDirectory;
+        bool            m_rebuild = false;
+    };
+
+    // the options changing what is written, so a change writes everything again
+    std::string getOptionsKey(const Options& options)
+    {
+        const bool flags[] = { options.m_writeModel, options.m_dumpModel, options.m_writeTextures, options.m_convertToPNG, options.m_deleteDDS,
+                               options.m_outputACC, options.m_useDiffuse, options.m_extractCarParts, options.m_writeCarConfig, options.m_dumpCollider,
+                               options.m_writeCmake, options.m_writeData, options.m_writeDriver, options.m_dumpInputDriver, options.m_dumpDriverKnh,
+                               options.m_cockpitLR, options.m_dumpModelHierarchy, options.m_outputGLB, options.m_embedTextures, options.m_bakeTextures,
+                               options.m_packTextures };
+        std::string key;
+
+        for (const bool flag : flags)
+            key += flag ? '1' : '0';
+
+        key += '\n' + std::to_string(options.m_pngLevel) + '\n' + std::to_string(options.m_maxTextureSize) + '\n' + options.m_category + '\n' + options.m_driverDirectory + '\n';
+
+        return key;
+    }
+
+    // the key of a target from its options and the hashes of the files it is made from
+    std::string getTargetKey(manifest& built, const std::string& target, const std::string& options, const std::vector<std::filesystem::path>& files)
+    {
+        std::string key = target + '\n' + options;
+
+        for (const auto& file : files)
+            key += file.string() + ' ' + built.hash(file.string()) + '\n';
+
+        return contenthash(key.data(), key.size()).to_string();
+    }
+
+    // an empty file name uses the kn5 named like the directory and an empty skin file name doesn't write the skins
+    struct Car
+    {
+        std::string m_inputDirectory;
+        std::string m_inputFileName;
+        std::string m_skinFileName;
+    };
+
+    // The driver models read once for all the cars they drive, transformed like the cars.
+    // A driver is found by its path and the hash of its kn5 file, so a file replaced during a run is read again.
+    class driverModels
+    {
+    public:
+        struct Driver
+        {
+            kn5         m_model;
+            std::string m_hash; // of the kn5 file
+            std::string m_dump; // of the model as it was read, when asked for
+        };
+
+    private:
+        struct Entry
+        {
+            std::once_flag  m_read;
+            Driver          m_driver;
+        };
+
+        std::mutex                                      m_mutex;
+        std::map<std::string, std::unique_ptr<Entry>>   m_drivers;
+
+    public:
+        // hash is the content hash of the kn5 file
+        const Driver& get(const std::filesystem::path& path, const std::string& hash, const kn5::Matrix& xform, bool dump)
+        {
+            Entry* entry;
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                // the cars find the drivers relative to their own directories
+                std::unique_ptr<Entry>& found = m_drivers[std::filesystem::weakly_canonical(path).string() + '\n' + hash];
+
+                if (!found)
+                    found = std::make_unique<Entry>();
+
+                entry = found.get();
+            }
+
+            std::call_once(entry->m_read, [&]()
+            {
+                Driver& driver = entry->m_driver;
+
+                // a failed read is tried again by the next car
+                driver = Driver();
+
+                try
+                {
+                    driver.m_model.read(path.string());
+                }
+                catch (std::ifstream::failure& e)
+                {
+                    throw std::runtime_error("Error reading: " + path.string() + " : " + e.code().message());
+                }
+                catch (std::runtime_error& e)
+                {
+                    throw std::runtime_error("Error reading: " + path.string() + " : " + e.what());
+                }
+
+                driver.m_hash = hash;
+
+                if (dump)
+                {
+                    std::ostringstream os;
+
+                    driver.m_model.dump(os);
+
+                    driver.m_dump = os.str();
+                }
+
+                // TODO: position driver from knh file
+
+                driver.m_model.removeInactiveNodes();
+                driver.m_model.transform(xform);
+                driver.m_model.removeEmptyNodes();
+            });
+
+            return entry->m_driver;
+        }
+    };
+
+    // what the cars converted in one run share
+    struct Shared
+    {
+        const assetstore*   m_store = nullptr;
+        convertedFiles      m_files;
+        driverModels        m_drivers;
+        bool                m_shareTextures = false;    // the textures of one car are converted on every thread instead
+    };
+
+    // converts one car using the threads of pool, throws when the car can't be converted
+    // returns the number of textures and skins that couldn't be converted
+    size_t convertCar(const Options& options, const Car& car, jobs& pool, Shared& shared)
+    {
+        std::filesystem::path   inputPath(car.m_inputDirectory);
+        std::filesystem::path   outputPath(options.m_outputDirectory);
+
+        const std::string       inputFileDirectoryName(inputPath.filename().string());
+
+        outputPath.append(inputFileDirectoryName);
+
+        // create the output directory if it doesn't exixt
+        if (!std::filesystem::exists(outputPath))
+        {
+            if (!std::filesystem::create_directory(outputPath))
+                throw std::runtime_error("Couldn't create: " + outputPath.string());
+        }
+
+        // use the data directory in the input directory if it exists
+        std::filesystem::path   dataDirectoryPath = inputPath;
+
+        dataDirectoryPath.append("data");
+
+        datasource  carData(dataDirectoryPath.string());
+
+        if (!std::filesystem::exists(dataDirectoryPath))
+        {
+            // otherwise read the ini files from the data.acd file in memory
+            std::filesystem::path acdPath = inputPath;
+
+            acdPath.append("data.acd");
+
+            if (std::filesystem::exists(acdPath))
+            {
+                auto archive = std::make_shared<acd>(acdPath.string());
+
+                // write the ini files to the output data directory for inspection
+                if (options.m_writeData)
+                {
+                    std::filesystem::path outputDataPath = outputPath;
+
+                    outputDataPath.append("data");
+
+                    if (!std::filesystem::exists(outputDataPath))
+                        std::filesystem::create_directory(outputDataPath);
+
+                    archive->writeEntries(outputDataPath.string());
+                }
+
+                carData = datasource(archive, acdPath.string());
+            }
+        }
+
+        // every ini and lut file is read once and shared by the steps below
+        const carconfig config(carData, pool);
+
+        // textures are only in lod 0 file
+        std::string lod0FileName = config.get(carconfig::Lods).getValue("LOD_0", "FILE");
+        std::string inputFileName = car.m_inputFileName;
+
+        // the model named like the directory, otherwise lod 0
+        if (inputFileName.empty())
+        {
+            inputFileName = inputFileDirectoryName + ".kn5";
+
+            if (!std::filesystem::exists(inputPath / inputFileName) && !lod0FileName.empty())
+                inputFileName = lod0FileName;
+        }
+
+        std::filesystem::path   driverGraphicsPath; // = "C:\\Program Files (x86)\\Steam\\steamapps\\common\\assettocorsa\\content\\driver";
+        std::string             driverFileName;
+
+        if (options.m_writeDriver && config.has(carconfig::Driver3d))
+        {
+            const ini& driver3d = config.get(carconfig::Driver3d);
+
+            driverFileName = driver3d.getValue("MODEL", "NAME");
+
+            driverFileName += ".kn5";
+
+            if (options.m_driverDirectory.empty())
+            {
+                // assume assetto corsa directory structure
+                driverGraphicsPath = inputPath;
+                driverGraphicsPath.append("../../driver");
+            }
+            else
+                driverGraphicsPath = options.m_driverDirectory;
+
+            driverGraphicsPath.append(driverFileName);
+        }
+
+        // only the targets whose inputs or options changed since the last conversion are written again
+        if (options.m_rebuild)
+            std::filesystem::remove(outputPath / manifest::FileName);
+
+        manifest    built(outputPath.string());
+        meshCache   meshes(outputPath.string(), options.m_rebuild);
+
+        const std::string optionsKey = getOptionsKey(options);
+        const std::string filesKey = optionsKey + inputFileName + '\n' + lod0FileName + '\n' + car.m_skinFileName + '\n';
+
+        std::vector<std::filesystem::path> dataFiles;
+
+        if (std::filesystem::exists(dataDirectoryPath))
+        {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(dataDirectoryPath))
+            {
+                if (entry.is_regular_file())
+                    dataFiles.push_back(entry.path());
+            }
+
+            std::sort(dataFiles.begin(), dataFiles.end());
+        }
+        else
+            dataFiles.push_back(inputPath / "data.acd");
+
+        std::vector<std::filesystem::path> configFiles(dataFiles);
+
+        configFiles.push_back(inputPath / inputFileName);
+        configFiles.push_back(inputPath / lod0FileName);
+
+        std::vector<std::filesystem::path> modelFiles(configFiles);
+
+        configFiles.push_back(inputPath / "collider.kn5");
+
+        if (!driverFileName.empty())
+        {
+            modelFiles.push_back(driverGraphicsPath);
+            modelFiles.push_back(inputPath / "driver_base_pos.knh");
+        }
+
+        const std::string configKey = getTargetKey(built, "config", filesKey, configFiles);
+        const std::string modelKey = getTargetKey(built, "model", filesKey, modelFiles);
+        const std::string cmakeKey = getTargetKey(built, "cmake", optionsKey, {});
+
+        const bool  buildConfig = !built.isCurrent("config", configKey);
+        const bool  buildModel = !built.isCurrent("model", modelKey) || !built.isCurrent("textures", modelKey);
+        const bool  buildCmake = !built.isCurrent("cmake", cmakeKey);
+
+        kn5 lod0model;
+        kn5 model;
+        kn5 driverModel;
+        bool hasDriver = false;
+
+        // textures are only written when something uses them
+        std::set<std::string>   usedTextures;
+
+        // the collider size
+        float length = 0;
+        float width = 0;
+        float height = 0;
+
+        // declared after the models so the queued jobs finish before the models are destroyed
+        textureWriter textures(options.m_convertToPNG, options.m_deleteDDS, pool, options.m_pngLevel);
+
+        textures.setMaxSize(options.m_maxTextureSize);
+        textures.setBake(options.m_bakeTextures);
+        textures.setStore(shared.m_store);
+        if (shared.m_shareTextures)
+            textures.setConvertedFiles(&shared.m_files);
+        textures.setManifest(&built);
+
+        kn5::Matrix xform;
+
+        xform.m_data[0][0] = 0;
+        xform.m_data[0][1] = 0;
+        xform.m_data[0][2] = -1;
+        xform.m_data[0][3] = 0;
+
+        xform.m_data[1][0] = 0;
+        xform.m_data[1][1] = 1;
+        xform.m_data[1][2] = 0;
+        xform.m_data[1][3] = 0;
+
+        xform.m_data[2][0] = 1;
+        xform.m_data[2][1] = 0;
+        xform.m_data[2][2] = 0;
+        xform.m_data[2][3] = 0;
+
+        xform.m_data[3][0] = 0;
+        xform.m_data[3][1] = 0;
+        xform.m_data[3][2] = 0;
+        xform.m_data[3][3] = 1;
+
+        const bool  separateLod0 = inputFileName != lod0FileName;
+
+        // the stages run as soon as the stages they use are done. The stages that prepare and write textures depend on each
+        // other, so the textures are prepared in the same order as before and get the same names. "write skins" runs
+        // alongside them: writeSkin only adds a job to m_jobs, whose add locks the pool, and the job only uses m_manifest,
+        // which locks itself, m_store, which only has const methods, and the options set before the stages run
+        taskgraph   stages(pool);
+
+        const taskgraph::Task readLod0 = stages.add("read " + lod0FileName, [&]()
+        {
+            if (!separateLod0 || (!buildModel && !buildConfig))
+                return;
+
+            // get the textures from lod 0
+            std::filesystem::path   lod0FilePath = inputPath;
+
+            lod0FilePath.append(lod0FileName);
+
+            std::string lod0FilePathString = lod0FilePath.string();
+
+            try
+            {
+                lod0model.read(lod0FilePathString);
+            }
+            catch (std::ifstream::failure& e)
+            {
+                throw std::runtime_error("Error reading: " + lod0FilePathString + " : " + e.code().message());
+            }
+            catch (std::runtime_error& e)
+            {
+                throw std::runtime_error("Error reading: " + lod0FilePathString + " : " + e.what());
+            }
+        });
+
+        const taskgraph::Task readModel = stages.add("read " + inputFileName, [&]()
+        {
+            if (!buildModel && !buildConfig)
+                return;
+
+            std::filesystem::path   inputFilePath(inputPath);
+
+            inputFilePath.append(inputFileName);
+
+            try
+            {
+                model.read(inputFilePath.string());
+            }
+            catch (std::ifstream::failure& e)
+            {
+                throw std::runtime_error("Error reading: " + inputFilePath.string() + " : " + e.code().message());
+            }
+            catch (std::runtime_error& e)
+            {
+                throw std::runtime_error("Error reading: " + inputFilePath.string() + " : " + e.what());
+            }
+        });
+
+        const taskgraph::Task prepareLod0 = stages.add("prepare " + lod0FileName, [&]()
+        {
+            if (!separateLod0 || !buildModel)
+                return;
+
+            // rename skin texture
+            if (!car.m_skinFileName.empty())
+                renameSkin(lod0model, car.m_skinFileName, inputFileDirectoryName, textures);
+
+            textures.prepare(lod0model, outputPath.string());
+
+            if (options.m_dumpModel)
+            {
+                std::filesystem::path dumpFilePath = outputPath;
+
+                dumpFilePath.append(lod0FileName + ".dump");
+
+                std::ofstream of(dumpFilePath.string());
+
+                if (of)
+                    lod0model.dump(of);
+
+                of.close();
+            }
+
+            if (options.m_dumpModelHierarchy)
+            {
+                std::filesystem::path dumpFilePath = outputPath;
+
+                dumpFilePath.append(lod0FileName + ".hierarchy.dump");
+
+                std::ofstream of(dumpFilePath.string());
+
+                if (of)
+                    lod0model.dumpHierarchy(of);
+
+                of.close();
+            }
+        }, { readLod0 });
+
+        // after lod 0 because the hierarchy dumps have the same name
+        const taskgraph::Task prepareModel = stages.add("prepare " + inputFileName, [&]()
+        {
+            if (!buildModel)
+                return;
+
+            if (options.m_dumpModel)
+            {
+                std::filesystem::path dumpFilePath = outputPath;
+
+                dumpFilePath.append(inputFileName + ".dump");
+
+                std::ofstream of(dumpFilePath.string());
+
+                if (of)
+                    model.dump(of);
+            }
+
+            if (options.m_dumpModelHierarchy)
+            {
+                std::filesystem::path dumpFilePath = outputPath;
+
+                dumpFilePath.append(lod0FileName + ".hierarchy.dump");
+
+                std::ofstream of(dumpFilePath.string());
+
+                if (of)
+                    model.dumpHierarchy(of);
+
+                of.close();
+            }
+
+            if (options.m_writeModel)
+            {
+                // rename skin texture
+                if (!car.m_skinFileName.empty())
+                    renameSkin(model, car.m_skinFileName, inputFileDirectoryName, textures);
+
+                // identical textures are renamed before any part of the model is written
+                if (options.m_writeTextures)
+                    textures.prepare(model, outputPath.string());
+            }
+        }, { readModel, prepareLod0 });
+
+        const taskgraph::Task readCollider = stages.add("read collider.kn5", [&]()
+        {
+            if (!options.m_writeCarConfig || !buildConfig)
+                return;
+
+            std::filesystem::path   colliderFilePath = inputPath;
+
+            colliderFilePath.append("collider.kn5");
+
+            kn5 collider;
+
+            try
+            {
+                collider.read(colliderFilePath.string());
+            }
+            catch (std::ifstream::failure& e)
+            {
+                throw std::runtime_error("Error reading: " + colliderFilePath.string() + " : " + e.code().message());
+            }
+            catch (std::runtime_error& e)
+            {
+                throw std::runtime_error("Error reading: " + colliderFilePath.string() + " : " + e.what());
+            }
+
+            if (options.m_dumpCollider)
+            {
+                std::filesystem::path dumpFilePath = outputPath;
+
+                dumpFilePath.append("collider.kn5.dump");
+
+                std::ofstream of1(dumpFilePath.string());
+
+                if (of1)
+                    collider.dump(of1);
+            }
+
+            kn5::Vec3 minimum = { 100000, 100000, 100000 };
+            kn5::Vec3 maximum = { -100000, -100000, -100000 };
+
+            kn5::Node& mesh = collider.m_node;
+            while (mesh.m_type == kn5::Node::Transform && mesh.m_children.size() == 1)
+                mesh = mesh.m_children[0];
+
+            if (mesh.m_type == kn5::Node::Mesh)
+            {
+                for (const auto& vertex : mesh.m_vertices)
+                {
+                    for (size_t i = 0; i < 3; i++)
+                    {
+                        if (vertex.m_position[i] < minimum[i])
+                            minimum[i] = vertex.m_position[i];
+
+                        if (vertex.m_position[i] > maximum[i])
+                            maximum[i] = vertex.m_position[i];
+                    }
+                }
+            }
+
+            length = maximum[2] - minimum[2];
+            width = maximum[0] - minimum[0];
+            height = maximum[1] - minimum[1];
+        });
+
+        // before the model is changed, it only looks at the nodes so it can run while the textures are prepared
+        const taskgraph::Task writeCarConfig = stages.add("write " + inputFileDirectoryName + ".xml", [&]()
+        {
+            if (!options.m_writeCarConfig || !buildConfig)
+                return;
+
+            std::filesystem::path   configFilePath = outputPath;
+
+            configFilePath.append(inputFileDirectoryName + ".xml");
+
+            try
+            {
+                writeConfig(inputPath, config, configFilePath.string(), separateLod0 ? lod0model : model, length, width, height, options.m_category, options.m_outputACC);
+            }
+            catch (std::runtime_error& e)
+            {
+                throw std::runtime_error("Error writing : " + configFilePath.string() + " : " + e.what());
+            }
+        }, { readLod0, readModel, readCollider });
+
+        const taskgraph::Task writeModel = stages.add("write " + inputFileDirectoryName + (options.m_outputACC ? ".acc" : ".ac"), [&]()
+        {
+            if (!options.m_writeModel || !buildModel)
+                return;
+
+            if (options.m_extractCarParts)
+            {
+                std::filesystem::path extractFilePath = outputPath;
+
+                extractFilePath.append("steer.acc");
+
+                // get steering wheel from lod 0 model
+                if (separateLod0)
+                {
+                    extract(lod0model, "STEER_LR", xform, extractFilePath.string(), options.m_outputGLB, options.m_embedTextures, usedTextures, meshes);
+                    remove(model, kn5::Node::Transform, "STEER_LR");
+                }
+                else
+                    extract(model, "STEER_LR", xform, extractFilePath.string(), options.m_outputGLB, options.m_embedTextures, usedTextures, meshes);
+
+                extractFilePath = outputPath;
+
+                extractFilePath.append("histeer.acc");
+
+                if (separateLod0)
+                {
+                    extract(lod0model, "STEER_HR", xform, extractFilePath.string(), options.m_outputGLB, options.m_embedTextures, usedTextures, meshes);
+                    remove(model, kn5::Node::Transform, "STEER_HR");
+                }
+                else
+                    extract(model, "STEER_HR", xform, extractFilePath.string(), options.m_outputGLB, options.m_embedTextures, usedTextures, meshes);
+
+                remove(model, kn5::Node::Transform, "WHEEL_RF");
+                remove(model, kn5::Node::Transform, "WHEEL_LF");
+                remove(model, kn5::Node::Transform, "WHEEL_RR");
+                remove(model, kn5::Node::Transform, "WHEEL_LR");
+
+                const ini& brakes = config.get(carconfig::Brakes);
+
+                remove(model, kn5::Node::Mesh, brakes.getValue("DISCS_GRAPHICS", "DISC_LF"));
+                remove(model, kn5::Node::Mesh, brakes.getValue("DISCS_GRAPHICS", "DISC_RF"));
+                remove(model, kn5::Node::Mesh, brakes.getValue("DISCS_GRAPHICS", "DISC_LR"));
+                remove(model, kn5::Node::Mesh, brakes.getValue("DISCS_GRAPHICS", "DISC_RR"));
+            }
+
+            if (options.m_cockpitLR)
+            {
+                kn5::Node* cockpitHRNode = model.findNode(kn5::Node::Transform, "COCKPIT_HR");
+
+                if (cockpitHRNode && cockpitHRNode->m_active)
+                {
+                    kn5::Node* cockpitLRNode = model.findNode(kn5::Node::Transform, "COCKPIT_LR");
+
+                    if (cockpitHRNode)
+                    {
+                        cockpitHRNode->m_active = false;
+                        cockpitLRNode->m_active = true;
+                    }
+                }
+            }
+
+            model.removeInactiveNodes();
+            model.transform(xform);
+            model.removeEmptyNodes();
+
+            std::filesystem::path outputFilePath = outputPath;
+
+            outputFilePath.append(inputFileDirectoryName + (options.m_outputACC ? ".acc" : ".ac"));
+
+            if (options.m_writeTextures && options.m_convertToPNG && options.m_packTextures)
+                packAtlases(model, separateLod0 ? lod0model : model, outputPath.string(), options.m_useDiffuse, options.m_maxTextureSize, textures);
+
+            if (options.m_writeTextures)
+            {
+                getUsedTextures(model, model.m_node, options.m_useDiffuse, usedTextures);
+                textures.write(usedTextures);
+            }
+
+            const auto ac3dStart = std::chrono::steady_clock::now();
+
+            writeAc3d(model, outputFilePath.string(), options.m_convertToPNG, options.m_outputACC, options.m_useDiffuse, meshes);
+
+            const auto glbStart = std::chrono::steady_clock::now();
+
+            if (options.m_outputGLB)
+            {
+                const std::string ac3dFileName = outputFilePath.filename().string();
+
+                outputFilePath.replace_extension(".glb");
+
+                writeGlb(model, separateLod0 ? lod0model : model, outputFilePath.string(), model.m_node, getGlbRoot(xform), options.m_convertToPNG, options.m_useDiffuse, options.m_embedTextures);
+
+                // the glb is meant to be quicker to write and load than the AC3D file, this shows the writing side
+                std::ostringstream  message;
+
+                message << "wrote " << ac3dFileName << " in " << std::fixed << std::setprecision(3) << std::chrono::duration<double>(glbStart - ac3dStart).count()
+                        << " seconds, " << outputFilePath.filename().string() << " in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - glbStart).count() << " seconds" << std::endl;
+
+                std::cout << message.str();
+            }
+        }, { prepareModel, writeCarConfig });
+
+        const taskgraph::Task writeTextures = stages.add("write textures", [&]()
+        {
+            if (options.m_writeTextures && !options.m_writeModel && buildModel)
+            {
+                textures.prepare(model, outputPath.string());
+                textures.write();
+            }
+        }, { prepareModel });
+
+        stages.add("write CMakeLists.txt", [&]()
+        {
+            if (!options.m_writeCmake || !buildCmake)
+                return;
+
+            std::filesystem::path cmakeFileName = outputPath;
+
+            cmakeFileName.append("CMakeLists.txt");
+
+            std::ofstream   fout(cmakeFileName.string());
+
+            if (fout)
+            {
+                fout << "INCLUDE(../../../../cmake/macros.cmake)" << std::endl;
+                fout << std::endl;
+                fout << "SD_INSTALL_CAR(" << inputFileDirectoryName << ")" << std::endl;
+
+                fout.close();
+            }
+        });
+
+        // the skins are converted by their own jobs and don't depend on the model
+        stages.add("write skins", [&]()
+        {
+            if (car.m_skinFileName.empty())
+                return;
+
+            std::filesystem::path skinDirectory = inputPath;
+
+            skinDirectory.append("skins");
+
+            if (std::filesystem::exists(skinDirectory))
+            {
+                for (const auto& entry : std::filesystem::directory_iterator(skinDirectory))
+                {
+                    std::filesystem::path   skinFilePath = entry.path();
+                    const std::string livery = skinFilePath.filename().string();
+
+                    skinFilePath.append(car.m_skinFileName);
+
+                    if (std::filesystem::exists(skinFilePath))
+                    {
+                        std::filesystem::path liveryFilePath = outputPath;
+
+                        liveryFilePath.append(inputFileDirectoryName + "-" + livery + ".png");
+
+                        std::filesystem::path previewPath = entry.path();
+
+                        previewPath.append("preview.jpg");
+
+                        std::filesystem::path liveryPreviewPath = outputPath;
+
+                        liveryPreviewPath.append(inputFileDirectoryName + "-" + livery + "-preview.jpg");
+
+                        textures.writeSkin(skinFilePath.string(), liveryFilePath.string(), previewPath.string(), liveryPreviewPath.string());
+                    }
+                }
+            }
+        });
+
+        const kn5::Node*        driverNode = nullptr;
+        std::string             driverHash;
+
+        const taskgraph::Task readDriver = stages.add("read driver", [&]()
+        {
+            if (driverFileName.empty() || !buildModel || !std::filesystem::exists(driverGraphicsPath))
+                return;
+
+            const driverModels::Driver& driver = shared.m_drivers.get(driverGraphicsPath, built.hash(driverGraphicsPath.string()), xform, options.m_dumpInputDriver);
+
+            if (options.m_dumpInputDriver)
+            {
+                std::filesystem::path  driverDumpPath = outputPath;
+
+                driverDumpPath.append(driverFileName + ".dump");
+
+                std::ofstream of(driverDumpPath.string());
+
+                if (of)
+                    of << driver.m_dump;
+
+                of.close();
+            }
+
+            std::filesystem::path driverPath = inputPath;
+
+            driverPath.append("driver_base_pos.knh");
+
+            if (!std::filesystem::exists(driverPath))
+                return;
+
+            knh driverKnh(driverPath.string());
+
+            if (options.m_dumpDriverKnh)
+            {
+                std::filesystem::path   driverDumpPath = outputPath;
+
+                driverDumpPath.append("driver_base_pos.knh.dump");
+
+                std::ofstream of(driverDumpPath.string());
+
+                if (of)
+                    driverKnh.dump(of);
+
+                of.close();
+            }
+
+            // the meshes are shared with the other cars, the textures are renamed for this car
+            driverModel.m_version = driver.m_model.m_version;
+            driverModel.m_unknown = driver.m_model.m_unknown;
+            driverModel.m_textures = driver.m_model.m_textures;
+            driverModel.m_materials = driver.m_model.m_materials;
+            driverNode = &driver.m_model.m_node;
+            driverHash = driver.m_hash;
+
+            hasDriver = true;
+        });
+
+        // after the car so the textures the driver shares with it keep the names of the car
+        stages.add("write driver.ac", [&]()
+        {
+            if (!hasDriver)
+                return;
+
+            std::filesystem::path driverOutFilePath = outputPath;
+
+            driverOutFilePath.append("driver.ac");
+
+            if (options.m_writeTextures)
+            {
+                std::set<std::string>   usedDriverTextures;
+
+                textures.prepare(driverModel, outputPath.string());
+                getUsedTextures(driverModel, *driverNode, true, usedDriverTextures);
+                textures.write(usedDriverTextures);
+            }
+
+            // the texture names are part of the key because they can be renamed to car textures
+            std::string names;
+
+            for (const auto& material : driverModel.m_materials)
+            {
+                for (const auto& mapping : material.m_textureMappings)
+                    names += mapping.m_textureName + '\n';
+            }
+
+            const std::string driverKey = driverHash + "-" + contenthash(names.data(), names.size()).to_string() + "-driver";
+            const std::string driverStoreKey = driverKey + ".ac";
+
+            // the cars with the same driver textures share one driver.ac
+            shared.m_files.get(driverStoreKey, driverOutFilePath.string(), [&]()
+            {
+                if (!shared.m_store || !shared.m_store->materialize(driverStoreKey, driverOutFilePath.string()))
+                {
+                    writeAc3d(driverModel, driverOutFilePath.string(), *driverNode, true, false, true, meshes);
+
+                    if (shared.m_store)
+                        shared.m_store->insert(driverStoreKey, driverOutFilePath.string());
+                }
+            });
+
+            if (options.m_outputGLB)
+            {
+                driverOutFilePath.replace_extension(".glb");
+
+                shared.m_files.get(driverKey + (options.m_embedTextures ? "-embedded.glb" : ".glb"), driverOutFilePath.string(), [&]()
+                {
+                    writeGlb(driverModel, driverModel, driverOutFilePath.string(), *driverNode, getGlbRoot(xform), true, true, options.m_embedTextures);
+                });
+            }
+        }, { readDriver, writeModel, writeTextures });
+
+        const std::vector<jobs::Error> errors = stages.run();
+
+        if (!errors.empty())
+        {
+            // the first failure fails the car, the stages that didn't use it still ran
+            for (size_t i = 1; i < errors.size(); i++)
+                std::cerr << errors[i].m_message << std::endl;
+
+            throw std::runtime_error(errors.front().m_message);
+        }
+
+        const size_t failures = textures.wait();
+
+        textures.reportSkipped();
+
+        if (buildConfig)
+        {
+            built.addOutput("config", (outputPath / (inputFileDirectoryName + ".xml")).string(), configKey);
+            built.addOutput("config", (outputPath / "collider.kn5.dump").string(), configKey);
+            built.setTarget("config", configKey);
+        }
+        else
+            built.keep("config");
+
+        if (buildModel)
+        {
+            const std::string modelFileNames[] = { inputFileDirectoryName + (options.m_outputACC ? ".acc" : ".ac"), inputFileDirectoryName + ".glb",
+                                                   "steer.acc", "steer.glb", "histeer.acc", "histeer.glb", inputFileName + ".dump", lod0FileName + ".dump",
+                                                   lod0FileName + ".hierarchy.dump", "driver.ac", "driver.glb", driverFileName + ".dump", "driver_base_pos.knh.dump" };
+
+            for (const auto& fileName : modelFileNames)
+                built.addOutput("model", (outputPath / fileName).string(), modelKey);
+
+            // the model is written again until its textures and the skins convert
+            if (failures == 0)
+            {
+                built.setTarget("model", modelKey);
+                built.setTarget("textures", modelKey);
+            }
+        }
+        else
+        {
+            built.keep("model");
+            built.keep("textures");
+        }
+
+        if (buildCmake)
+        {
+            built.addOutput("cmake", (outputPath / "CMakeLists.txt").string(), cmakeKey);
+            built.setTarget("cmake", cmakeKey);
+        }
+        else
+            built.keep("cmake");
+
+        meshes.save();
+        built.write();
+
+        return failures;
+    }
+    // the texture in most of the liveries is the one they replace
+    std::string findSkinFileName(const std::filesystem::path& inputPath)
+    {
+        const std::filesystem::path skinDirectory = inputPath / "skins";
+        std::map<std::string, size_t>   counts;
+        std::error_code                 error;
+
+        if (!std::filesystem::is_directory(skinDirectory, error))
+            return std::string();
+
+        for (const auto& livery : std::filesystem::directory_iterator(skinDirectory, error))
+        {
+            if (!livery.is_directory(error))
+                continue;
+
+            for (const auto& entry : std::filesystem::directory_iterator(livery.path(), error))
+            {
+                std::string extension = entry.path().extension().string();
+
+                std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+                if (entry.is_regular_file(error) && extension == ".dds")
+                    counts[entry.path().filename().string()]++;
+            }
+        }
+
+        std::string skinFileName;
+        size_t      most = 0;
+
+        for (const auto& count : counts)
+        {
+            if (count.second > most)
+            {
+                skinFileName = count.first;
+                most = count.second;
+            }
+        }
+
+        return skinFileName;
+    }
+
+    // every directory with a kn5 file and a data directory or data.acd file, sorted by name
+    std::vector<Car> findCars(const std::string& carsDirectory, const std::string& skinFileName)
+    {
+        std::vector<Car> cars;
+
+        for (const auto& entry : std::filesystem::directory_iterator(carsDirectory))
+        {
+            if (!entry.is_directory())
+                continue;
+
+            const std::filesystem::path& inputPath = entry.path();
+
+            if (!std::filesystem::exists(inputPath / "data") && !std::filesystem::exists(inputPath / "data.acd"))
+                continue;
+
+            bool hasModel = false;
+
+            for (const auto& file : std::filesystem::directory_iterator(inputPath))
+            {
+                if (file.path().extension() == ".kn5")
+                {
+                    hasModel = true;
+                    break;
+                }
+            }
+
+            if (!hasModel)
+                continue;
+
+            Car car;
+
+            car.m_inputDirectory = inputPath.string();
+            car.m_skinFileName = skinFileName.empty() ? findSkinFileName(inputPath) : skinFileName;
+
+            cars.push_back(car);
+        }
+
+        std::sort(cars.begin(), cars.end(), [](const Car& a, const Car& b) { return a.m_inputDirectory < b.m_inputDirectory; });
+
+        return cars;
+    }
+
+    // converts the cars at the same time on one pool, the threads that run out of cars help with the textures
+    // of the others, and prints how long each car took
+    int convertCars(const Options& options, const std::string& carsDirectory, const std::string& skinFileName, Shared& shared)
+    {
+        struct Result
+        {
+            std::string m_error;
+            size_t      m_failures = 0;
+            double      m_seconds = 0;
+        };
+
+        const auto              start = std::chrono::steady_clock::now();
+        const std::vector<Car>  cars = findCars(carsDirectory, skinFileName);
+        std::vector<Result>     results(cars.size());
+        jobs                    pool(options.m_jobCount);
+
+        shared.m_shareTextures = true;
+
+        for (size_t i = 0; i < cars.size(); i++)
+        {
+            pool.add(cars[i].m_inputDirectory, [&options, &cars, &results, i, &pool, &shared]()
+            {
+                const auto carStart = std::chrono::steady_clock::now();
+
+                try
+                {
+                    results[i].m_failures = convertCar(options, cars[i], pool, shared);
+                }
+                catch (std::ifstream::failure& e)
+                {
+                    results[i].m_error = e.code().message();
+                }
+                catch (std::exception& e)
+                {
+                    results[i].m_error = e.what();
+                }
+
+                results[i].m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - carStart).count();
+            });
+        }
+
+        pool.wait();
+
+        size_t converted = 0;
+
+        std::cout << std::endl << std::left << std::setw(32) << "car" << std::setw(10) << "status" << std::right << std::setw(10) << "seconds" << std::endl;
+
+        for (size_t i = 0; i < cars.size(); i++)
+        {
+            const Result&   result = results[i];
+            std::string     status = "ok";
+
+            if (!result.m_error.empty())
+                status = "failed";
+            else if (result.m_failures != 0)
+                status = "partial";
+            else
+                converted++;
+
+            std::cout << std::left << std::setw(32) << std::filesystem::path(cars[i].m_inputDirectory).filename().string() << std::setw(10) << status
+                      << std::right << std::setw(10) << std::fixed << std::setprecision(2) << result.m_seconds;
+
+            if (!result.m_error.empty())
+                std::cout << "  " << result.m_error;
+            else if (result.m_failures != 0)
+                std::cout << "  " << result.m_failures << " textures or skins couldn't be converted";
+
+            std::cout << std::endl;
+        }
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "converted " << converted << " of " << cars.size() << " cars in " << std::fixed << std::setprecision(2) << seconds << " seconds" << std::endl;
+
+        return converted == cars.size() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    void usage()
+    {
+        std::cout << "Usage: kn5toac -c category -i input_directory [-o output_directory] [-n kn5_filename] [-s skin_filename] [-t texture_size] [-j jobs] [-p png_preset] [-a store_directory] [-b] [-x] [-g] [-G] [-k] [-d] [-f]" << std::endl;
+        std::cout << "       kn5toac -c category -r cars_directory -o output_directory [-s skin_filename] [options]" << std::endl;
+        std::cout << " -c category           Speed Dreams category to add this car to." << std::endl;
+        std::cout << " -i input_directory    Assetto Corsa car directory of car to convert." << std::endl;
+        std::cout << " -r cars_directory     Assetto Corsa content/cars directory, every car in it is converted." << std::endl;
+        std::cout << " -o output_directory   Speed Dreams directory where converted car will be installed." << std::endl;
+        std::cout << " -n kn5_filename       Assetto Corsa car model to convert if different form directory name." << std::endl;
+        std::cout << " -s skin_filename      Assetto Corsa skin texture file name" << std::endl;
+        std::cout << " -t texture_size       Largest width and height of the converted textures and skins." << std::endl;
+        std::cout << " -j jobs               Number of textures converted at the same time, defaults to the number of cores." << std::endl;
+        std::cout << " -p png_preset         PNG compression: fast, default or small." << std::endl;
+        std::cout << " -a store_directory    Shared store of converted textures and driver models used by every conversion." << std::endl;
+        std::cout << " -b                    Bakes the detail and ambient occlusion textures into the diffuse textures." << std::endl;
+        std::cout << " -x                    Packs small textures that aren't repeated into atlases." << std::endl;
+        std::cout << " -g                    Also write binary glTF (.glb) models referencing the converted textures." << std::endl;
+        std::cout << " -G                    Also write binary glTF (.glb) models with the textures embedded." << std::endl;
+        std::cout << " -k                    Also writes the original dds textures next to the converted ones." << std::endl;
+        std::cout << " -d                    Dumps kn5 files, keeps dds textures and writes the data.acd files." << std::endl;
+        std::cout << " -f                    Writes every file again, even the ones the manifest says are up to date." << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options     options;
+    std::string inputDirectory;
+    std::string inputFileName;
+    std::string skinFileName;
+    std::string storeDirectory;
+    std::string carsDirectory;
+
+#ifndef _WIN32
+    // a converter that exits early closes the pipe the texture is written to
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+        if (arg == "-c")
+        {
+            if (i < argc)
+            {
+                i++;
+                options.m_category = argv[i];
+            }
+            else
+            {
+                usage();
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "-a")
+        {
+            if (i + 1 < argc)
+            {
+                i++;
+                storeDirectory = argv[i];
+            }
+            else
+            {
+                usage();
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "-d")
+        {
+            options.m_dumpModel = true;
+            options.m_dumpCollider = true;
+            options.m_writeData = true;
+            options.m_deleteDDS = false;
+            options.m_dumpInputDriver = true;
+            options.m_dumpDriverKnh = true;
+        }
+        else if (arg == "-g")
+            options.m_outputGLB = true;
+        else if (arg == "-G")
+        {
+            options.m_outputGLB = true;
+            options.m_embedTextures = true;
+        }
+        else if (arg == "-b")
+            options.m_bakeTextures = true;
+        else if (arg == "-k")
+            options.m_deleteDDS = false;
+        else if (arg == "-x")
+            options.m_packTextures = true;
+        else if (arg == "-f")
+            options.m_rebuild = true;
+        else if (arg == "-h")
+        {
+            usage();
+            return EXIT_SUCCESS;
+        }
+        else if (arg == "-i")
+        {
+            if (i < argc)
+            {
+                i++;
+                inputDirectory = argv[i];
+            }
+            else
+            {
+                usage();
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "-j")
+        {
+            if (i + 1 < argc)
+            {
+                i++;
+                const std::string count(argv[i]);
+                const auto result = std::from_chars(count.data(), count.data() + count.size(), options.m_jobCount);
+
+                if (result.ec != std::errc() || result.ptr != count.data() + count.size())
+                {
+                    usage();
+                    return EXIT_FAILURE;
+                }
+            }
+            else
+            {
+                usage();
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "-p")
+        {
+            if (i + 1 < argc)
+            {
+                i++;
+                const std::string preset(argv[i]);
+
+                if (preset == "fast")
+                    options.m_pngLevel = deflate::Fast;
+                else if (preset == "default")
+                    options.m_pngLevel = deflate::Default;
+                else if (preset == "small")
+                    options.m_pngLevel = deflate::Small;
+                else
+                {
+                    usage();
+                    return EXIT_FAILURE;
+                }
+            }
+            else
+            {
+                usage();
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "-r")
+        {
+            if (i + 1 < argc)
+            {
+                i++;
+                carsDirectory = argv[i];
+            }
+            else
+            {
+                usage();
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "-n")
+        {
+            if (i < argc)
+            {
+                i++;
+                inputFileName = argv[i];
+            }
+            else
+            {
+                usage();
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "-o")
+        {
+            if (i < argc)
+            {
+                i++;
+                options.m_outputDirectory = argv[i];
+                options.m_writeTextures = true;
+                options.m_convertToPNG = true;
+                options.m_writeModel = true;
+                options.m_extractCarParts = true;
+                options.m_writeCarConfig = true;
+                options.m_useDiffuse = true;
+                options.m_writeCmake = true;
+                options.m_writeDriver = true;
+            }
+            else
+            {
+                usage();
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "-s")
+        {
+            if (i < argc)
+            {
+                i++;
+                skinFileName = argv[i];
+            }
+            else
+            {
+                usage();
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "-t")
+        {
+            if (i + 1 < argc)
+            {
+                i++;
+                const std::string size(argv[i]);
+                const auto result = std::from_chars(size.data(), size.data() + size.size(), options.m_maxTextureSize);
+
+                if (result.ec != std::errc() || result.ptr != size.data() + size.size())
+                {
+                    usage();
+                    return EXIT_FAILURE;
+                }
+            }
+            else
+            {
+                usage();
+                return EXIT_FAILURE;
+            }
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::unique_ptr<assetstore> store;
+    Shared                      shared;
+
+    if (!storeDirectory.empty())
+        store = std::make_unique<assetstore>(storeDirectory);
+
+    shared.m_store = store.get();
+
+    if (!carsDirectory.empty())
+    {
+        // the cars are named by their directories and written to the output directory
+        if (!inputDirectory.empty() || !inputFileName.empty() || options.m_outputDirectory.empty())
+        {
+            usage();
+            return EXIT_FAILURE;
+        }
+
+        try
+        {
+            return convertCars(options, carsDirectory, skinFileName, shared);
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (inputDirectory.empty())
+    {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    Car car;
+
+    car.m_inputDirectory = inputDirectory;
+    car.m_inputFileName = inputFileName;
+    car.m_skinFileName = skinFileName;
+
+    jobs pool(options.m_jobCount);
+
+    try
+    {
+        // the textures and skins that failed were reported, the car is partly converted like in the batch summary
+        if (convertCar(options, car, pool, shared) != 0)
+            return EXIT_FAILURE;
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
     }
 
     return EXIT_SUCCESS;
@@ -1,32 +1,206 @@
 #include "lut.h"
-#include "trim.h"
+#include "datasource.h"
 
+#include <algorithm>
+#include <charconv>
+#include <cmath>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LUT_X86
+#include <immintrin.h>
+#define LUT_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace
+{
+    constexpr std::string_view WHITESPACE = " \n\r\t\f\v";
+
+    std::string_view trim(std::string_view s)
+    {
+        const size_t start = s.find_first_not_of(WHITESPACE);
+
+        if (start == std::string_view::npos)
+            return std::string_view();
+
+        return s.substr(start, s.find_last_not_of(WHITESPACE) - start + 1);
+    }
+
+    // like std::stof, leading white space and a plus sign are skipped and the rest after the number is ignored
+    float parseFloat(std::string_view text)
+    {
+        text = trim(text);
+
+        if (!text.empty() && text[0] == '+' && (text.size() == 1 || text[1] != '-'))
+            text.remove_prefix(1);
+
+        float value = 0;
+
+        const std::from_chars_result result = std::from_chars(text.data(), text.data() + text.size(), value);
+
+        if (result.ec == std::errc::result_out_of_range)
+            throw std::out_of_range("stof");
+
+        if (result.ec != std::errc())
+            throw std::invalid_argument("stof");
+
+        return value;
+    }
+
+    inline float interpolate(float first, float firstLow, float firstHigh, float secondLow, float secondHigh)
+    {
+        const float first_delta = firstHigh - firstLow;
+        const float second_delta = secondHigh - secondLow;
+
+        if (second_delta == 0)
+            return secondLow;
+
+        return secondLow + ((first - firstLow) * second_delta) / first_delta;
+    }
+
+#ifdef LUT_X86
+    // branchless binary search of 8 values at a time, the same operations as lut::lookup
+    LUT_AVX2 size_t lookupAVX2(const float* firsts, const float* seconds, size_t size, const float* values, float* results, size_t count)
+    {
+        const float*    search = firsts + 1;
+        const __m256    front = _mm256_set1_ps(firsts[0]);
+        const __m256    back = _mm256_set1_ps(firsts[size - 1]);
+        const __m256    frontSecond = _mm256_set1_ps(seconds[0]);
+        const __m256    backSecond = _mm256_set1_ps(seconds[size - 1]);
+        const __m256i   one = _mm256_set1_epi32(1);
+        const __m256i   last = _mm256_set1_epi32(static_cast<int>(size - 2));
+        size_t          i = 0;
+
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m256    first = _mm256_loadu_ps(values + i);
+            __m256i         index = _mm256_setzero_si256();
+
+            for (size_t length = size - 1; length > 1; )
+            {
+                const size_t    half = length / 2;
+                const __m256i   middle = _mm256_add_epi32(index, _mm256_set1_epi32(static_cast<int>(half)));
+                const __m256    below = _mm256_cmp_ps(_mm256_i32gather_ps(search, middle, 4), first, _CMP_LT_OQ);
+
+                index = _mm256_add_epi32(index, _mm256_and_si256(_mm256_castps_si256(below), _mm256_set1_epi32(static_cast<int>(half))));
+                length -= half;
+            }
+
+            const __m256 below = _mm256_cmp_ps(_mm256_i32gather_ps(search, index, 4), first, _CMP_LT_OQ);
+
+            index = _mm256_min_epi32(_mm256_add_epi32(index, _mm256_and_si256(_mm256_castps_si256(below), one)), last);
+
+            const __m256i   next = _mm256_add_epi32(index, one);
+            const __m256    firstLow = _mm256_i32gather_ps(firsts, index, 4);
+            const __m256    firstHigh = _mm256_i32gather_ps(firsts, next, 4);
+            const __m256    secondLow = _mm256_i32gather_ps(seconds, index, 4);
+            const __m256    secondHigh = _mm256_i32gather_ps(seconds, next, 4);
+            const __m256    secondDelta = _mm256_sub_ps(secondHigh, secondLow);
+            __m256          result = _mm256_add_ps(secondLow, _mm256_div_ps(_mm256_mul_ps(_mm256_sub_ps(first, firstLow), secondDelta), _mm256_sub_ps(firstHigh, firstLow)));
+
+            result = _mm256_blendv_ps(result, secondLow, _mm256_cmp_ps(secondDelta, _mm256_setzero_ps(), _CMP_EQ_OQ));
+            result = _mm256_blendv_ps(result, frontSecond, _mm256_cmp_ps(first, front, _CMP_LE_OQ));
+            result = _mm256_blendv_ps(result, backSecond, _mm256_cmp_ps(first, back, _CMP_GT_OQ));
+            result = _mm256_andnot_ps(_mm256_cmp_ps(first, first, _CMP_UNORD_Q), result);
+
+            _mm256_storeu_ps(results + i, result);
+        }
+
+        _mm256_zeroupper();
+
+        return i;
+    }
+
+    LUT_AVX2 size_t lookupGridAVX2(const float* grid, size_t size, float gridFirst, float gridScale, const float* values, float* results, size_t count)
+    {
+        const __m256    start = _mm256_set1_ps(gridFirst);
+        const __m256    scale = _mm256_set1_ps(gridScale);
+        const __m256    end = _mm256_set1_ps(static_cast<float>(size - 1));
+        const __m256i   last = _mm256_set1_epi32(static_cast<int>(size - 2));
+        size_t          i = 0;
+
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m256    first = _mm256_loadu_ps(values + i);
+            const __m256    position = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(first, start), scale), _mm256_setzero_ps()), end);
+            const __m256i   index = _mm256_min_epi32(_mm256_cvttps_epi32(position), last);
+            const __m256    fraction = _mm256_sub_ps(position, _mm256_cvtepi32_ps(index));
+            const __m256    low = _mm256_i32gather_ps(grid, index, 4);
+            const __m256    high = _mm256_i32gather_ps(grid, _mm256_add_epi32(index, _mm256_set1_epi32(1)), 4);
+            const __m256    result = _mm256_add_ps(low, _mm256_mul_ps(_mm256_sub_ps(high, low), fraction));
+
+            _mm256_storeu_ps(results + i, _mm256_andnot_ps(_mm256_cmp_ps(first, first, _CMP_UNORD_Q), result));
+        }
+
+        _mm256_zeroupper();
+
+        return i;
+    }
+#endif
+}
 
 void lut::read(const std::string& fileName)
 {
-    std::ifstream fin(fileName);
+    std::ifstream fin(fileName, std::ios::binary);
 
     if (!fin)
         throw std::runtime_error("Couldn't open file: " + fileName);
 
-    std::string line;
+    std::ostringstream contents;
+
+    contents << fin.rdbuf();
+
+    fin.close();
+
+    parse(contents.str());
+}
+
+void lut::read(const datasource& source, const std::string& name)
+{
+    parse(source.read(name));
+}
 
-    while (std::getline(fin, line))
+void lut::parse(std::string_view text)
+{
+    size_t start = 0;
+
+    while (start < text.size())
     {
-        std::string trimmed = trim(line);
+        size_t end = text.find('\n', start);
+
+        if (end == std::string_view::npos)
+            end = text.size();
+
+        const std::string_view trimmed = trim(text.substr(start, end - start));
+
+        start = end + 1;
 
         if (!trimmed.empty() && trimmed[0] != ';')
         {
             const size_t seperator = trimmed.find('|');
-            const float first = std::stof(trimmed.substr(0, seperator));
-            const float second = std::stof(trimmed.substr(seperator + 1));
+            const float first = parseFloat(trimmed.substr(0, seperator));
+            const float second = parseFloat(seperator == std::string_view::npos ? trimmed : trimmed.substr(seperator + 1));
             m_entries.push_back(std::make_pair(first, second));
         }
     }
 
-    fin.close();
+    m_firsts.resize(m_entries.size());
+    m_seconds.resize(m_entries.size());
+    m_ascending = true;
+
+    for (size_t i = 0; i < m_entries.size(); i++)
+    {
+        m_firsts[i] = m_entries[i].first;
+        m_seconds[i] = m_entries[i].second;
+
+        if (std::isnan(m_firsts[i]) || (i > 0 && m_firsts[i] < m_firsts[i - 1]))
+            m_ascending = false;
+    }
+
+    m_grid.clear();
 }
 
 void lut::dump(std::ostream& stream) const
@@ -58,6 +232,42 @@ float lut::lookup(float first) const
     if (m_entries.empty())
         throw std::runtime_error("empty lut");
 
+    if (!m_ascending)
+        return lookupLinear(first);
+
+    if (first < m_firsts.front())
+        return m_seconds.front();
+
+    if (first > m_firsts.back())
+        return m_seconds.back();
+
+    // also a curve of one entry
+    if (first == m_firsts.front())
+        return m_seconds.front();
+
+    if (std::isnan(first))
+        return 0.0f;
+
+    // branchless search for the first entry after the first one that is at least as large, the one before it is smaller
+    const float*    search = m_firsts.data() + 1;
+    size_t          i = 0;
+
+    for (size_t length = m_firsts.size() - 1; length > 1; )
+    {
+        const size_t half = length / 2;
+
+        i += search[i + half] < first ? half : 0;
+        length -= half;
+    }
+
+    i = std::min(i + (search[i] < first ? 1 : 0), m_firsts.size() - 2);
+
+    return interpolate(first, m_firsts[i], m_firsts[i + 1], m_seconds[i], m_seconds[i + 1]);
+}
+
+// any order of entries, the first matching entry or interval is used
+float lut::lookupLinear(float first) const
+{
     if (first < m_entries.front().first)
         return m_entries.front().second;
 
@@ -69,19 +279,87 @@ float lut::lookup(float first) const
         if (first == m_entries[i].first)
             return  m_entries[i].second;
 
-	if (first >= m_entries[i].first && first <= m_entries[i + 1].first)
-        {
-            const float second_low = m_entries[i].second;
-            const float first_low = m_entries[i].first;
-            const float first_delta = m_entries[i + 1].first - first_low;
-            const float second_delta = m_entries[i + 1].second - second_low;
-
-            if (second_delta == 0)
-                return second_low;
-
-            return second_low + ((first - first_low) * second_delta) / first_delta;
-        }
+        if (first >= m_entries[i].first && first <= m_entries[i + 1].first)
+            return interpolate(first, m_entries[i].first, m_entries[i + 1].first, m_entries[i].second, m_entries[i + 1].second);
     }
 
     return 0.0f;
 }
+
+void lut::lookup(const float* firsts, float* seconds, size_t count) const
+{
+    lookup(firsts, seconds, count, cpu::getSupportedIsa());
+}
+
+void lut::lookup(const float* firsts, float* seconds, size_t count, cpu::Isa isa) const
+{
+    if (m_entries.empty())
+        throw std::runtime_error("empty lut");
+
+    size_t i = 0;
+
+#ifdef LUT_X86
+    if (isa == cpu::AVX2 && m_ascending && m_entries.size() > 1)
+        i = lookupAVX2(m_firsts.data(), m_seconds.data(), m_firsts.size(), firsts, seconds, count);
+#else
+    (void)isa;
+#endif
+
+    for (; i < count; i++)
+        seconds[i] = lookup(firsts[i]);
+}
+
+void lut::buildGrid(size_t size)
+{
+    m_grid.clear();
+
+    if (size < 2 || m_entries.size() < 2 || !(m_entries.front().first < m_entries.back().first))
+        return;
+
+    const float front = m_entries.front().first;
+    const float back = m_entries.back().first;
+
+    m_grid.resize(size);
+    m_gridFirst = front;
+    m_gridScale = static_cast<float>(size - 1) / (back - front);
+
+    for (size_t i = 0; i < size - 1; i++)
+        m_grid[i] = lookup(front + (back - front) * (static_cast<float>(i) / static_cast<float>(size - 1)));
+
+    m_grid[size - 1] = lookup(back);
+}
+
+float lut::lookupGrid(float first) const
+{
+    if (m_grid.empty())
+        return lookup(first);
+
+    if (std::isnan(first))
+        return 0.0f;
+
+    const float     position = std::min(std::max((first - m_gridFirst) * m_gridScale, 0.0f), static_cast<float>(m_grid.size() - 1));
+    const size_t    i = std::min(static_cast<size_t>(position), m_grid.size() - 2);
+    const float     fraction = position - static_cast<float>(i);
+
+    return m_grid[i] + (m_grid[i + 1] - m_grid[i]) * fraction;
+}
+
+void lut::lookupGrid(const float* firsts, float* seconds, size_t count) const
+{
+    lookupGrid(firsts, seconds, count, cpu::getSupportedIsa());
+}
+
+void lut::lookupGrid(const float* firsts, float* seconds, size_t count, cpu::Isa isa) const
+{
+    size_t i = 0;
+
+#ifdef LUT_X86
+    if (isa == cpu::AVX2 && !m_grid.empty())
+        i = lookupGridAVX2(m_grid.data(), m_grid.size(), m_gridFirst, m_gridScale, firsts, seconds, count);
+#else
+    (void)isa;
+#endif
+
+    for (; i < count; i++)
+        seconds[i] = lookupGrid(firsts[i]);
+}
@@ -1,14 +1,30 @@
-#ifndef _LUI_H_
+#ifndef _LUT_H_
 #define _LUT_H_
 
+#include "cpu.h"
+
 #include <string>
+#include <string_view>
 #include <vector>
 #include <utility>
 
+class datasource;
+
+// Curve of linearly interpolated (first, second) points.
+// Ascending curves are searched in O(log n), lookupGrid interpolates a resampled uniform grid in O(1).
 class lut
 {
 private:
     std::vector<std::pair<float,float>> m_entries;
+    std::vector<float>                  m_firsts;
+    std::vector<float>                  m_seconds;
+    bool                                m_ascending = true;
+    std::vector<float>                  m_grid;
+    float                               m_gridFirst = 0;
+    float                               m_gridScale = 0;
+
+    void parse(std::string_view text);
+    float lookupLinear(float first) const;
 
 public:
     lut() = default;
@@ -16,8 +32,13 @@ public:
     {
         read(fileName);
     }
+    lut(const datasource& source, const std::string& name)
+    {
+        read(source, name);
+    }
 
     void read(const std::string& fileName);
+    void read(const datasource& source, const std::string& name);
     void dump(std::ostream& stream) const;
     bool dump(const std::string& fileName) const;
     const std::vector<std::pair<float, float>>& getValues() const
@@ -25,6 +46,22 @@ public:
         return m_entries;
     }
     float lookup(float first) const;
+
+    // the same results as lookup for every value, the block instruction sets are used for ascending curves
+    void lookup(const float* firsts, float* seconds, size_t count) const;
+    void lookup(const float* firsts, float* seconds, size_t count, cpu::Isa isa) const;
+
+    // resamples the curve at size evenly spaced points from the first to the last entry
+    void buildGrid(size_t size);
+    bool hasGrid() const
+    {
+        return !m_grid.empty();
+    }
+
+    // interpolates the grid so points between the grid points are approximated, uses lookup without a grid
+    float lookupGrid(float first) const;
+    void lookupGrid(const float* firsts, float* seconds, size_t count) const;
+    void lookupGrid(const float* firsts, float* seconds, size_t count, cpu::Isa isa) const;
 };
 
 #endif
@@ -0,0 +1,211 @@
+#include "lut.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Measures the lut lookups in millions of lookups per second and checks that the binary search
+// and the batched lookups return exactly what the original linear scan and lookupGrid return.
+
+namespace
+{
+    // the linear scan lut::lookup used before the binary search
+    float lookupLinear(const std::vector<std::pair<float, float>>& entries, float first)
+    {
+        if (first < entries.front().first)
+            return entries.front().second;
+
+        if (first > entries.back().first)
+            return entries.back().second;
+
+        for (size_t i = 0; i < entries.size() - 1; i++)
+        {
+            if (first == entries[i].first)
+                return entries[i].second;
+
+            if (first >= entries[i].first && first <= entries[i + 1].first)
+            {
+                const float second_low = entries[i].second;
+                const float first_low = entries[i].first;
+                const float first_delta = entries[i + 1].first - first_low;
+                const float second_delta = entries[i + 1].second - second_low;
+
+                if (second_delta == 0)
+                    return second_low;
+
+                return second_low + ((first - first_low) * second_delta) / first_delta;
+            }
+        }
+
+        return 0.0f;
+    }
+
+    // power curve like lut of size points from 0 to range with some flat parts
+    lut makeLut(size_t size, float range)
+    {
+        std::mt19937    random(static_cast<unsigned int>(size));
+        std::string     text = "; benchmark curve\n";
+        float           second = 0;
+
+        for (size_t i = 0; i < size; i++)
+        {
+            if (random() % 8 != 0)
+                second += static_cast<float>(random() % 1000) / 100.0f;
+
+            text += std::to_string(range * static_cast<float>(i) / static_cast<float>(size - 1)) + "|" + std::to_string(second) + "\n";
+        }
+
+        const std::string fileName = "lutbench.lut";
+
+        std::ofstream(fileName, std::ios::binary) << text;
+
+        lut curve(fileName);
+
+        std::remove(fileName.c_str());
+
+        return curve;
+    }
+
+    // the entries themselves, values between them and values outside the curve
+    std::vector<float> makeValues(const lut& curve, size_t count)
+    {
+        const auto&                             entries = curve.getValues();
+        std::mt19937                            random(1234);
+        std::uniform_real_distribution<float>   distribution(entries.front().first - 10.0f, entries.back().first + 10.0f);
+        std::vector<float>                      values;
+
+        for (const auto& entry : entries)
+            values.push_back(entry.first);
+
+        values.push_back(NAN);
+
+        while (values.size() < count)
+            values.push_back(distribution(random));
+
+        return values;
+    }
+
+    template <typename Function>
+    double measure(size_t count, size_t iterations, Function function)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < iterations; i++)
+            function();
+
+        const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+        return static_cast<double>(count) * iterations / seconds.count() / 1e6;
+    }
+
+    bool same(const std::vector<float>& a, const std::vector<float>& b)
+    {
+        return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    size_t iterations = 100;
+
+    if (argc > 1)
+        iterations = std::stoul(argv[1]);
+
+    const cpu::Isa  supported = cpu::getSupportedIsa();
+    const size_t    count = 1 << 16;
+    bool            exact = true;
+
+    std::cout << "supported: " << cpu::to_string(supported) << std::endl;
+
+    // engine power, aero and large tyre like curves
+    for (auto size : { 20u, 64u, 4096u })
+    {
+        lut                         curve = makeLut(size, size < 64 ? 9000.0f : 90.0f);
+        const std::vector<float>    values = makeValues(curve, count);
+        std::vector<float>          reference(values.size());
+        std::vector<float>          results(values.size());
+        volatile float              sink = 0;
+
+        for (size_t i = 0; i < values.size(); i++)
+            reference[i] = lookupLinear(curve.getValues(), values[i]);
+
+        std::cout << "lut " << std::setw(4) << size << std::fixed << std::setprecision(1);
+
+        std::cout << "  linear " << measure(values.size(), iterations, [&]()
+        {
+            for (const float value : values)
+                sink = sink + lookupLinear(curve.getValues(), value);
+        }) << " M/s";
+
+        for (size_t i = 0; i < values.size(); i++)
+            results[i] = curve.lookup(values[i]);
+
+        bool matches = same(results, reference);
+
+        exact = exact && matches;
+
+        std::cout << "  search " << measure(values.size(), iterations, [&]()
+        {
+            for (const float value : values)
+                sink = sink + curve.lookup(value);
+        }) << " M/s" << (matches ? "" : " MISMATCH");
+
+        for (int isa = cpu::Scalar; isa <= supported; isa++)
+        {
+            curve.lookup(values.data(), results.data(), values.size(), static_cast<cpu::Isa>(isa));
+            matches = same(results, reference);
+            exact = exact && matches;
+
+            std::cout << "  " << cpu::to_string(static_cast<cpu::Isa>(isa)) << " " << measure(values.size(), iterations, [&]()
+            {
+                curve.lookup(values.data(), results.data(), values.size(), static_cast<cpu::Isa>(isa));
+            }) << " M/s" << (matches ? "" : " MISMATCH");
+        }
+
+        std::cout << std::endl;
+
+        curve.buildGrid(1024);
+
+        std::vector<float>  gridReference(values.size());
+        float               error = 0;
+
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            gridReference[i] = curve.lookupGrid(values[i]);
+
+            if (!std::isnan(values[i]))
+                error = std::max(error, std::abs(gridReference[i] - reference[i]));
+        }
+
+        std::cout << "grid" << std::setw(5) << size << "  max error " << std::setprecision(3) << error << std::setprecision(1);
+
+        std::cout << "  single " << measure(values.size(), iterations, [&]()
+        {
+            for (const float value : values)
+                sink = sink + curve.lookupGrid(value);
+        }) << " M/s";
+
+        for (int isa = cpu::Scalar; isa <= supported; isa++)
+        {
+            curve.lookupGrid(values.data(), results.data(), values.size(), static_cast<cpu::Isa>(isa));
+            matches = same(results, gridReference);
+            exact = exact && matches;
+
+            std::cout << "  " << cpu::to_string(static_cast<cpu::Isa>(isa)) << " " << measure(values.size(), iterations, [&]()
+            {
+                curve.lookupGrid(values.data(), results.data(), values.size(), static_cast<cpu::Isa>(isa));
+            }) << " M/s" << (matches ? "" : " MISMATCH");
+        }
+
+        std::cout << std::endl;
+    }
+
+    return exact ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,263 @@
+#include "manifest.h"
+#include "contenthash.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+const char* const manifest::FileName = "kn5toac.manifest";
+
+namespace
+{
+    const char* const Header = "kn5toac manifest 1";
+
+    // the name is the rest of the line so it can have spaces
+    std::string readName(std::istream& stream)
+    {
+        std::string name;
+
+        stream.get();
+
+        std::getline(stream, name);
+
+        return name;
+    }
+}
+
+manifest::manifest(const std::string& directory) : m_directory(directory)
+{
+    read();
+}
+
+bool manifest::stat(const std::string& fileName, File& file)
+{
+    std::error_code error;
+
+    file.m_size = std::filesystem::file_size(fileName, error);
+
+    if (error)
+        return false;
+
+    file.m_time = std::filesystem::last_write_time(fileName, error).time_since_epoch().count();
+
+    return !error;
+}
+
+std::string manifest::getName(const std::string& fileName) const
+{
+    const std::filesystem::path name = std::filesystem::path(fileName).lexically_relative(m_directory);
+
+    if (name.empty() || *name.begin() == "..")
+        return fileName;
+
+    return name.generic_string();
+}
+
+bool manifest::isUnchanged(const std::string& name, const File& file) const
+{
+    File found;
+
+    if (!stat(std::filesystem::path(m_directory).append(name).string(), found))
+        return false;
+
+    return found.m_size == file.m_size && found.m_time == file.m_time;
+}
+
+void manifest::read()
+{
+    std::ifstream   fin(std::filesystem::path(m_directory).append(FileName).string());
+    std::string     line;
+
+    if (!fin || !std::getline(fin, line) || line != Header)
+        return;
+
+    State state;
+
+    while (std::getline(fin, line))
+    {
+        std::istringstream  stream(line);
+        std::string         type;
+        File                file;
+
+        stream >> type;
+
+        if (type == "input")
+        {
+            stream >> file.m_size >> file.m_time >> file.m_hash;
+
+            const std::string name = readName(stream);
+
+            if (stream.fail() || name.empty())
+                return;
+
+            state.m_inputs[name] = file;
+        }
+        else if (type == "target")
+        {
+            std::string target;
+            std::string key;
+
+            stream >> target >> key;
+
+            if (stream.fail())
+                return;
+
+            state.m_targets[target] = key;
+        }
+        else if (type == "output")
+        {
+            stream >> file.m_size >> file.m_time >> file.m_hash >> file.m_target;
+
+            const std::string name = readName(stream);
+
+            if (stream.fail() || name.empty())
+                return;
+
+            state.m_outputs[name] = file;
+        }
+        else
+            return;
+    }
+
+    // a manifest that can't be read completely is ignored
+    m_previous = std::move(state);
+}
+
+std::string manifest::hash(const std::string& fileName)
+{
+    File file;
+
+    if (!stat(fileName, file))
+        return std::string();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        const auto previous = m_previous.m_inputs.find(fileName);
+
+        if (previous != m_previous.m_inputs.end() && previous->second.m_size == file.m_size && previous->second.m_time == file.m_time)
+        {
+            m_current.m_inputs[fileName] = previous->second;
+
+            return previous->second.m_hash;
+        }
+    }
+
+    std::ifstream fin(fileName, std::ios::binary);
+
+    if (!fin)
+        throw std::runtime_error("Couldn't read: " + fileName);
+
+    const std::vector<char> data((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+
+    file.m_hash = contenthash(data.data(), data.size()).to_string();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_current.m_inputs[fileName] = file;
+
+    return file.m_hash;
+}
+
+bool manifest::isCurrent(const std::string& target, const std::string& key) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const auto found = m_previous.m_targets.find(target);
+
+    if (found == m_previous.m_targets.end() || found->second != key)
+        return false;
+
+    for (const auto& output : m_previous.m_outputs)
+    {
+        if (output.second.m_target == target && !isUnchanged(output.first, output.second))
+            return false;
+    }
+
+    return true;
+}
+
+bool manifest::isCurrentOutput(const std::string& fileName, const std::string& key) const
+{
+    const std::string name = getName(fileName);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const auto found = m_previous.m_outputs.find(name);
+
+    return found != m_previous.m_outputs.end() && found->second.m_hash == key && isUnchanged(name, found->second);
+}
+
+void manifest::addOutput(const std::string& target, const std::string& fileName, const std::string& key)
+{
+    File file;
+
+    if (!stat(fileName, file))
+        return;
+
+    file.m_hash = key;
+    file.m_target = target;
+
+    const std::string name = getName(fileName);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_current.m_outputs[name] = file;
+}
+
+void manifest::setTarget(const std::string& target, const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_current.m_targets[target] = key;
+}
+
+void manifest::keep(const std::string& target)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const auto found = m_previous.m_targets.find(target);
+
+    if (found != m_previous.m_targets.end())
+        m_current.m_targets[target] = found->second;
+
+    for (const auto& output : m_previous.m_outputs)
+    {
+        if (output.second.m_target == target)
+            m_current.m_outputs.insert(output);
+    }
+}
+
+void manifest::write() const
+{
+    const std::filesystem::path path = std::filesystem::path(m_directory).append(FileName);
+    const std::filesystem::path temporary = std::filesystem::path(m_directory).append(std::string(FileName) + ".tmp");
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::ofstream               fout(temporary.string());
+
+        if (!fout)
+            throw std::runtime_error("Couldn't create: " + temporary.string());
+
+        fout << Header << std::endl;
+
+        for (const auto& input : m_current.m_inputs)
+            fout << "input " << input.second.m_size << ' ' << input.second.m_time << ' ' << input.second.m_hash << ' ' << input.first << std::endl;
+
+        for (const auto& target : m_current.m_targets)
+            fout << "target " << target.first << ' ' << target.second << std::endl;
+
+        for (const auto& output : m_current.m_outputs)
+            fout << "output " << output.second.m_size << ' ' << output.second.m_time << ' ' << output.second.m_hash << ' ' << output.second.m_target << ' ' << output.first << std::endl;
+
+        fout.close();
+
+        if (!fout)
+            throw std::runtime_error("Couldn't write: " + temporary.string());
+    }
+
+    std::filesystem::rename(temporary, path);
+}
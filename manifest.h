@@ -0,0 +1,72 @@
+#ifndef _MANIFEST_H_
+#define _MANIFEST_H_
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+// What an earlier conversion read and wrote, kept in its output directory so a conversion can skip what is up to date.
+// The outputs are grouped in targets. A target is up to date when the key made from its inputs and options is the one
+// recorded and none of its outputs changed since. A single output can also be checked against its own key.
+// The hashes of the inputs are reused while the size and time of the files don't change.
+// The methods can be called from several threads.
+class manifest
+{
+    struct File
+    {
+        uint64_t    m_size = 0;
+        int64_t     m_time = 0;
+        std::string m_hash;     // of the content of an input, the key of an output
+        std::string m_target;   // of an output
+    };
+
+    struct State
+    {
+        std::map<std::string, File>         m_inputs;
+        std::map<std::string, std::string>  m_targets;
+        std::map<std::string, File>         m_outputs;
+    };
+
+    std::string         m_directory;
+    State               m_previous;
+    State               m_current;
+    mutable std::mutex  m_mutex;
+
+    static bool stat(const std::string& fileName, File& file);
+
+    std::string getName(const std::string& fileName) const;
+    bool isUnchanged(const std::string& name, const File& file) const;
+    void read();
+
+public:
+    static const char* const FileName;
+
+    // reads the manifest in directory, without one everything is out of date
+    explicit manifest(const std::string& directory);
+    manifest(const manifest&) = delete;
+    manifest& operator=(const manifest&) = delete;
+
+    // the content hash of an input file, an empty string when it doesn't exist
+    std::string hash(const std::string& fileName);
+
+    // true when the target was written with key and its outputs didn't change
+    bool isCurrent(const std::string& target, const std::string& key) const;
+
+    // true when the output was written with key and didn't change
+    bool isCurrentOutput(const std::string& fileName, const std::string& key) const;
+
+    // records an output of target written or found up to date, a file that doesn't exist isn't recorded
+    void addOutput(const std::string& target, const std::string& fileName, const std::string& key);
+
+    // records the target as written with key once its outputs are added
+    void setTarget(const std::string& target, const std::string& key);
+
+    // records the target and its outputs as they were when it didn't need to be written again
+    void keep(const std::string& target);
+
+    // replaces the manifest in the directory at once
+    void write() const;
+};
+
+#endif
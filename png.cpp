@@ -0,0 +1,221 @@
+#include "png.h"
+#include "deflate.h"
+#include "jobs.h"
+
+#include <fstream>
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace
+{
+    struct CrcTable
+    {
+        uint32_t    m_table[256];
+
+        CrcTable()
+        {
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t crc = i;
+
+                for (size_t j = 0; j < 8; j++)
+                    crc = (crc & 1) ? (0xedb88320u ^ (crc >> 1)) : (crc >> 1);
+
+                m_table[i] = crc;
+            }
+        }
+    };
+
+    uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+    {
+        static const CrcTable table;
+
+        crc = ~crc;
+
+        for (size_t i = 0; i < size; i++)
+            crc = table.m_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+        return ~crc;
+    }
+
+    void appendUint32(std::vector<uint8_t>& output, uint32_t value)
+    {
+        output.push_back(static_cast<uint8_t>(value >> 24));
+        output.push_back(static_cast<uint8_t>(value >> 16));
+        output.push_back(static_cast<uint8_t>(value >> 8));
+        output.push_back(static_cast<uint8_t>(value));
+    }
+
+    void appendChunk(std::vector<uint8_t>& output, const char* type, const uint8_t* data, size_t size)
+    {
+        appendUint32(output, static_cast<uint32_t>(size));
+
+        const size_t start = output.size();
+
+        output.insert(output.end(), type, type + 4);
+        output.insert(output.end(), data, data + size);
+
+        appendUint32(output, crc32(output.data() + start, size + 4));
+    }
+
+    uint8_t paeth(uint8_t a, uint8_t b, uint8_t c)
+    {
+        const int p = a + b - c;
+        const int pa = std::abs(p - a);
+        const int pb = std::abs(p - b);
+        const int pc = std::abs(p - c);
+
+        if (pa <= pb && pa <= pc)
+            return a;
+
+        return pb <= pc ? b : c;
+    }
+
+    // picks the filter with the smallest sum of absolute differences for each row in [first, last)
+    void filter(uint32_t width, const uint8_t* rgba, size_t channels, size_t first, size_t last, uint8_t* filtered)
+    {
+        const size_t            stride = width * channels;
+        std::vector<uint8_t>    previous(stride, 0);
+        std::vector<uint8_t>    current(stride);
+        std::vector<uint8_t>    candidates[5];
+
+        for (auto& candidate : candidates)
+            candidate.resize(stride);
+
+        for (size_t y = first > 0 ? first - 1 : 0; y < last; y++)
+        {
+            const uint8_t* row = rgba + y * width * 4;
+
+            if (channels == 4)
+                std::copy(row, row + stride, current.begin());
+            else
+            {
+                for (size_t x = 0; x < width; x++)
+                {
+                    current[x * 3] = row[x * 4];
+                    current[x * 3 + 1] = row[x * 4 + 1];
+                    current[x * 3 + 2] = row[x * 4 + 2];
+                }
+            }
+
+            // the row before the first one is only needed as the previous row
+            if (y < first)
+            {
+                previous.swap(current);
+                continue;
+            }
+
+            for (size_t i = 0; i < stride; i++)
+            {
+                const uint8_t a = i >= channels ? current[i - channels] : 0;
+                const uint8_t b = previous[i];
+                const uint8_t c = i >= channels ? previous[i - channels] : 0;
+
+                candidates[0][i] = current[i];
+                candidates[1][i] = static_cast<uint8_t>(current[i] - a);
+                candidates[2][i] = static_cast<uint8_t>(current[i] - b);
+                candidates[3][i] = static_cast<uint8_t>(current[i] - ((a + b) >> 1));
+                candidates[4][i] = static_cast<uint8_t>(current[i] - paeth(a, b, c));
+            }
+
+            size_t best = 0;
+            size_t bestSum = SIZE_MAX;
+
+            for (size_t f = 0; f < 5; f++)
+            {
+                size_t sum = 0;
+
+                for (const auto value : candidates[f])
+                    sum += value < 128 ? value : 256 - value;
+
+                if (sum < bestSum)
+                {
+                    best = f;
+                    bestSum = sum;
+                }
+            }
+
+            uint8_t* output = filtered + y * (stride + 1);
+
+            output[0] = static_cast<uint8_t>(best);
+            std::copy(candidates[best].begin(), candidates[best].end(), output + 1);
+
+            previous.swap(current);
+        }
+    }
+
+    bool isOpaque(uint32_t width, uint32_t height, const uint8_t* rgba)
+    {
+        const size_t count = static_cast<size_t>(width) * height;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if (rgba[i * 4 + 3] != 255)
+                return false;
+        }
+
+        return true;
+    }
+}
+
+std::vector<uint8_t> png::encode(uint32_t width, uint32_t height, const uint8_t* rgba, bool alpha, const Options& options)
+{
+    alpha = alpha && !isOpaque(width, height, rgba);
+
+    const size_t            channels = alpha ? 4 : 3;
+    const size_t            rows = std::max<size_t>(1, (1 << 18) / (width * channels + 1));
+    std::vector<uint8_t>    filtered(height * (width * channels + 1));
+
+    jobs single(1);
+    jobs& pool = options.m_jobs ? *options.m_jobs : single;
+
+    {
+        jobs filters(height > rows ? pool : single);
+
+        for (size_t first = 0; first < height; first += rows)
+        {
+            const size_t last = std::min<size_t>(height, first + rows);
+
+            filters.add("filter", [width, rgba, channels, first, last, &filtered]()
+            {
+                filter(width, rgba, channels, first, last, filtered.data());
+            });
+        }
+
+        filters.wait();
+    }
+
+    const std::vector<uint8_t>  compressed = deflate::compress(filtered.data(), filtered.size(), options.m_level, pool);
+    const uint8_t               signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    std::vector<uint8_t>        output(signature, signature + 8);
+    std::vector<uint8_t>        header;
+
+    appendUint32(header, width);
+    appendUint32(header, height);
+    header.push_back(8);
+    header.push_back(alpha ? 6 : 2);
+    header.push_back(0);
+    header.push_back(0);
+    header.push_back(0);
+
+    output.reserve(compressed.size() + 64);
+
+    appendChunk(output, "IHDR", header.data(), header.size());
+    appendChunk(output, "IDAT", compressed.data(), compressed.size());
+    appendChunk(output, "IEND", nullptr, 0);
+
+    return output;
+}
+
+void png::write(const std::string& fileName, uint32_t width, uint32_t height, const uint8_t* rgba, bool alpha, const Options& options)
+{
+    const std::vector<uint8_t> data = encode(width, height, rgba, alpha, options);
+
+    std::ofstream fout(fileName, std::ios::binary);
+
+    if (!fout)
+        throw std::runtime_error("Couldn't create: " + fileName);
+
+    fout.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
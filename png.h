@@ -0,0 +1,35 @@
+#ifndef _PNG_H_
+#define _PNG_H_
+
+#include "deflate.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class jobs;
+
+// PNG writer for 8 bit RGBA pixels.
+// The alpha channel is dropped when alpha is false or when every pixel is opaque.
+class png
+{
+public:
+    struct Options
+    {
+        deflate::Level  m_level = deflate::Default;
+        jobs*           m_jobs = nullptr;   // big images are filtered and compressed in bands on its threads
+    };
+
+    static std::vector<uint8_t> encode(uint32_t width, uint32_t height, const uint8_t* rgba, bool alpha, const Options& options);
+    static std::vector<uint8_t> encode(uint32_t width, uint32_t height, const uint8_t* rgba, bool alpha)
+    {
+        return encode(width, height, rgba, alpha, Options());
+    }
+    static void write(const std::string& fileName, uint32_t width, uint32_t height, const uint8_t* rgba, bool alpha, const Options& options);
+    static void write(const std::string& fileName, uint32_t width, uint32_t height, const uint8_t* rgba, bool alpha)
+    {
+        write(fileName, width, height, rgba, alpha, Options());
+    }
+};
+
+#endif
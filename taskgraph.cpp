@@ -0,0 +1,74 @@
+#include "taskgraph.h"
+
+#include <stdexcept>
+
+taskgraph::Task taskgraph::add(const std::string& name, std::function<void()> function, std::initializer_list<Task> dependencies)
+{
+    const Task task = m_nodes.size();
+
+    for (const Task dependency : dependencies)
+    {
+        if (dependency >= task)
+            throw std::runtime_error("task " + name + " depends on a task that isn't added yet");
+    }
+
+    Node node;
+
+    node.m_name = name;
+    node.m_function = std::move(function);
+    node.m_waiting = dependencies.size();
+
+    m_nodes.push_back(std::move(node));
+
+    for (const Task dependency : dependencies)
+        m_nodes[dependency].m_dependents.push_back(task);
+
+    return task;
+}
+
+std::vector<jobs::Error> taskgraph::run()
+{
+    jobs                tasks(m_pool);
+    std::vector<Task>   ready;
+
+    // found before any task runs because tasks run when they are added to a pool of one thread
+    for (Task task = 0; task < m_nodes.size(); task++)
+    {
+        if (m_nodes[task].m_waiting == 0)
+            ready.push_back(task);
+    }
+
+    for (const Task task : ready)
+        start(tasks, task);
+
+    return tasks.wait();
+}
+
+void taskgraph::start(jobs& tasks, Task task)
+{
+    tasks.add(m_nodes[task].m_name, [this, &tasks, task]()
+    {
+        // the tasks depending on a failed task are never started
+        m_nodes[task].m_function();
+
+        finish(tasks, task);
+    });
+}
+
+void taskgraph::finish(jobs& tasks, Task task)
+{
+    std::vector<Task> ready;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for (const Task dependent : m_nodes[task].m_dependents)
+        {
+            if (--m_nodes[dependent].m_waiting == 0)
+                ready.push_back(dependent);
+        }
+    }
+
+    for (const Task dependent : ready)
+        start(tasks, dependent);
+}
@@ -0,0 +1,47 @@
+#ifndef _TASKGRAPH_H_
+#define _TASKGRAPH_H_
+
+#include "jobs.h"
+
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Tasks that run on the threads of a jobs pool as soon as the tasks they depend on are done.
+// A task that fails keeps the tasks depending on it from running.
+class taskgraph
+{
+public:
+    using Task = size_t;
+
+private:
+    struct Node
+    {
+        std::string             m_name;
+        std::function<void()>   m_function;
+        std::vector<Task>       m_dependents;
+        size_t                  m_waiting = 0;
+    };
+
+    jobs&               m_pool;
+    std::vector<Node>   m_nodes;
+    std::mutex          m_mutex;
+
+    void start(jobs& tasks, Task task);
+    void finish(jobs& tasks, Task task);
+
+public:
+    explicit taskgraph(jobs& pool) : m_pool(pool) {}
+    taskgraph(const taskgraph&) = delete;
+    taskgraph& operator=(const taskgraph&) = delete;
+
+    // the dependencies are tasks added before, so there can't be a cycle
+    Task add(const std::string& name, std::function<void()> function, std::initializer_list<Task> dependencies = {});
+
+    // runs the tasks once and waits for them, the failures are returned in the order the tasks were added
+    std::vector<jobs::Error> run();
+};
+
+#endif
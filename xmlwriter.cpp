@@ -0,0 +1,115 @@
+#include "xmlwriter.h"
+
+#include <charconv>
+
+void xmlwriter::Value::format(double value)
+{
+    // the %g format with a precision of 6 like std::ostream
+    m_size = std::to_chars(m_number, m_number + sizeof(m_number), value, std::chars_format::general, 6).ptr - m_number;
+    m_isNumber = true;
+}
+
+void xmlwriter::Value::format(long long value)
+{
+    m_size = std::to_chars(m_number, m_number + sizeof(m_number), value).ptr - m_number;
+    m_isNumber = true;
+}
+
+void xmlwriter::Value::format(unsigned long long value)
+{
+    m_size = std::to_chars(m_number, m_number + sizeof(m_number), value).ptr - m_number;
+    m_isNumber = true;
+}
+
+xmlwriter::Scope::Scope(xmlwriter& writer, std::string_view tag, Attributes attributes) : m_writer(writer), m_tag(tag)
+{
+    m_writer.indent();
+    m_writer.m_buffer += '<';
+    m_writer.m_buffer += tag;
+    m_writer.appendAttributes(attributes);
+    m_writer.m_buffer += ">\n";
+    m_writer.m_depth++;
+}
+
+xmlwriter::Scope::~Scope()
+{
+    m_writer.m_depth--;
+    m_writer.indent();
+    m_writer.m_buffer += "</";
+    m_writer.m_buffer += m_tag;
+    m_writer.m_buffer += ">\n";
+}
+
+void xmlwriter::indent()
+{
+    m_buffer.append(m_depth, '\t');
+}
+
+void xmlwriter::appendEscaped(std::string_view text)
+{
+    for (const char c : text)
+    {
+        switch (c)
+        {
+        case '&':
+            m_buffer += "&amp;";
+            break;
+        case '<':
+            m_buffer += "&lt;";
+            break;
+        case '>':
+            m_buffer += "&gt;";
+            break;
+        case '"':
+            m_buffer += "&quot;";
+            break;
+        default:
+            m_buffer += c;
+            break;
+        }
+    }
+}
+
+void xmlwriter::appendAttributes(Attributes attributes)
+{
+    for (const auto& attribute : attributes)
+    {
+        m_buffer += ' ';
+        m_buffer += attribute.first;
+        m_buffer += "=\"";
+        appendEscaped(attribute.second.get());
+        m_buffer += '"';
+    }
+}
+
+void xmlwriter::line(std::string_view text)
+{
+    indent();
+    m_buffer += text;
+    m_buffer += '\n';
+}
+
+void xmlwriter::element(std::string_view tag, Attributes attributes)
+{
+    indent();
+    m_buffer += '<';
+    m_buffer += tag;
+    appendAttributes(attributes);
+    m_buffer += "/>\n";
+}
+
+void xmlwriter::attnum(std::string_view name, std::string_view unit, const Value& value)
+{
+    if (unit.empty())
+        attnum(name, value);
+    else
+        element("attnum", { { "name", name }, { "unit", unit }, { "val", value } });
+}
+
+void xmlwriter::attnum(std::string_view name, std::string_view unit, const Value& min, const Value& max, const Value& value)
+{
+    if (unit.empty())
+        element("attnum", { { "name", name }, { "min", min }, { "max", max }, { "val", value } });
+    else
+        element("attnum", { { "name", name }, { "unit", unit }, { "min", min }, { "max", max }, { "val", value } });
+}
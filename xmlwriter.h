@@ -0,0 +1,104 @@
+#ifndef _XMLWRITER_H_
+#define _XMLWRITER_H_
+
+#include <cstddef>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// Writer of indented XML into a string, used for the Speed Dreams parameter files.
+// Elements are closed when their scope is destroyed and the children are indented with one tab per level.
+// Attribute values are escaped, so a & < > or " in a name is written as an entity.
+class xmlwriter
+{
+public:
+    // an attribute value, numbers are formatted like an ostream with the default precision
+    class Value
+    {
+        std::string_view    m_text;
+        char                m_number[32];
+        size_t              m_size = 0;
+        bool                m_isNumber = false;
+
+        void format(double value);
+        void format(long long value);
+        void format(unsigned long long value);
+
+    public:
+        Value(std::string_view text) : m_text(text) {}
+        Value(const std::string& text) : m_text(text) {}
+        Value(const char* text) : m_text(text) {}
+        Value(float value) { format(static_cast<double>(value)); }
+        Value(double value) { format(value); }
+        Value(int value) { format(static_cast<long long>(value)); }
+        Value(long value) { format(static_cast<long long>(value)); }
+        Value(long long value) { format(value); }
+        Value(unsigned int value) { format(static_cast<unsigned long long>(value)); }
+        Value(unsigned long value) { format(static_cast<unsigned long long>(value)); }
+        Value(unsigned long long value) { format(value); }
+
+        std::string_view get() const
+        {
+            return m_isNumber ? std::string_view(m_number, m_size) : m_text;
+        }
+    };
+
+    using Attributes = std::initializer_list<std::pair<std::string_view, Value>>;
+
+    // an open element that is closed when the scope is destroyed
+    class Scope
+    {
+        xmlwriter&          m_writer;
+        std::string_view    m_tag;
+
+    public:
+        Scope(xmlwriter& writer, std::string_view tag, Attributes attributes);
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        ~Scope();
+    };
+
+private:
+    std::string m_buffer;
+    size_t      m_depth = 0;
+
+    void indent();
+    void appendEscaped(std::string_view text);
+    void appendAttributes(Attributes attributes);
+
+public:
+    // a line written as it is at the current indentation
+    void line(std::string_view text);
+
+    // an element without children
+    void element(std::string_view tag, Attributes attributes);
+
+    Scope open(std::string_view tag, Attributes attributes)
+    {
+        return Scope(*this, tag, attributes);
+    }
+
+    // Speed Dreams parameter sections and attributes, an empty unit is left out
+    Scope section(const Value& name)
+    {
+        return Scope(*this, "section", { { "name", name } });
+    }
+    void attstr(std::string_view name, const Value& value)
+    {
+        element("attstr", { { "name", name }, { "val", value } });
+    }
+    void attnum(std::string_view name, const Value& value)
+    {
+        element("attnum", { { "name", name }, { "val", value } });
+    }
+    void attnum(std::string_view name, std::string_view unit, const Value& value);
+    void attnum(std::string_view name, std::string_view unit, const Value& min, const Value& max, const Value& value);
+
+    const std::string& getBuffer() const
+    {
+        return m_buffer;
+    }
+};
+
+#endif